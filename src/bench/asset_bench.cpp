@@ -0,0 +1,486 @@
+// Measures how long it takes to load a large asset file, and how
+// much of it ends up in memory. Mapping the file is compared with
+// reading every asset into memory, which is how it used to be done,
+// and with mapping a file where the assets are compressed. Mapping
+// doesn't load anything, "stream_all" is how long it takes to get
+// every asset in once all of them are asked for. The file is written
+// right before, so "load" only measures the cost of getting it into
+// the process. "cold_load" throws the file out of the page cache
+// first, so the disk is part of it, and it's done when everything
+// is in. "names" looks up every asset by the hash of its name,
+// by its name, and by going through all the paths, per lookup.
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+
+#define NULL_RENDERER
+#define OPENGL_TEXTURE_WIDTH 512
+#define OPENGL_TEXTURE_HEIGHT 512
+#define OPENGL_TEXTURE_DEPTH 256
+
+#include "../engine/math/block_math.h"
+#include "../engine/util/debug.cpp"
+#include "../engine/asset/asset.h"
+#include "../engine/util/memory.h"
+#include "../engine/util/jobs.h"
+#include "../engine/util/compression.h"
+#include "../engine/renderer/command.h"
+#include "../engine/renderer/camera.h"
+
+#include "../engine/util/memory.cpp"
+#include "../engine/util/jobs.cpp"
+#include "../engine/util/compression.cpp"
+#include "../engine/renderer/command.cpp"
+#include "../engine/asset/asset.cpp"
+
+#include "bench.h"
+
+void __close_app_responsibly() {}
+
+const char *PACK_PATH = "asset_bench.fog";
+const char *COMPRESSED_PACK_PATH = "asset_bench_compressed.fog";
+const u32 NUM_SOUNDS = 48;
+const u32 SOUND_SIZE = 2 << 20;
+const u32 NUM_TEXTURES = 16;
+const u32 TEXTURE_SIZE = 512;
+const u32 NUM_FONTS = 4;
+const u32 NUM_KERNINGS = 512;
+const u32 NUM_ASSETS = NUM_SOUNDS + NUM_TEXTURES + NUM_FONTS;
+const u32 NAME_LENGTH = 16;
+
+u64 resident_bytes() {
+    FILE *file = fopen("/proc/self/statm", "r");
+    u64 size = 0, resident = 0;
+    CHECK(fscanf(file, "%lu %lu", &size, &resident) == 2, "Failed to read statm");
+    fclose(file);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+u64 align(u64 offset) {
+    return (offset + Asset::ASSET_ALIGNMENT - 1) & ~(Asset::ASSET_ALIGNMENT - 1);
+}
+
+void pad_to(FILE *file, u64 offset) {
+    while ((u64) ftell(file) < offset)
+        fputc(0, file);
+}
+
+void evict_from_page_cache(const char *path) {
+    int file = open(path, O_RDONLY);
+    CHECK(file != -1, "Failed to open the asset file");
+    // Pages that aren't written yet can't be dropped.
+    fdatasync(file);
+    posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+    close(file);
+}
+
+// Made up, but about as compressible as the assets in "res/".
+// Sprites are runs of flat colors on a clear background, and
+// sounds are a wave with some noise on top.
+struct Payload {
+    u8 *pixels;
+    u8 *samples;
+};
+
+Payload make_payload() {
+    Payload payload;
+    u32 texture_size = TEXTURE_SIZE * TEXTURE_SIZE * 4;
+    payload.pixels = Util::push_memory<u8>(texture_size);
+    u32 color = 0;
+    for (u32 i = 0; i < texture_size; i += 4) {
+        if (random_int() % 16 == 0)
+            color = random_int() % 3 == 0 ? 0 : random_int();
+        memcpy(payload.pixels + i, &color, 4);
+    }
+    payload.samples = Util::push_memory<u8>(SOUND_SIZE);
+    s16 *samples = (s16 *) payload.samples;
+    for (u32 i = 0; i < SOUND_SIZE / sizeof(s16); i++)
+        samples[i] = (s16) (sin(i * 0.01f) * 8000.0f) + random_int() % 64;
+    return payload;
+}
+
+// Writes the asset to "asset" and returns its size.
+u64 build_asset(u32 i, Payload payload, u8 *asset, Asset::Type *type) {
+    u64 size = 0;
+    if (i < NUM_SOUNDS) {
+        Sound sound = {};
+        sound.num_samples = SOUND_SIZE / 4;
+        sound.samples_offset = align(sizeof(Sound));
+        sound.size = SOUND_SIZE;
+        sound.sample_rate = AUDIO_SAMPLE_RATE;
+        sound.bits_per_sample = 16;
+        sound.is_stereo = 1;
+        *type = Asset::Type::SOUND;
+        memcpy(asset, &sound, sizeof(sound));
+        memcpy(asset + sound.samples_offset, payload.samples, SOUND_SIZE);
+        size = sound.samples_offset + SOUND_SIZE;
+    } else if (i < NUM_SOUNDS + NUM_TEXTURES) {
+        Asset::Texture texture = {TEXTURE_SIZE, TEXTURE_SIZE, 4,
+                                  (u16) (i - NUM_SOUNDS), 0, 0,
+                                  Asset::ASSET_ID_NO_ASSET, 1,
+                                  ImageFormat::PIXELS,
+                                  align(sizeof(Asset::Texture)),
+                                  TEXTURE_SIZE * TEXTURE_SIZE * 4};
+        *type = Asset::Type::TEXTURE;
+        memcpy((void *) asset, &texture, sizeof(texture));
+        memcpy(asset + texture.pixels_offset, payload.pixels, texture.size);
+        size = texture.pixels_offset + texture.size;
+    } else {
+        Asset::Font font = {};
+        font.texture = NUM_SOUNDS;
+        font.num_glyphs = 256;
+        font.num_kernings = NUM_KERNINGS;
+        font.glyphs_offset = align(sizeof(Asset::Font));
+        font.kernings_offset = align(font.glyphs_offset +
+                                     font.num_glyphs * sizeof(Asset::Font::Glyph));
+        *type = Asset::Type::FONT;
+        memcpy((void *) asset, &font, sizeof(font));
+        memcpy(asset + font.glyphs_offset, payload.pixels,
+               font.num_glyphs * sizeof(Asset::Font::Glyph));
+        memcpy(asset + font.kernings_offset, payload.pixels,
+               NUM_KERNINGS * sizeof(Asset::Font::Kerning));
+        size = font.kernings_offset + NUM_KERNINGS * sizeof(Asset::Font::Kerning);
+    }
+    return size;
+}
+
+void name_of(u32 i, char *name) {
+    snprintf(name, NAME_LENGTH, "bench/%04u.bin", i);
+}
+
+// Placed the same way as mist places them.
+void write_names(FILE *file, u64 size) {
+    Asset::Name *names = Util::push_memory<Asset::Name>(size);
+    for (u64 slot = 0; slot < size; slot++)
+        names[slot] = {0, Asset::ASSET_ID_NO_ASSET, 0};
+    for (u32 i = 0; i < NUM_ASSETS; i++) {
+        char name[NAME_LENGTH];
+        name_of(i, name);
+        u64 hash = Asset::hash_name(name);
+        u64 slot = hash & (size - 1);
+        while (names[slot].asset_id != Asset::ASSET_ID_NO_ASSET)
+            slot = (slot + 1) & (size - 1);
+        names[slot] = {hash, i, 0};
+    }
+    fwrite(names, sizeof(Asset::Name), size, file);
+    Util::pop_memory(names);
+}
+
+// Writes the same layout as mist, with made up assets. Like
+// mist, an asset is only compressed if it saves an eighth.
+u64 write_pack(const char *path, Payload payload, bool compress) {
+    FILE *file = fopen(path, "wb");
+    ASSERT(file, "Failed to create the asset file");
+    Asset::FileHeader file_header = {};
+    file_header.magic = Asset::FILE_MAGIC;
+    file_header.version = Asset::FILE_VERSION;
+    file_header.number_of_assets = NUM_ASSETS;
+    file_header.headers_offset = sizeof(Asset::FileHeader);
+    file_header.strings_offset = file_header.headers_offset +
+                                 NUM_ASSETS * sizeof(Asset::Header);
+    file_header.size_of_strings = NUM_ASSETS * NAME_LENGTH;
+    file_header.names_offset = align(file_header.strings_offset +
+                                     file_header.size_of_strings);
+    file_header.number_of_names = Asset::name_table_size(NUM_ASSETS);
+    file_header.data_offset = align(file_header.names_offset +
+                                    file_header.number_of_names *
+                                    sizeof(Asset::Name));
+    Asset::Header headers[NUM_ASSETS] = {};
+    fwrite(&file_header, sizeof(file_header), 1, file);
+    fwrite(headers, sizeof(Asset::Header), NUM_ASSETS, file);
+    for (u32 i = 0; i < NUM_ASSETS; i++) {
+        char name[NAME_LENGTH] = {};
+        name_of(i, name);
+        fwrite(name, 1, NAME_LENGTH, file);
+    }
+    pad_to(file, file_header.names_offset);
+    write_names(file, file_header.number_of_names);
+
+    u64 max_size = SOUND_SIZE + Asset::ASSET_ALIGNMENT;
+    u8 *asset = Util::push_memory<u8>(max_size);
+    u8 *compressed = Util::push_memory<u8>(Compression::max_compressed_size(max_size));
+    for (u32 i = 0; i < NUM_ASSETS; i++) {
+        pad_to(file, align(ftell(file)));
+        Asset::Header *header = headers + i;
+        header->asset_id = i;
+        header->path_offset = i * NAME_LENGTH;
+        header->path_length = NAME_LENGTH;
+        header->offset = ftell(file);
+        header->asset_size = build_asset(i, payload, asset, &header->type);
+        header->stored_size = header->asset_size;
+        header->encoding = Asset::Encoding::RAW;
+        u64 size = compress ? Compression::compress(asset, header->asset_size,
+                                                    compressed)
+                            : header->asset_size;
+        if (size <= header->asset_size - header->asset_size / 8) {
+            header->stored_size = size;
+            header->encoding = Asset::Encoding::LZ4;
+            fwrite(compressed, 1, size, file);
+        } else {
+            fwrite(asset, 1, header->asset_size, file);
+        }
+    }
+    file_header.size_of_data = ftell(file) - file_header.data_offset;
+    u64 size = ftell(file);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(&file_header, sizeof(file_header), 1, file);
+    fwrite(headers, sizeof(Asset::Header), NUM_ASSETS, file);
+    fclose(file);
+    Util::pop_memory(compressed);
+    Util::pop_memory(asset);
+    return size;
+}
+
+// Reads every asset into memory, like the loader did
+// before the file was mapped. The offsets are from the
+// start of the asset, so the copies work as they are.
+struct CopiedPack {
+    Asset::Header *headers;
+    char *strings;
+    u8 *assets[NUM_ASSETS];
+};
+
+void load_by_copy(CopiedPack *pack) {
+    FILE *file = fopen(PACK_PATH, "rb");
+    Asset::FileHeader file_header;
+    CHECK(fread(&file_header, sizeof(file_header), 1, file), "Failed to read");
+    u64 num_assets = file_header.number_of_assets;
+    pack->headers = Util::push_memory<Asset::Header>(num_assets);
+    fseek(file, file_header.headers_offset, SEEK_SET);
+    CHECK(fread(pack->headers, sizeof(Asset::Header), num_assets, file),
+          "Failed to read");
+    pack->strings = Util::push_memory<char>(file_header.size_of_strings);
+    fseek(file, file_header.strings_offset, SEEK_SET);
+    CHECK(fread(pack->strings, 1, file_header.size_of_strings, file),
+          "Failed to read");
+    for (u64 i = 0; i < num_assets; i++) {
+        Asset::Header *header = pack->headers + i;
+        fseek(file, header->offset, SEEK_SET);
+        pack->assets[i] = Util::push_memory<u8>(header->asset_size);
+        CHECK(fread(pack->assets[i], 1, header->asset_size, file),
+              "Failed to read");
+        if (header->type == Asset::Type::TEXTURE) {
+            Asset::Texture *texture = (Asset::Texture *) pack->assets[i];
+            Renderer::upload_texture(texture->image(), texture->id);
+        }
+    }
+    fclose(file);
+}
+
+void free_copy(CopiedPack *pack) {
+    for (u32 i = 0; i < NUM_ASSETS; i++)
+        Util::pop_memory(pack->assets[i]);
+    Util::pop_memory(pack->strings);
+    Util::pop_memory(pack->headers);
+}
+
+// Every sample of every sound, like playing all of them.
+u64 play_all(const Sound **sounds) {
+    u64 sum = 0;
+    for (u32 i = 0; i < NUM_SOUNDS; i++) {
+        const u8 *samples = sounds[i]->data();
+        for (u32 j = 0; j < sounds[i]->size; j += 64)
+            sum += samples[j];
+    }
+    return sum;
+}
+
+struct Result {
+    u64 file_size;
+    u64 load_ns;
+    u64 stream_ns;
+    u64 cold_ns;
+    u64 play_ns;
+    // What's resident at each step.
+    u64 before;
+    u64 loaded;
+    u64 played;
+    u64 released;
+};
+
+void record(const char *scenario, Result *result, u32 frames) {
+    f64 megabyte = 1 << 20;
+    Bench::record(scenario, "file_size", result->file_size / megabyte, "MB");
+    Bench::record(scenario, "load", result->load_ns / (f64) frames / 1000000.0,
+                  "ms");
+    Bench::record(scenario, "stream_all",
+                  result->stream_ns / (f64) frames / 1000000.0, "ms");
+    Bench::record(scenario, "cold_load", result->cold_ns / 1000000.0, "ms");
+    Bench::record(scenario, "play_all", result->play_ns / 1000000.0, "ms");
+    Bench::record(scenario, "rss_after_load",
+                  (result->loaded - result->before) / megabyte, "MB");
+    Bench::record(scenario, "rss_after_play",
+                  (result->played - result->before) / megabyte, "MB");
+    Bench::record(scenario, "rss_after_release",
+                  (result->released - result->before) / megabyte, "MB");
+}
+
+u64 stream_all() {
+    u64 start = Bench::now_ns();
+    for (u32 i = 0; i < NUM_ASSETS; i++)
+        Asset::acquire(i);
+    for (u32 i = 0; i < NUM_ASSETS; i++)
+        while (Asset::residency(i) != Asset::Residency::RESIDENT)
+            std::this_thread::yield();
+    Asset::update();
+    return Bench::now_ns() - start;
+}
+
+void release_all() {
+    for (u32 i = 0; i < NUM_ASSETS; i++)
+        Asset::release(i);
+    Asset::update();
+}
+
+void run_mapped(const char *scenario, const char *path, u64 file_size,
+                u32 frames, u64 expected) {
+    Result result = {file_size};
+    for (u32 frame = 0; frame < frames; frame++) {
+        Asset::unload();
+        result.before = resident_bytes();
+        u64 start = Bench::now_ns();
+        ASSERT(Asset::load(path), "Failed to load the asset file");
+        result.load_ns += Bench::now_ns() - start;
+        result.loaded = resident_bytes();
+        result.stream_ns += stream_all();
+        if (frame + 1 != frames)
+            release_all();
+    }
+
+    const Sound *sounds[NUM_SOUNDS];
+    for (u32 i = 0; i < NUM_SOUNDS; i++)
+        sounds[i] = Asset::try_fetch_sound(i);
+    u64 start = Bench::now_ns();
+    u64 sum = play_all(sounds);
+    result.play_ns = Bench::now_ns() - start;
+    result.played = resident_bytes();
+    ASSERT(sum == expected, "The mapped samples are wrong");
+    release_all();
+    result.released = resident_bytes();
+    Asset::unload();
+
+    // Last, since the pages that are read back from the
+    // disk are mapped differently.
+    evict_from_page_cache(path);
+    start = Bench::now_ns();
+    ASSERT(Asset::load(path), "Failed to load the asset file");
+    stream_all();
+    result.cold_ns = Bench::now_ns() - start;
+    release_all();
+    Asset::unload();
+    record(scenario, &result, frames);
+}
+
+void run_copy(u64 file_size, u32 frames, u64 *expected) {
+    CopiedPack pack = {};
+    Result result = {file_size};
+    for (u32 frame = 0; frame < frames; frame++) {
+        result.before = resident_bytes();
+        u64 start = Bench::now_ns();
+        load_by_copy(&pack);
+        result.load_ns += Bench::now_ns() - start;
+        result.loaded = resident_bytes();
+        if (frame + 1 != frames)
+            free_copy(&pack);
+    }
+
+    const Sound *sounds[NUM_SOUNDS];
+    for (u32 i = 0; i < NUM_SOUNDS; i++)
+        sounds[i] = (const Sound *) pack.assets[i];
+    u64 start = Bench::now_ns();
+    *expected = play_all(sounds);
+    result.play_ns = Bench::now_ns() - start;
+    result.played = resident_bytes();
+    free_copy(&pack);
+    result.released = resident_bytes();
+
+    evict_from_page_cache(PACK_PATH);
+    start = Bench::now_ns();
+    load_by_copy(&pack);
+    result.cold_ns = Bench::now_ns() - start;
+    free_copy(&pack);
+    record("copy", &result, frames);
+}
+
+// Without the table, a name is found by comparing it
+// to every path.
+AssetID find_by_comparing(const char *name) {
+    for (u64 id = 0; id < Asset::system.file_header->number_of_assets; id++) {
+        const Asset::Header *header = Asset::system.headers + id;
+        if (strcmp(Asset::system.strings + header->path_offset, name) == 0)
+            return id;
+    }
+    return Asset::ASSET_ID_NO_ASSET;
+}
+
+// Every asset is looked up this many times a frame.
+const u32 LOOKUPS = 1000;
+
+void run_names(u32 frames) {
+    ASSERT(Asset::load(PACK_PATH), "Failed to load the asset file");
+    char names[NUM_ASSETS][NAME_LENGTH];
+    u64 hashes[NUM_ASSETS];
+    for (u32 i = 0; i < NUM_ASSETS; i++) {
+        name_of(i, names[i]);
+        hashes[i] = Asset::hash_name(names[i]);
+    }
+    u64 by_hash_ns = 0, by_name_ns = 0, comparing_ns = 0;
+    u64 sum = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        u64 start = Bench::now_ns();
+        for (u32 lookup = 0; lookup < LOOKUPS; lookup++)
+            for (u32 i = 0; i < NUM_ASSETS; i++)
+                sum += Asset::fetch_by_hash(hashes[i]);
+        by_hash_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        for (u32 lookup = 0; lookup < LOOKUPS; lookup++)
+            for (u32 i = 0; i < NUM_ASSETS; i++)
+                sum += Asset::fetch_by_name(names[i]);
+        by_name_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        for (u32 lookup = 0; lookup < LOOKUPS; lookup++)
+            for (u32 i = 0; i < NUM_ASSETS; i++)
+                sum += find_by_comparing(names[i]);
+        comparing_ns += Bench::now_ns() - start;
+    }
+    Asset::unload();
+    u64 expected = (u64) frames * LOOKUPS * 3 * NUM_ASSETS * (NUM_ASSETS - 1) / 2;
+    ASSERT(sum == expected, "A name was looked up wrong");
+    f64 lookups = (f64) frames * LOOKUPS * NUM_ASSETS;
+    Bench::record("names", "by_hash", by_hash_ns / lookups, "ns");
+    Bench::record("names", "by_name", by_name_ns / lookups, "ns");
+    Bench::record("names", "comparing", comparing_ns / lookups, "ns");
+}
+
+int main(int argc, char **argv) {
+    Bench::Options options = Bench::parse_options(argc, argv, 5);
+    Bench::report.benchmark = "asset";
+    init_random();
+    Util::do_all_allocations();
+    Jobs::init();
+
+    Payload payload = make_payload();
+    u64 size = write_pack(PACK_PATH, payload, false);
+    u64 compressed_size = write_pack(COMPRESSED_PACK_PATH, payload, true);
+    Util::pop_memory(payload.pixels);
+    Util::pop_memory(payload.samples);
+    printf("=== ASSET BENCHMARK (%u loads, %lu MB file, %u threads) ===\n",
+           options.frames, size >> 20, Jobs::num_threads());
+    u64 expected = 0;
+    // Copying gives the samples the others are checked against.
+    run_copy(size, options.frames, &expected);
+    if (Bench::should_run(&options, "mapped"))
+        run_mapped("mapped", PACK_PATH, size, options.frames, expected);
+    if (Bench::should_run(&options, "compressed"))
+        run_mapped("compressed", COMPRESSED_PACK_PATH, compressed_size,
+                   options.frames, expected);
+    if (Bench::should_run(&options, "names"))
+        run_names(options.frames);
+    remove(PACK_PATH);
+    remove(COMPRESSED_PACK_PATH);
+    Jobs::destroy();
+    return Bench::finish(&options);
+}
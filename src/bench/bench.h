@@ -0,0 +1,169 @@
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+
+///# Benchmarks
+// The benchmarks live in "src/bench", each one is a standalone
+// program that is built against the null renderer so it runs
+// without a window. They are built and run with "make bench".
+//
+// Every benchmark takes the same options:
+// <ul>
+//   <li>--frames N, how many frames to simulate.</li>
+//   <li>--scenario NAME, only run the scenarios with this name.</li>
+//   <li>--json PATH, writes the results as JSON to PATH.</li>
+//   <li>--baseline PATH, compares against an earlier JSON dump and
+//       fails if anything got worse than the tolerance.</li>
+//   <li>--tolerance T, how much worse is accepted, 0.15 by default.</li>
+// </ul>
+// Anything else stops the benchmark, so a misspelled option
+// can't make a run look like it passed.
+
+namespace Bench {
+
+struct Options {
+    u32 frames;
+    const char *scenario;
+    const char *json;
+    const char *baseline;
+    f32 tolerance;
+};
+
+// Which way a result moves when it gets better. Results that
+// only explain the others, like how many pairs were found,
+// are NEITHER and aren't checked against the baseline.
+enum class Better {
+    LOWER,
+    HIGHER,
+    NEITHER,
+};
+
+struct Result {
+    char name[64];
+    f64 value;
+    const char *unit;
+    Better better;
+};
+
+const u32 MAX_RESULTS = 256;
+struct Report {
+    const char *benchmark;
+    u32 num_results;
+    Result results[MAX_RESULTS];
+} report = {};
+
+u64 now_ns() {
+    timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+
+Options parse_options(int argc, char **argv, u32 default_frames) {
+    Options options = {default_frames, nullptr, nullptr, nullptr, 0.15f};
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (has_value && strcmp(argv[i], "--frames") == 0) {
+            options.frames = atoi(argv[++i]);
+        } else if (has_value && strcmp(argv[i], "--scenario") == 0) {
+            options.scenario = argv[++i];
+        } else if (has_value && strcmp(argv[i], "--json") == 0) {
+            options.json = argv[++i];
+        } else if (has_value && strcmp(argv[i], "--baseline") == 0) {
+            options.baseline = argv[++i];
+        } else if (has_value && strcmp(argv[i], "--tolerance") == 0) {
+            options.tolerance = atof(argv[++i]);
+        } else {
+            ERR("Unknown option \"%s\"", argv[i]);
+            fprintf(stderr, "Usage: %s [--frames N] [--scenario NAME] "
+                    "[--json PATH] [--baseline PATH] [--tolerance T]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+    ASSERT(options.frames, "Has to run at least one frame");
+    return options;
+}
+
+bool should_run(const Options *options, const char *scenario) {
+    return !options->scenario || strcmp(options->scenario, scenario) == 0;
+}
+
+void record(const char *scenario, const char *metric, f64 value,
+            const char *unit, Better better = Better::LOWER) {
+    ASSERT(report.num_results < MAX_RESULTS, "Too many results");
+    Result *result = report.results + report.num_results++;
+    snprintf(result->name, LEN(result->name), "%s/%s", scenario, metric);
+    result->value = value;
+    result->unit = unit;
+    result->better = better;
+    printf(" %-36s %12.3f %s\n", result->name, value, unit);
+}
+
+bool write_json(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        ERR("Failed to open \"%s\" for writing", path);
+        return false;
+    }
+    // One result per line, "compare" relies on it.
+    fprintf(file, "{\n  \"benchmark\": \"%s\",\n  \"results\": [\n",
+            report.benchmark);
+    for (u32 i = 0; i < report.num_results; i++) {
+        Result *result = report.results + i;
+        fprintf(file,
+                "    {\"name\": \"%s\", \"value\": %.6f, \"unit\": \"%s\"}%s\n",
+                result->name, result->value, result->unit,
+                i + 1 == report.num_results ? "" : ",");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+// Returns the number of results that got worse than the
+// baseline by more than |tolerance|, in either direction.
+u32 compare(const char *path, f32 tolerance) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        ERR("Failed to open baseline \"%s\"", path);
+        return 1;
+    }
+    u32 regressions = 0;
+    char line[256];
+    while (fgets(line, LEN(line), file)) {
+        char name[64];
+        f64 old_value;
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"value\": %lf",
+                   name, &old_value) != 2)
+            continue;
+        for (u32 i = 0; i < report.num_results; i++) {
+            Result *result = report.results + i;
+            if (strcmp(result->name, name) != 0) continue;
+            bool worse = false;
+            if (result->better == Better::LOWER)
+                worse = result->value > old_value * (1.0 + tolerance);
+            else if (result->better == Better::HIGHER)
+                worse = result->value < old_value * (1.0 - tolerance);
+            if (worse) {
+                printf(" REGRESSION %-25s %12.3f -> %.3f %s\n", name,
+                       old_value, result->value, result->unit);
+                regressions++;
+            }
+            break;
+        }
+    }
+    fclose(file);
+    return regressions;
+}
+
+// Writes and compares the results as asked for, the
+// return value is the exit code of the benchmark.
+int finish(const Options *options) {
+    if (options->json && !write_json(options->json))
+        return 1;
+    if (options->baseline && compare(options->baseline, options->tolerance))
+        return 1;
+    return 0;
+}
+
+}  // namespace Bench
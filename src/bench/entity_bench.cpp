@@ -0,0 +1,195 @@
+// Measures walking over entities with the component system,
+// against every object being allocated on its own and updated
+// with a virtual call, which is how the game used to do it.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../engine/math/block_math.h"
+#include "../engine/util/debug.cpp"
+#include "../engine/util/memory.h"
+#include "../engine/util/block_list.h"
+#include "../engine/util/jobs.h"
+#include "../engine/logic/logic.h"
+#include "../engine/logic/entity.h"
+
+#include "../engine/util/memory.cpp"
+#include "../engine/util/jobs.cpp"
+#include "../engine/logic/logic.cpp"
+#include "../engine/logic/entity.cpp"
+
+#include "bench.h"
+
+void __close_app_responsibly() {}
+
+using namespace Logic;
+
+const f32 FRAME_DELTA = 1.0f / 60.0f;
+const u32 NUM_ENTITIES = 100000;
+// Entities destroyed and made again every frame.
+const u32 NUM_CHURN = 1000;
+
+struct Position { Vec2 value; };
+struct Velocity { Vec2 value; };
+struct Spin { f32 rotation, speed; };
+
+struct Object {
+    virtual ~Object() {}
+    virtual void update(f32 delta) = 0;
+};
+
+struct Mover : public Object {
+    Vec2 position;
+    Vec2 velocity;
+
+    void update(f32 delta) override {
+        position += velocity * delta;
+    }
+};
+
+struct Spinner : public Mover {
+    f32 rotation, speed;
+
+    void update(f32 delta) override {
+        Mover::update(delta);
+        rotation += speed * delta;
+    }
+};
+
+void move(f32 delta) {
+    for_each<Position, Velocity>([delta](EntityID, Position &p, Velocity &v) {
+        p.value += v.value * delta;
+    });
+}
+
+void spin(f32 delta) {
+    for_each<Spin>([delta](EntityID, Spin &s) {
+        s.rotation += s.speed * delta;
+    });
+}
+
+EntityID create_mover(u32 i) {
+    EntityID id = create_entity();
+    add_component(id, Position{V2(0, 0)});
+    // Some things don't move, so the pools differ.
+    if (i % 8 != 0)
+        add_component(id, Velocity{random_unit_vec2()});
+    if (i % 4 == 0)
+        add_component(id, Spin{0, 1});
+    return id;
+}
+
+void run_components(u32 frames) {
+    const char *scenario = "components_100k";
+    EntityID *ids = Util::push_memory<EntityID>(NUM_ENTITIES);
+    u64 start = Bench::now_ns();
+    for (u32 i = 0; i < NUM_ENTITIES; i++)
+        ids[i] = create_mover(i);
+    u64 create_ns = Bench::now_ns() - start;
+
+    u64 update_ns = 0, churn_ns = 0, systems_ns = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        start = Bench::now_ns();
+        move(FRAME_DELTA);
+        spin(FRAME_DELTA);
+        update_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        run_systems(At::PRE_UPDATE, FRAME_DELTA);
+        systems_ns += Bench::now_ns() - start;
+
+        // Kill some and make new ones, so the pools
+        // get shuffled like they would in a game.
+        start = Bench::now_ns();
+        for (u32 i = 0; i < NUM_CHURN; i++) {
+            u32 index = random_int() % NUM_ENTITIES;
+            destroy_entity(ids[index]);
+            ids[index] = create_mover(index);
+        }
+        churn_ns += Bench::now_ns() - start;
+    }
+    ASSERT(num_entities() == NUM_ENTITIES, "Lost an entity");
+    ASSERT(num_components<Position>() == NUM_ENTITIES, "Lost a component");
+
+    u32 moving = 0;
+    for_each<Position, Velocity>([&moving](EntityID id, Position &, Velocity &) {
+        ASSERT(has_components<Position>(id), "Walked a wrong entity");
+        moving++;
+    });
+    ASSERT(moving == num_components<Velocity>(), "Missed an entity");
+
+    for (u32 i = 0; i < NUM_ENTITIES; i++)
+        destroy_entity(ids[i]);
+    ASSERT(num_components<Velocity>() == 0, "Components were left behind");
+    Util::pop_memory(ids);
+
+    Bench::record(scenario, "create", create_ns / (f64) NUM_ENTITIES,
+                  "ns/entity");
+    Bench::record(scenario, "update",
+                  update_ns / (f64) frames / NUM_ENTITIES, "ns/entity");
+    Bench::record(scenario, "systems",
+                  systems_ns / (f64) frames / NUM_ENTITIES, "ns/entity");
+    Bench::record(scenario, "churn", churn_ns / (f64) (frames * NUM_CHURN),
+                  "ns/entity");
+    Bench::record(scenario, "batches",
+                  entity_system.systems[At::PRE_UPDATE][1].batch + 1,
+                  "batches", Bench::Better::NEITHER);
+}
+
+void run_virtual(u32 frames) {
+    const char *scenario = "virtual_100k";
+    Object **objects = Util::push_memory<Object *>(NUM_ENTITIES);
+    u64 start = Bench::now_ns();
+    for (u32 i = 0; i < NUM_ENTITIES; i++) {
+        Mover *mover = i % 4 == 0 ? new Spinner() : new Mover();
+        mover->velocity = i % 8 != 0 ? random_unit_vec2() : V2(0, 0);
+        objects[i] = mover;
+    }
+    u64 create_ns = Bench::now_ns() - start;
+
+    u64 update_ns = 0, churn_ns = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        start = Bench::now_ns();
+        for (u32 i = 0; i < NUM_ENTITIES; i++)
+            objects[i]->update(FRAME_DELTA);
+        update_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        for (u32 i = 0; i < NUM_CHURN; i++) {
+            u32 index = random_int() % NUM_ENTITIES;
+            delete objects[index];
+            objects[index] = index % 4 == 0 ? new Spinner() : new Mover();
+        }
+        churn_ns += Bench::now_ns() - start;
+    }
+
+    for (u32 i = 0; i < NUM_ENTITIES; i++)
+        delete objects[i];
+    Util::pop_memory(objects);
+
+    Bench::record(scenario, "create", create_ns / (f64) NUM_ENTITIES,
+                  "ns/entity");
+    Bench::record(scenario, "update",
+                  update_ns / (f64) frames / NUM_ENTITIES, "ns/entity");
+    Bench::record(scenario, "churn", churn_ns / (f64) (frames * NUM_CHURN),
+                  "ns/entity");
+}
+
+int main(int argc, char **argv) {
+    Bench::Options options = Bench::parse_options(argc, argv, 300);
+    Bench::report.benchmark = "entity";
+    init_random();
+    Util::do_all_allocations();
+    Logic::init();
+    Logic::init_entities();
+    // They touch different components, so they share a batch.
+    add_system(At::PRE_UPDATE, move, component_mask<Velocity>(),
+               component_mask<Position>());
+    add_system(At::PRE_UPDATE, spin, 0, component_mask<Spin>());
+
+    printf("=== ENTITY BENCHMARK (%u frames) ===\n", options.frames);
+    if (Bench::should_run(&options, "components_100k"))
+        run_components(options.frames);
+    if (Bench::should_run(&options, "virtual_100k"))
+        run_virtual(options.frames);
+    return Bench::finish(&options);
+}
@@ -0,0 +1,96 @@
+// Measures how the job system scales with the number of threads,
+// and what a job costs. Every thread count has to give the same
+// answer as running everything on one thread.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../engine/math/block_math.h"
+#include "../engine/util/debug.cpp"
+#include "../engine/util/memory.h"
+#include "../engine/util/jobs.h"
+
+#include "../engine/util/memory.cpp"
+#include "../engine/util/jobs.cpp"
+
+#include "bench.h"
+
+void __close_app_responsibly() {}
+
+const u32 NUM_ITEMS = 1 << 16;
+const u32 BATCH = 1024;
+const u32 NUM_TINY_JOBS = 10000;
+const u32 THREAD_COUNTS[] = {1, 2, 4, 8, 16};
+
+// Something that takes a while per item, like stepping
+// a particle a few times.
+f32 work(u32 i) {
+    f32 x = i * 0.001f;
+    for (u32 step = 0; step < 32; step++)
+        x = x * 0.99f + sin(x) * 0.01f;
+    return x;
+}
+
+void noop(void *) {}
+
+void run(u32 threads, u32 frames, f64 *single_ns, f32 *expected) {
+    char scenario[32];
+    snprintf(scenario, LEN(scenario), "threads_%u", threads);
+    Jobs::init(threads - 1);
+
+    f32 *output = Util::push_memory<f32>(NUM_ITEMS);
+    u64 for_ns = 0, tiny_ns = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        u64 start = Bench::now_ns();
+        Jobs::parallel_for(NUM_ITEMS, BATCH, [output](u32 begin, u32 end) {
+            for (u32 i = begin; i < end; i++)
+                output[i] = work(i);
+        });
+        for_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        Jobs::Counter counter = {};
+        for (u32 i = 0; i < NUM_TINY_JOBS; i++)
+            Jobs::run(noop, nullptr, &counter);
+        Jobs::wait(&counter);
+        tiny_ns += Bench::now_ns() - start;
+    }
+
+    for (u32 i = 0; i < NUM_ITEMS; i++) {
+        if (threads == 1) expected[i] = output[i];
+        ASSERT(output[i] == expected[i], "The threads gave a different answer");
+    }
+    Util::pop_memory(output);
+    Jobs::destroy();
+
+    f64 per_frame = for_ns / (f64) frames;
+    if (threads == 1) *single_ns = per_frame;
+    Bench::record(scenario, "parallel_for", per_frame / 1000.0, "us/frame");
+    Bench::record(scenario, "speedup", *single_ns / per_frame, "x",
+                  Bench::Better::HIGHER);
+    Bench::record(scenario, "tiny_job", tiny_ns / (f64) (frames * NUM_TINY_JOBS),
+                  "ns/job");
+}
+
+int main(int argc, char **argv) {
+    Bench::Options options = Bench::parse_options(argc, argv, 30);
+    Bench::report.benchmark = "jobs";
+    Util::do_all_allocations();
+
+    u32 cores = std::thread::hardware_concurrency();
+    printf("=== JOBS BENCHMARK (%u frames, %u cores) ===\n", options.frames,
+           cores);
+    f64 single_ns = 1;
+    f32 *expected = Util::push_memory<f32>(NUM_ITEMS);
+    for (u32 i = 0; i < LEN(THREAD_COUNTS); i++) {
+        u32 threads = THREAD_COUNTS[i];
+        // More threads than cores only measures the scheduler.
+        if (threads > 1 && threads > cores) break;
+        char scenario[32];
+        snprintf(scenario, LEN(scenario), "threads_%u", threads);
+        // The single thread run is what the others are checked against.
+        if (threads > 1 && !Bench::should_run(&options, scenario)) continue;
+        run(threads, options.frames, &single_ns, expected);
+    }
+    Util::pop_memory(expected);
+    return Bench::finish(&options);
+}
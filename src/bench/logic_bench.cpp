@@ -0,0 +1,112 @@
+// Measures a frame full of timers, called one after the other
+// against the same timers saying what they touch so the ones
+// that don't conflict can run at the same time. Whatever runs
+// at the same time has to give the same answer as running
+// them in order.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../engine/math/block_math.h"
+#include "../engine/util/debug.cpp"
+#include "../engine/util/memory.h"
+#include "../engine/util/jobs.h"
+#include "../engine/logic/logic.h"
+
+#include "../engine/util/memory.cpp"
+#include "../engine/util/jobs.cpp"
+#include "../engine/logic/logic.cpp"
+
+#include "bench.h"
+
+void __close_app_responsibly() {}
+
+using namespace Logic;
+
+const u32 NUM_TIMERS = 256;
+const u32 NUM_RESOURCES = 32;
+
+enum Access {
+    SERIAL,
+    INDEPENDENT,
+    CHAINED,
+};
+
+const char *SCENARIOS[] = {"serial_256", "independent_256", "chained_256"};
+
+// Something that takes a while, like spawning a
+// handful of particles.
+f32 work(u32 i) {
+    f32 x = i * 0.001f;
+    for (u32 step = 0; step < 512; step++)
+        x = x * 0.99f + sin(x) * 0.01f;
+    return x;
+}
+
+// The order matters, so callbacks that share
+// a resource have to be called in order.
+u32 sums[NUM_RESOURCES];
+ResourceMask resources[NUM_RESOURCES];
+
+void run(Access access, u32 frames, f64 *serial_ns, u32 *expected) {
+    const char *scenario = SCENARIOS[access];
+    for (u32 i = 0; i < NUM_RESOURCES; i++)
+        sums[i] = 0;
+
+    LogicID ids[NUM_TIMERS];
+    for (u32 i = 0; i < NUM_TIMERS; i++) {
+        u32 resource = i % NUM_RESOURCES;
+        ids[i] = add_callback(At::PRE_UPDATE, [i, resource]() {
+            u32 value = (u32) (work(i) * 1000.0f);
+            sums[resource] = sums[resource] * 31 + value + i;
+        }, 0, FOREVER);
+        if (access == INDEPENDENT)
+            set_access(ids[i], 0, resources[resource]);
+        if (access == CHAINED)
+            set_access(ids[i], 0, resources[0]);
+    }
+
+    u64 total_ns = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        Logic::frame(frame + 1.0f);
+        u64 start = Bench::now_ns();
+        call(At::PRE_UPDATE);
+        total_ns += Bench::now_ns() - start;
+    }
+
+    for (u32 i = 0; i < NUM_RESOURCES; i++) {
+        if (access == SERIAL) expected[i] = sums[i];
+        ASSERT(sums[i] == expected[i], "The callbacks were called out of order");
+    }
+    for (u32 i = 0; i < NUM_TIMERS; i++)
+        remove_callback(ids[i]);
+    // Frees the slots.
+    call(At::PRE_UPDATE);
+
+    f64 per_frame = total_ns / (f64) frames;
+    if (access == SERIAL) *serial_ns = per_frame;
+    Bench::record(scenario, "frame", per_frame / 1000.0, "us/frame");
+    Bench::record(scenario, "speedup", *serial_ns / per_frame, "x",
+                  Bench::Better::HIGHER);
+}
+
+int main(int argc, char **argv) {
+    Bench::Options options = Bench::parse_options(argc, argv, 100);
+    Bench::report.benchmark = "logic";
+    Util::do_all_allocations();
+    Jobs::init();
+    Logic::init();
+    for (u32 i = 0; i < NUM_RESOURCES; i++)
+        resources[i] = add_resource();
+
+    printf("=== LOGIC BENCHMARK (%u frames, %u threads) ===\n",
+           options.frames, Jobs::num_threads());
+    f64 serial_ns = 1;
+    u32 expected[NUM_RESOURCES];
+    for (u32 i = 0; i < LEN(SCENARIOS); i++) {
+        // Serial is what the others are checked against.
+        if (i != SERIAL && !Bench::should_run(&options, SCENARIOS[i])) continue;
+        run((Access) i, options.frames, &serial_ns, expected);
+    }
+    Jobs::destroy();
+    return Bench::finish(&options);
+}
@@ -0,0 +1,139 @@
+// Measures the cost of spawning, updating and drawing particles.
+// Built against the null renderer, so the draw numbers are the
+// time it takes to write the verticies and not the GPU time.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NULL_RENDERER
+#define OPENGL_TEXTURE_WIDTH 512
+#define OPENGL_TEXTURE_HEIGHT 512
+#define OPENGL_TEXTURE_DEPTH 256
+
+#include "../engine/math/block_math.h"
+#include "../engine/util/debug.cpp"
+#include "../engine/asset/asset.h"
+#include "../engine/util/memory.h"
+#include "../engine/renderer/command.h"
+#include "../engine/renderer/camera.h"
+#include "../engine/renderer/particle_system.h"
+
+#include "../engine/util/memory.cpp"
+#include "../engine/renderer/command.cpp"
+#include "../engine/renderer/particle_system.cpp"
+
+#include "bench.h"
+#include "no_assets.h"
+
+void __close_app_responsibly() {}
+
+using namespace Renderer;
+
+const f32 FRAME_DELTA = 1.0f / 60.0f;
+
+struct Scenario {
+    const char *name;
+    u32 num_systems;
+    u32 particles_per_system;
+    Vec2 alive_time;
+    // Particles spawned per system, every "spawn_every" frames.
+    u32 spawn;
+    u32 spawn_every;
+};
+
+const Scenario SCENARIOS[] = {
+    // A constant trail, like the truck boost.
+    {"steady", 1, 500, V2(1.0, 2.0), 5, 1},
+    // Explosions, lots at once and then nothing.
+    {"burst", 1, 4000, V2(0.5, 1.5), 3000, 90},
+    // Short and long lived particles mixed, leaves holes in the ring.
+    {"mixed", 1, 2000, V2(0.05, 6.0), 10, 1},
+    // Lots of small systems, every system holds on to an arena
+    // so there can't be too many.
+    {"many", 16, 250, V2(1.0, 2.0), 2, 1},
+};
+
+ParticleSystem create_system(const Scenario *scenario) {
+    ParticleSystem system =
+        create_particle_system(scenario->particles_per_system, V2(0, 0));
+    system.add_sprite(0, 1, 1, 1, 1);
+    system.add_sprite(0, 4, 1, 1, 1);
+    system.alive_time = {scenario->alive_time.x, scenario->alive_time.y};
+    system.velocity_dir = {0, 2 * PI};
+    system.velocity = {1, 5};
+    system.acceleration = {0, 2};
+    system.angular_velocity = {-1, 1};
+    system.one_color = false;
+    return system;
+}
+
+void run(const Scenario *scenario, u32 frames) {
+    ParticleSystem systems[16];
+    ASSERT(scenario->num_systems <= LEN(systems), "Too many systems");
+    for (u32 s = 0; s < scenario->num_systems; s++)
+        systems[s] = create_system(scenario);
+
+    u64 spawn_ns = 0, update_ns = 0, draw_ns = 0;
+    u64 spawned = 0, updated = 0, drawn = 0;
+    u64 uploads = Impl::null_stats.num_uploads;
+    for (u32 frame = 0; frame < frames; frame++) {
+        u64 start = Bench::now_ns();
+        if (frame % scenario->spawn_every == 0) {
+            for (u32 s = 0; s < scenario->num_systems; s++)
+                for (u32 i = 0; i < scenario->spawn; i++)
+                    systems[s].spawn();
+            spawned += scenario->num_systems * scenario->spawn;
+        }
+        spawn_ns += Bench::now_ns() - start;
+
+        for (u32 s = 0; s < scenario->num_systems; s++)
+            updated += systems[s].num_alive();
+        start = Bench::now_ns();
+        for (u32 s = 0; s < scenario->num_systems; s++)
+            systems[s].update(FRAME_DELTA);
+        update_ns += Bench::now_ns() - start;
+
+        u64 alive = 0;
+        for (u32 s = 0; s < scenario->num_systems; s++)
+            alive += systems[s].num_alive();
+        u64 verticies = Impl::null_stats.num_verticies;
+        start = Bench::now_ns();
+        for (u32 s = 0; s < scenario->num_systems; s++)
+            systems[s].draw();
+        draw_ns += Bench::now_ns() - start;
+        u64 written = (Impl::null_stats.num_verticies - verticies) /
+                      Impl::VERTICIES_PER_SPRITE;
+        ASSERT(written == alive, "Didn't draw every living particle");
+        drawn += written;
+    }
+    uploads = Impl::null_stats.num_uploads - uploads;
+
+    for (u32 s = 0; s < scenario->num_systems; s++)
+        destroy_particle_system(systems + s);
+
+    Bench::record(scenario->name, "spawn", spawn_ns / (f64) MAX(spawned, 1),
+                  "ns/particle");
+    Bench::record(scenario->name, "update",
+                  update_ns / (f64) MAX(updated, 1), "ns/particle");
+    Bench::record(scenario->name, "draw", draw_ns / (f64) MAX(drawn, 1),
+                  "ns/particle");
+    Bench::record(scenario->name, "alive", drawn / (f64) frames,
+                  "particles/frame", Bench::Better::NEITHER);
+    Bench::record(scenario->name, "uploads",
+                  uploads / (f64) (frames * scenario->num_systems),
+                  "uploads/system/frame");
+}
+
+int main(int argc, char **argv) {
+    Bench::Options options = Bench::parse_options(argc, argv, 600);
+    Bench::report.benchmark = "particle";
+    init_random();
+    Util::do_all_allocations();
+    Renderer::init("particle_bench", 500, 500);
+
+    printf("=== PARTICLE BENCHMARK (%u frames) ===\n", options.frames);
+    for (u32 i = 0; i < LEN(SCENARIOS); i++) {
+        if (!Bench::should_run(&options, SCENARIOS[i].name)) continue;
+        run(SCENARIOS + i, options.frames);
+    }
+    return Bench::finish(&options);
+}
@@ -0,0 +1,631 @@
+// Measures the collision checks, the broadphase against checking
+// every pair of bodies. The bodies move around in a box that grows
+// with the number of bodies, so the density stays the same. The
+// stack scenarios measure how well the solver keeps boxes still,
+// and the query scenario how fast rays and circles are answered.
+// The tree scenarios mix small and large bodies.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NULL_RENDERER
+#define OPENGL_TEXTURE_WIDTH 512
+#define OPENGL_TEXTURE_HEIGHT 512
+#define OPENGL_TEXTURE_DEPTH 256
+
+bool debug_view_is_on() { return false; }
+
+#include "../engine/math/block_math.h"
+#include "../engine/util/debug.cpp"
+#include "../engine/asset/asset.h"
+#include "../engine/util/memory.h"
+#include "../engine/util/block_list.h"
+#include "../engine/util/jobs.h"
+#include "../engine/renderer/command.h"
+#include "../engine/renderer/camera.h"
+#include "../engine/logic/logic.h"
+#include "../engine/logic/block_physics.h"
+
+#include "../engine/util/memory.cpp"
+#include "../engine/util/jobs.cpp"
+#include "../engine/renderer/command.cpp"
+#include "../engine/logic/block_physics.cpp"
+
+#include "bench.h"
+#include "no_assets.h"
+
+void __close_app_responsibly() {}
+
+using namespace Physics;
+
+const f32 FRAME_DELTA = 1.0f / 60.0f;
+// Roughly the space each body has to itself.
+const f32 AREA_PER_BODY = 16.0f;
+const f32 CELL_SIZE = 2.0f;
+// Checking every pair gets slow, so it's only done when
+// there are few enough bodies.
+const u32 MAX_BRUTE_FORCE = 2000;
+
+const u32 SIZES[] = {250, 1000, 4000, 16000};
+
+ShapeID shapes[3];
+
+void setup_shapes() {
+    Vec2 square[] = {V2(-0.5, -0.5), V2(0.5, -0.5), V2(0.5, 0.5), V2(-0.5, 0.5)};
+    Vec2 triangle[] = {V2(-0.5, -0.5), V2(0.5, -0.5), V2(0.0, 0.5)};
+    Vec2 hexagon[6];
+    for (u32 i = 0; i < LEN(hexagon); i++)
+        hexagon[i] = rotate(V2(0.5, 0), i * PI / 3);
+    shapes[0] = add_shape(LEN(square), square);
+    shapes[1] = add_shape(LEN(triangle), triangle);
+    shapes[2] = add_shape(LEN(hexagon), hexagon);
+}
+
+List<Body> create_bodies(u32 num_bodies, f32 side) {
+    List<Body> bodies = create_list<Body>(num_bodies);
+    for (u32 i = 0; i < num_bodies; i++) {
+        // Most bodies only hit their own kind, every fifth
+        // one hits everything.
+        Layer layer = i % 5 == 0 ? 0xFFFFFFFF : 1 << (i % 3);
+        Body body = create_body(shapes[i % LEN(shapes)], 1.0f, layer);
+        body.position = random_unit_vec2() * random_real(0, side * 0.5f);
+        body.velocity = random_unit_vec2() * random_real(1, 5);
+        body.rotation = random_real(0, 2 * PI);
+        body.scale = V2(random_real(0.5, 2.0), random_real(0.5, 2.0));
+        bodies.append(body);
+    }
+    return bodies;
+}
+
+void bounce_on_walls(List<Body> *bodies, f32 side) {
+    for (u32 i = 0; i < bodies->length; i++) {
+        Body *body = *bodies + i;
+        if (ABS(body->position.x) > side * 0.5f)
+            body->velocity.x = -SIGN(body->position.x) * ABS(body->velocity.x);
+        if (ABS(body->position.y) > side * 0.5f)
+            body->velocity.y = -SIGN(body->position.y) * ABS(body->velocity.y);
+    }
+}
+
+void move_bodies(List<Body> *bodies, f32 side) {
+    for (u32 i = 0; i < bodies->length; i++)
+        integrate(*bodies + i, FRAME_DELTA);
+    bounce_on_walls(bodies, side);
+}
+
+u64 brute_force(List<Body> *bodies) {
+    u64 overlaps = 0;
+    for (u32 i = 0; i < bodies->length; i++)
+        for (u32 j = i + 1; j < bodies->length; j++)
+            overlaps += (bool) check_overlap(*bodies + i, *bodies + j);
+    return overlaps;
+}
+
+u64 broadphase(Grid *grid, List<Body> *bodies, List<Pair> *pairs) {
+    grid->clear();
+    for (u32 i = 0; i < bodies->length; i++) {
+        Body *body = *bodies + i;
+        grid->add(calculate_aabb(body), body->layer);
+    }
+    grid->build();
+    pairs->clear();
+    grid->find_pairs(pairs);
+
+    u64 overlaps = 0;
+    for (u32 i = 0; i < pairs->length; i++) {
+        Pair pair = (*pairs)[i];
+        overlaps += (bool) check_overlap(*bodies + pair.a, *bodies + pair.b);
+    }
+    return overlaps;
+}
+
+void run(u32 num_bodies, u32 frames) {
+    char scenario[32];
+    snprintf(scenario, LEN(scenario), "bodies_%u", num_bodies);
+
+    f32 side = sqrt(num_bodies * AREA_PER_BODY);
+    List<Body> bodies = create_bodies(num_bodies, side);
+    Grid grid = create_grid(CELL_SIZE, num_bodies * 2);
+    List<Pair> pairs = create_list<Pair>(num_bodies);
+
+    // The same bodies simulated and solved by a world.
+    World world = create_world(num_bodies);
+    u64 solved = 0;
+    for (u32 i = 0; i < bodies.length; i++)
+        world.add(bodies[i], [&solved](Body *, Body *, Overlap) {
+            solved++;
+            return false;
+        });
+
+    bool do_brute_force = num_bodies <= MAX_BRUTE_FORCE;
+    u64 brute_ns = 0, grid_ns = 0, world_ns = 0;
+    u64 found = 0, candidates = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        move_bodies(&bodies, side);
+
+        bounce_on_walls(&world.bodies, side);
+        u64 start = Bench::now_ns();
+        world.step(FRAME_DELTA);
+        world_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        u64 overlaps = broadphase(&grid, &bodies, &pairs);
+        grid_ns += Bench::now_ns() - start;
+        found += overlaps;
+        candidates += pairs.length;
+
+        if (do_brute_force) {
+            start = Bench::now_ns();
+            u64 expected = brute_force(&bodies);
+            brute_ns += Bench::now_ns() - start;
+            ASSERT(expected == overlaps, "The broadphase missed a pair");
+        }
+    }
+
+    Bench::record(scenario, "grid", grid_ns / (f64) frames / 1000.0,
+                  "us/frame");
+    if (do_brute_force)
+        Bench::record(scenario, "brute_force",
+                      brute_ns / (f64) frames / 1000.0, "us/frame");
+    Bench::record(scenario, "world_step", world_ns / (f64) frames / 1000.0,
+                  "us/frame");
+    // Both bodies report every overlap.
+    Bench::record(scenario, "world_overlaps", solved / 2.0 / frames,
+                  "pairs/frame", Bench::Better::NEITHER);
+    Bench::record(scenario, "candidates", candidates / (f64) frames,
+                  "pairs/frame", Bench::Better::NEITHER);
+    Bench::record(scenario, "overlaps", found / (f64) frames,
+                  "pairs/frame", Bench::Better::NEITHER);
+
+    destroy_world(&world);
+    destroy_list(&pairs);
+    destroy_grid(&grid);
+    destroy_list(&bodies);
+}
+
+// Polygons packed close together, so most pairs get past the
+// bounds and the SAT-test is what is measured. Every body is
+// turned a little each frame, so the caches are rebuilt.
+const u32 NUM_POLYGONS = 300;
+
+void run_polygons(u32 frames) {
+    const char *scenario = "polygons";
+    f32 side = sqrt(NUM_POLYGONS * 0.1f);
+    List<Body> plain = create_bodies(NUM_POLYGONS, side);
+    List<Body> cached = create_list<Body>(NUM_POLYGONS);
+    BodyCache *caches = Util::push_memory<BodyCache>(NUM_POLYGONS);
+    for (u32 i = 0; i < plain.length; i++) {
+        Body *body = plain + i;
+        body->layer = 0xFFFFFFFF;
+        body->velocity = V2(0, 0);
+        body->shape = shapes[2];
+        cached.append(*body);
+        attach_cache(cached + i, caches + i);
+    }
+
+    u32 num_pairs = NUM_POLYGONS * (NUM_POLYGONS - 1) / 2;
+    BodyPair *pairs = Util::push_memory<BodyPair>(num_pairs);
+    Overlap *results = Util::push_memory<Overlap>(num_pairs);
+    for (u32 i = 0, p = 0; i < cached.length; i++)
+        for (u32 j = i + 1; j < cached.length; j++)
+            pairs[p++] = {cached + i, cached + j};
+
+    u64 plain_ns = 0, cached_ns = 0, batched_ns = 0;
+    u64 checks = 0, found = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        for (u32 i = 0; i < plain.length; i++) {
+            plain[i].rotation += 0.01f;
+            cached[i].rotation += 0.01f;
+            integrate(cached + i, FRAME_DELTA);
+        }
+
+        u64 start = Bench::now_ns();
+        u64 plain_found = brute_force(&plain);
+        plain_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        u64 cached_found = brute_force(&cached);
+        cached_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        check_overlaps(num_pairs, pairs, results);
+        batched_ns += Bench::now_ns() - start;
+
+        u64 batched_found = 0;
+        for (u32 i = 0; i < num_pairs; i++) {
+            Overlap expected = check_overlap(pairs[i].a, pairs[i].b);
+            ASSERT(expected.is_valid == results[i].is_valid,
+                   "The batch gave a different result");
+            if (!expected) continue;
+            ASSERT(expected.depth == results[i].depth, "Different depths");
+            batched_found++;
+        }
+
+        ASSERT(plain_found == cached_found, "The cache changed the result");
+        ASSERT(batched_found == cached_found, "The batch changed the result");
+        found += cached_found;
+        checks += plain.length * (plain.length - 1) / 2;
+    }
+
+    Bench::record(scenario, "uncached", plain_ns / (f64) checks, "ns/pair");
+    Bench::record(scenario, "cached", cached_ns / (f64) checks, "ns/pair");
+    Bench::record(scenario, "batched", batched_ns / (f64) checks, "ns/pair");
+    Bench::record(scenario, "overlaps", found / (f64) frames, "pairs/frame",
+                  Bench::Better::NEITHER);
+
+    Util::pop_memory(results);
+    Util::pop_memory(pairs);
+    Util::pop_memory(caches);
+    destroy_list(&cached);
+    destroy_list(&plain);
+}
+
+// Bullets fired at an enemy on a long frame, they move further
+// than the enemy is wide every step. The discrete check misses
+// most of them, the sweep should hit every one.
+const u32 NUM_BULLETS = 1000;
+const f32 BULLET_SPEED = 100.0f;
+const f32 LONG_FRAME = 1.0f / 10.0f;
+
+void run_bullets(u32 frames) {
+    const char *scenario = "bullets";
+    Body enemy = create_body(shapes[0], 0.0f);
+    enemy.scale = V2(5, 5);
+    enemy.position = V2(50, 0);
+
+    u64 discrete_ns = 0, swept_ns = 0;
+    u64 discrete_hits = 0, swept_hits = 0, fired = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        for (u32 i = 0; i < NUM_BULLETS; i++) {
+            Body bullet = create_body(shapes[0]);
+            bullet.scale = V2(2, 1) * 0.33f;
+            bullet.position = V2(random_real(-10, 0), random_real(-2, 2));
+            bullet.velocity = V2(BULLET_SPEED, 0);
+
+            bool discrete = false, swept = false;
+            for (u32 step = 0; step < 10 && !(discrete && swept); step++) {
+                Body start = bullet;
+                integrate(&bullet, LONG_FRAME);
+                Vec2 motion = bullet.position - start.position;
+
+                u64 begin = Bench::now_ns();
+                discrete |= (bool) check_overlap(&bullet, &enemy);
+                u64 middle = Bench::now_ns();
+                swept |= (bool) time_of_impact(&start, motion, &enemy, V2(0, 0));
+                u64 end = Bench::now_ns();
+                discrete_ns += middle - begin;
+                swept_ns += end - middle;
+            }
+            discrete_hits += discrete;
+            swept_hits += swept;
+            fired++;
+        }
+    }
+    ASSERT(swept_hits == fired, "A bullet passed through the enemy");
+
+    // The same thing in a world, where bullets are swept and
+    // stopped by a wall.
+    World world = create_world(NUM_BULLETS + 1);
+    Body wall = create_body(shapes[0], 0.0f);
+    wall.scale = V2(1, 400);
+    wall.position = V2(50, 0);
+    world.add(wall);
+    BodyID bullets[NUM_BULLETS];
+    for (u32 i = 0; i < NUM_BULLETS; i++) {
+        Body bullet = create_body(shapes[0], 1.0f, 0xFFFFFFFF, 0.0f, 0.0f);
+        bullet.scale = V2(2, 0.5) * 0.33f;
+        // Spread out so they never touch each other.
+        bullet.position = V2(random_real(-10, 0), -90 + i * 0.18f);
+        bullet.velocity = V2(BULLET_SPEED, 0);
+        bullet.continuous = true;
+        bullets[i] = world.add(bullet);
+    }
+    u64 start = Bench::now_ns();
+    for (u32 step = 0; step < 10; step++)
+        world.step(LONG_FRAME);
+    u64 world_ns = Bench::now_ns() - start;
+    u32 passed = 0;
+    for (u32 i = 0; i < NUM_BULLETS; i++)
+        passed += world.get(bullets[i])->position.x > 50;
+    ASSERT(passed == 0, "A continuous body passed through the wall");
+    destroy_world(&world);
+
+    Bench::record(scenario, "discrete_hit_rate",
+                  discrete_hits / (f64) fired, "hits/shot",
+                  Bench::Better::NEITHER);
+    Bench::record(scenario, "swept_hit_rate", swept_hits / (f64) fired,
+                  "hits/shot", Bench::Better::HIGHER);
+    Bench::record(scenario, "discrete", discrete_ns / (f64) (fired * 10),
+                  "ns/check");
+    Bench::record(scenario, "swept", swept_ns / (f64) (fired * 10),
+                  "ns/check");
+    Bench::record(scenario, "world_step", world_ns / 10.0 / 1000.0,
+                  "us/frame");
+}
+
+// Bodies of very different sizes, like bullets next to
+// trash mountains, spread out evenly or in clumps. The grid
+// has a hard time with both, the tree shouldn't care.
+const u32 NUM_MIXED_BODIES = 2000;
+const u32 NUM_CLUSTERS = 8;
+const u32 TREE_REBUILD_FRAMES = 60;
+
+List<Body> create_mixed_bodies(u32 num_bodies, f32 side, bool clustered) {
+    Vec2 clusters[NUM_CLUSTERS];
+    for (u32 i = 0; i < NUM_CLUSTERS; i++)
+        clusters[i] = random_unit_vec2() * random_real(0, side * 0.4f);
+
+    List<Body> bodies = create_bodies(num_bodies, side);
+    for (u32 i = 0; i < bodies.length; i++) {
+        Body *body = bodies + i;
+        f32 size = random_real(0.5, 2.0);
+        if (i % 20 == 0) size = random_real(8.0, 12.0);
+        else if (i % 4 == 0) size = random_real(2.0, 4.0);
+        body->scale = V2(size, size * random_real(0.5, 1.0));
+        if (clustered)
+            body->position = clusters[i % NUM_CLUSTERS] +
+                             random_unit_vec2() * random_real(0, side * 0.08f);
+    }
+    return bodies;
+}
+
+void run_tree(const char *scenario, bool clustered, u32 frames) {
+    f32 side = sqrt(NUM_MIXED_BODIES * AREA_PER_BODY);
+    List<Body> bodies = create_mixed_bodies(NUM_MIXED_BODIES, side, clustered);
+    Grid grid = create_grid(CELL_SIZE, NUM_MIXED_BODIES * 2);
+    Tree tree = create_tree(0.5f, NUM_MIXED_BODIES);
+    List<Pair> pairs = create_list<Pair>(NUM_MIXED_BODIES);
+    ProxyID *proxies = Util::push_memory<ProxyID>(NUM_MIXED_BODIES);
+    AABB *aabbs = Util::push_memory<AABB>(NUM_MIXED_BODIES);
+    for (u32 i = 0; i < bodies.length; i++)
+        proxies[i] = tree.insert(calculate_aabb(bodies + i), bodies[i].layer,
+                                 bodies + i);
+
+    u64 brute_ns = 0, grid_ns = 0, tree_ns = 0, rebuild_ns = 0;
+    u64 candidates = 0, found = 0, moved = 0, rebuilds = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        move_bodies(&bodies, side);
+
+        u64 start = Bench::now_ns();
+        u64 expected = brute_force(&bodies);
+        brute_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        u64 grid_found = broadphase(&grid, &bodies, &pairs);
+        grid_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        for (u32 i = 0; i < bodies.length; i++) {
+            Body *body = bodies + i;
+            aabbs[i] = calculate_aabb(body);
+            moved += tree.move(proxies[i], aabbs[i],
+                               body->velocity * FRAME_DELTA);
+        }
+        pairs.clear();
+        tree.find_pairs(&pairs);
+        u64 tree_found = 0;
+        for (u32 i = 0; i < pairs.length; i++) {
+            Body *a = (Body *) tree.nodes[pairs[i].a].user;
+            Body *b = (Body *) tree.nodes[pairs[i].b].user;
+            // The tree has the larger boxes.
+            if (!overlaps(aabbs[a - bodies.data], aabbs[b - bodies.data]))
+                continue;
+            tree_found += (bool) check_overlap(a, b);
+        }
+        tree_ns += Bench::now_ns() - start;
+        candidates += pairs.length;
+
+        if (frame % TREE_REBUILD_FRAMES == TREE_REBUILD_FRAMES - 1) {
+            start = Bench::now_ns();
+            tree.rebuild();
+            rebuild_ns += Bench::now_ns() - start;
+            rebuilds++;
+        }
+
+        ASSERT(grid_found == expected, "The grid missed a pair");
+        ASSERT(tree_found == expected, "The tree missed a pair");
+        found += expected;
+    }
+
+    Bench::record(scenario, "brute_force", brute_ns / (f64) frames / 1000.0,
+                  "us/frame");
+    Bench::record(scenario, "grid", grid_ns / (f64) frames / 1000.0,
+                  "us/frame");
+    Bench::record(scenario, "tree", tree_ns / (f64) frames / 1000.0,
+                  "us/frame");
+    if (rebuilds)
+        Bench::record(scenario, "rebuild", rebuild_ns / (f64) rebuilds / 1000.0,
+                      "us/rebuild");
+    Bench::record(scenario, "tree_height", tree.height(), "nodes",
+                  Bench::Better::NEITHER);
+    Bench::record(scenario, "tree_moved", moved / (f64) frames,
+                  "proxies/frame", Bench::Better::NEITHER);
+    Bench::record(scenario, "tree_candidates", candidates / (f64) frames,
+                  "pairs/frame", Bench::Better::NEITHER);
+    Bench::record(scenario, "overlaps", found / (f64) frames, "pairs/frame",
+                  Bench::Better::NEITHER);
+
+    Util::pop_memory(aabbs);
+    Util::pop_memory(proxies);
+    destroy_list(&pairs);
+    destroy_tree(&tree);
+    destroy_grid(&grid);
+    destroy_list(&bodies);
+}
+
+// Rays and circles thrown at a world of bodies, like enemies
+// looking for the player. Checked against asking every body.
+const u32 NUM_QUERY_BODIES = 4000;
+const u32 NUM_QUERIES = 10000;
+const f32 QUERY_LENGTH = 10.0f;
+const f32 QUERY_RADIUS = 3.0f;
+
+void run_queries(u32 frames) {
+    const char *scenario = "queries";
+    f32 side = sqrt(NUM_QUERY_BODIES * AREA_PER_BODY);
+    List<Body> bodies = create_bodies(NUM_QUERY_BODIES, side);
+    World world = create_world(NUM_QUERY_BODIES, CELL_SIZE);
+    for (u32 i = 0; i < bodies.length; i++)
+        world.add(bodies[i]);
+
+    Ray *rays = Util::push_memory<Ray>(NUM_QUERIES);
+    RayHit *hits = Util::push_memory<RayHit>(NUM_QUERIES);
+    RadiusQuery *circles = Util::push_memory<RadiusQuery>(NUM_QUERIES);
+    List<BodyID> found = create_list<BodyID>(NUM_QUERIES);
+
+    u64 ray_ns = 0, brute_ray_ns = 0, radius_ns = 0, brute_radius_ns = 0;
+    u64 num_hits = 0, num_found = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        bounce_on_walls(&world.bodies, side);
+        world.step(FRAME_DELTA);
+
+        for (u32 i = 0; i < NUM_QUERIES; i++) {
+            Vec2 from = random_unit_vec2() * random_real(0, side * 0.5f);
+            Vec2 to = from + random_unit_vec2() * QUERY_LENGTH;
+            rays[i] = {from, to, 0xFFFFFFFF};
+            circles[i] = {from, QUERY_RADIUS, 0xFFFFFFFF, 0, 0};
+        }
+
+        // Includes building the grid.
+        u64 start = Bench::now_ns();
+        world.raycast(NUM_QUERIES, rays, hits);
+        ray_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        found.clear();
+        world.query_radius(NUM_QUERIES, circles, &found);
+        radius_ns += Bench::now_ns() - start;
+        num_found += found.length;
+
+        // Only a few are checked the slow way, it takes a while.
+        const u32 BRUTE_FORCE_QUERIES = 100;
+        for (u32 i = 0; i < BRUTE_FORCE_QUERIES; i++) {
+            Ray ray = rays[i];
+            start = Bench::now_ns();
+            f32 closest = 2.0f;
+            for (u32 j = 0; j < world.bodies.length; j++) {
+                Impact impact = raycast(world.bodies + j, ray.from, ray.to);
+                if (impact) closest = MIN(closest, impact.time);
+            }
+            brute_ray_ns += Bench::now_ns() - start;
+            ASSERT(hits[i].is_valid == (closest <= 1.0f),
+                   "The raycast missed a body");
+            ASSERT(!hits[i] || hits[i].time == closest,
+                   "The raycast didn't find the closest body");
+
+            start = Bench::now_ns();
+            u32 inside = 0;
+            for (u32 j = 0; j < world.bodies.length; j++)
+                inside += overlaps_circle(world.bodies + j, circles[i].center,
+                                          circles[i].radius);
+            brute_radius_ns += Bench::now_ns() - start;
+            ASSERT(inside == circles[i].count, "The radius query missed a body");
+        }
+        for (u32 i = 0; i < NUM_QUERIES; i++)
+            num_hits += hits[i].is_valid;
+
+    }
+
+    f64 checked = frames * 100.0;
+    Bench::record(scenario, "raycast", ray_ns / (f64) frames / 1000.0,
+                  "us/10k");
+    Bench::record(scenario, "radius", radius_ns / (f64) frames / 1000.0,
+                  "us/10k");
+    Bench::record(scenario, "brute_force_raycast",
+                  brute_ray_ns / checked * NUM_QUERIES / 1000.0, "us/10k");
+    Bench::record(scenario, "brute_force_radius",
+                  brute_radius_ns / checked * NUM_QUERIES / 1000.0, "us/10k");
+    Bench::record(scenario, "hit_rate", num_hits / (f64) (frames * NUM_QUERIES),
+                  "hits/ray", Bench::Better::NEITHER);
+    Bench::record(scenario, "found", num_found / (f64) (frames * NUM_QUERIES),
+                  "bodies/query", Bench::Better::NEITHER);
+
+    destroy_list(&found);
+    Util::pop_memory(circles);
+    Util::pop_memory(hits);
+    Util::pop_memory(rays);
+    destroy_world(&world);
+    destroy_list(&bodies);
+}
+
+// A stack of boxes resting on the ground at a low step rate.
+// The old solver lets the stack sink and jitter, the iterated
+// one should keep it still.
+const u32 STACK_HEIGHT = 10;
+const f32 STACK_DELTA = 1.0f / 30.0f;
+const f32 GRAVITY = 10.0f;
+
+void run_stack(u32 iterations, u32 frames) {
+    char scenario[32];
+    snprintf(scenario, LEN(scenario), "stack_%u", iterations);
+
+    World world = create_world(STACK_HEIGHT + 1);
+    world.iterations = iterations;
+    Body ground = create_body(shapes[0], 0.0f, 0xFFFFFFFF, 0.0f, 0.0f);
+    ground.scale = V2(20, 1);
+    ground.position = V2(0, -0.5);
+    world.add(ground);
+    BodyID boxes[STACK_HEIGHT];
+    for (u32 i = 0; i < STACK_HEIGHT; i++) {
+        Body box = create_body(shapes[0], 1.0f, 0xFFFFFFFF, 0.0f, 0.0f);
+        box.position = V2(0, 0.5f + i);
+        boxes[i] = world.add(box);
+    }
+
+    u64 total_ns = 0;
+    f64 total_speed = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        for (u32 i = 0; i < STACK_HEIGHT; i++)
+            world.get(boxes[i])->acceleration = V2(0, -GRAVITY);
+        u64 start = Bench::now_ns();
+        world.step(STACK_DELTA);
+        total_ns += Bench::now_ns() - start;
+        for (u32 i = 0; i < STACK_HEIGHT; i++)
+            total_speed += length(world.get(boxes[i])->velocity);
+    }
+
+    // How far the top box has moved from where it started.
+    Body *top = world.get(boxes[STACK_HEIGHT - 1]);
+    f32 drift = length(top->position - V2(0, STACK_HEIGHT - 0.5f));
+    destroy_world(&world);
+
+    Bench::record(scenario, "step", total_ns / (f64) frames / 1000.0,
+                  "us/frame");
+    Bench::record(scenario, "jitter", total_speed / (frames * STACK_HEIGHT),
+                  "units/s");
+    Bench::record(scenario, "drift", drift, "units");
+}
+
+int main(int argc, char **argv) {
+    Bench::Options options = Bench::parse_options(argc, argv, 120);
+    Bench::report.benchmark = "physics";
+    init_random();
+    Util::do_all_allocations();
+    Physics::init();
+    setup_shapes();
+
+    printf("=== PHYSICS BENCHMARK (%u frames) ===\n", options.frames);
+    for (u32 i = 0; i < LEN(SIZES); i++) {
+        char scenario[32];
+        snprintf(scenario, LEN(scenario), "bodies_%u", SIZES[i]);
+        if (!Bench::should_run(&options, scenario)) continue;
+        run(SIZES[i], options.frames);
+    }
+    if (Bench::should_run(&options, "polygons"))
+        run_polygons(options.frames);
+    if (Bench::should_run(&options, "bullets"))
+        run_bullets(MAX(options.frames / 10, 1));
+    if (Bench::should_run(&options, "tree_uniform"))
+        run_tree("tree_uniform", false, options.frames);
+    if (Bench::should_run(&options, "tree_clustered"))
+        run_tree("tree_clustered", true, options.frames);
+    if (Bench::should_run(&options, "queries"))
+        run_queries(MAX(options.frames / 10, 1));
+    const u32 STACK_ITERATIONS[] = {0, 1, 8};
+    for (u32 i = 0; i < LEN(STACK_ITERATIONS); i++) {
+        char scenario[32];
+        snprintf(scenario, LEN(scenario), "stack_%u", STACK_ITERATIONS[i]);
+        if (!Bench::should_run(&options, scenario)) continue;
+        run_stack(STACK_ITERATIONS[i], options.frames);
+    }
+    return Bench::finish(&options);
+}
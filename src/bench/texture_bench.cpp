@@ -0,0 +1,125 @@
+// Measures the BC3 encoder mist uses on the textures in "res",
+// how fast it is and how close the decoded texture is to the
+// original, as PSNR in dB. Only pixels that can be seen count
+// for the color. Decoding is what happens when the GPU can't
+// read BC3. "layer" is how much memory a layer of the texture
+// array takes on the GPU. Run it from the root of the repo.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../engine/math/block_math.h"
+#include "../engine/util/debug.cpp"
+#include "../engine/util/types.h"
+#include "../engine/util/memory.h"
+#include "../engine/util/block_compression.h"
+
+#include "../engine/util/memory.cpp"
+#include "../engine/util/block_compression.cpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "bench.h"
+
+void __close_app_responsibly() {}
+
+struct Scenario {
+    const char *name;
+    const char *path;
+};
+
+const Scenario SCENARIOS[] = {
+    {"sprites", "res/particle_spritesheep.png"},
+    {"pixel_font", "res/bitmap_font.png"},
+    {"distance_field", "res/monaco.sdf"},
+    {"picture", "res/test.png"},
+};
+
+const u32 LAYER_SIZE = 512;
+
+f64 psnr(f64 squared_error, u64 count) {
+    if (!count || squared_error == 0) return 99.0;
+    return 10.0 * log10(255.0 * 255.0 / (squared_error / count));
+}
+
+void run(const Scenario *scenario, u32 frames) {
+    int width, height, components;
+    u8 *pixels = stbi_load(scenario->path, &width, &height, &components, 4);
+    if (!pixels) {
+        ERR("Failed to load \"%s\"", scenario->path);
+        return;
+    }
+    u64 size = BlockCompression::bc3_size(width, height);
+    u8 *encoded = Util::push_memory<u8>(size);
+    u8 *decoded = Util::push_memory<u8>(width * height * 4);
+
+    u64 encode_ns = 0, decode_ns = 0;
+    for (u32 frame = 0; frame < frames; frame++) {
+        u64 start = Bench::now_ns();
+        BlockCompression::encode_bc3(pixels, width, height, encoded);
+        encode_ns += Bench::now_ns() - start;
+
+        start = Bench::now_ns();
+        BlockCompression::decode_bc3(encoded, width, height, decoded);
+        decode_ns += Bench::now_ns() - start;
+    }
+
+    f64 color_error = 0, alpha_error = 0;
+    u64 visible = 0;
+    for (u64 i = 0; i < (u64) width * height; i++) {
+        const u8 *original = pixels + i * 4;
+        const u8 *result = decoded + i * 4;
+        s32 alpha = original[3] - result[3];
+        alpha_error += alpha * alpha;
+        if (!original[3]) continue;
+        for (u32 c = 0; c < 3; c++) {
+            s32 difference = original[c] - result[c];
+            color_error += difference * difference;
+        }
+        visible += 3;
+    }
+
+    f64 megapixels = (f64) width * height / 1e6;
+    Bench::record(scenario->name, "encode", encode_ns / 1e6 / frames, "ms");
+    Bench::record(scenario->name, "encode_rate",
+                  megapixels / (encode_ns / 1e9 / frames), "MP/s",
+                  Bench::Better::HIGHER);
+    Bench::record(scenario->name, "decode", decode_ns / 1e6 / frames, "ms");
+    Bench::record(scenario->name, "psnr_color", psnr(color_error, visible), "dB",
+                  Bench::Better::HIGHER);
+    Bench::record(scenario->name, "psnr_alpha",
+                  psnr(alpha_error, (u64) width * height), "dB",
+                  Bench::Better::HIGHER);
+
+    Util::pop_memory(decoded);
+    Util::pop_memory(encoded);
+    stbi_image_free(pixels);
+}
+
+// A layer with every level down to one pixel.
+u64 layer_size(ImageFormat format, u32 levels) {
+    Image image = {nullptr, LAYER_SIZE, LAYER_SIZE, 4, 0, (u8) levels, format};
+    return image.size();
+}
+
+int main(int argc, char **argv) {
+    Bench::Options options = Bench::parse_options(argc, argv, 10);
+    Bench::report.benchmark = "texture";
+    Util::do_all_allocations();
+
+    printf("=== TEXTURE BENCHMARK (%u frames) ===\n", options.frames);
+    for (u32 i = 0; i < LEN(SCENARIOS); i++) {
+        if (!Bench::should_run(&options, SCENARIOS[i].name)) continue;
+        run(SCENARIOS + i, options.frames);
+    }
+    if (Bench::should_run(&options, "layer")) {
+        Bench::record("layer", "rgba8", layer_size(ImageFormat::PIXELS, 1) / 1024.0,
+                      "KB");
+        Bench::record("layer", "rgba8_levels",
+                      layer_size(ImageFormat::PIXELS, 10) / 1024.0, "KB");
+        Bench::record("layer", "bc3_levels",
+                      layer_size(ImageFormat::BC3, 10) / 1024.0, "KB");
+    }
+    return Bench::finish(&options);
+}
@@ -1,116 +1,548 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
 namespace Asset {
 
+// Every asset has a slot, that says where it is.
+struct Slot {
+    std::atomic<Residency> residency;
+    // These are only touched with the loader locked.
+    u32 references;
+    // Fetched with "fetch_*", so it's never freed.
+    std::atomic<bool> kept;
+    bool broken;
+    // Already in the list for "update".
+    bool needs_update;
+
+    // The asset, in the mapped file or in "decompressed".
+    // Textures drop it once they're uploaded.
+    const u8 *data;
+    u8 *decompressed;
+    // Textures are fetched from here, since it's
+    // all that's left when the pixels are gone.
+    Texture texture;
+};
+
 struct System {
-    FileHeader file_header;
-    char *strings;
-    Header *headers;
-    Data *assets;
+    // All of these point into the mapped file.
+    const FileHeader *file_header;
+    const char *strings;
+    const Header *headers;
+    const Name *names;
+
+    Slot *slots;
 
-    Util::MemoryArena *arena;
+    // The whole file, mapped read only.
+    const u8 *mapping;
+    u64 mapping_size;
 } system = {};
 
-Data *raw_fetch(AssetID id, Type type) {
-    if (system.file_header.number_of_assets < id) {
+// Assets are loaded on threads of their own, the jobs
+// are for the frame and shouldn't wait on the disk.
+const u32 MAX_LOADER_THREADS = 4;
+
+struct Loader {
+    std::mutex lock;
+    std::condition_variable wake_up;
+    std::thread threads[MAX_LOADER_THREADS];
+    u32 num_threads;
+    bool running;
+
+    // An asset is in here while it's QUEUED, so there's
+    // room for all of them.
+    AssetID *queue;
+    u64 head, tail;
+
+    // Assets the main thread has to look at in "update".
+    AssetID *updates;
+    u64 num_updates;
+} loader;
+
+void unload();
+
+#ifdef DEBUG
+// In "hot_reload.cpp", the assets are baked again
+// when the files they came from change.
+static void start_watching();
+static void reload_changed();
+static void stop_watching();
+#endif
+
+// Gives the pages back to the OS, they're read
+// from the file again if they're used later.
+static void release_pages(const u8 *from, u64 size) {
+    u64 page = sysconf(_SC_PAGESIZE);
+    u64 begin = ((u64) from + page - 1) & ~(page - 1);
+    u64 end = ((u64) from + size) & ~(page - 1);
+    if (begin < end)
+        madvise((void *) begin, end - begin, MADV_DONTNEED);
+}
+
+// Reads a byte from every page, so they're
+// in memory before anyone needs them.
+static void touch_pages(const u8 *from, u64 size) {
+    u64 page = sysconf(_SC_PAGESIZE);
+    volatile u8 sum = 0;
+    for (u64 offset = 0; offset < size; offset += page)
+        sum += from[offset];
+}
+
+static bool fits(u64 offset, u64 size, u64 space) {
+    return offset <= space && size <= space - offset;
+}
+
+static bool is_stored_in_file(const Header *header, u64 file_size) {
+    if (!fits(header->offset, header->stored_size, file_size)) return false;
+    if (header->offset % ASSET_ALIGNMENT) return false;
+    switch (header->encoding) {
+    case Encoding::RAW:
+        return header->stored_size == header->asset_size;
+    case Encoding::LZ4:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Nothing in the file is changed, it's only checked
+// so a broken file can't make anyone read past the
+// end of an asset.
+static bool is_valid_asset(const Header *header, const void *asset) {
+    u64 size = header->asset_size;
+    switch (header->type) {
+    case Type::TEXTURE:
+    case Type::ATLAS: {
+        const Texture *texture = (const Texture *) asset;
+        if (sizeof(Texture) > size) return false;
+        // A sprite's pixels are in its page.
+        if (texture->atlas != ASSET_ID_NO_ASSET)
+            return header->type == Type::TEXTURE
+                && texture->atlas < system.file_header->number_of_assets
+                && system.headers[texture->atlas].type == Type::ATLAS
+                && texture->size == 0;
+        return texture->levels && texture->levels <= MAX_TEXTURE_LEVELS
+            && (texture->format == ImageFormat::PIXELS ||
+                (texture->format == ImageFormat::BC3 &&
+                 texture->components == 4))
+            && texture->size == texture->image().size()
+            && fits(texture->pixels_offset, texture->size, size);
+    }
+    case Type::FONT: {
+        const Font *font = (const Font *) asset;
+        return sizeof(Font) <= size
+            && font->texture < system.file_header->number_of_assets
+            && system.headers[font->texture].type == Type::TEXTURE
+            && fits(font->glyphs_offset, font->num_glyphs * sizeof(Font::Glyph),
+                    size)
+            && fits(font->kernings_offset,
+                    font->num_kernings * sizeof(Font::Kerning), size)
+            && font->num_glyphs == 256;
+    }
+    case Type::SOUND: {
+        const Sound *sound = (const Sound *) asset;
+        return sizeof(Sound) <= size
+            && fits(sound->samples_offset, sound->size, size);
+    }
+    default:
+        return true;
+    }
+}
+
+static void queue_load(AssetID id);
+
+// Loads the asset on this thread, the slot has to be LOADING.
+static void load_asset(AssetID id) {
+    const Header *header = system.headers + id;
+    Slot *slot = system.slots + id;
+    const u8 *stored = system.mapping + header->offset;
+    const u8 *data = stored;
+    u8 *decompressed = nullptr;
+    if (header->encoding == Encoding::LZ4) {
+        decompressed = Util::push_memory<u8>(header->asset_size);
+        if (!Compression::decompress(stored, header->stored_size,
+                                     decompressed, header->asset_size)) {
+            Util::pop_memory(decompressed);
+            decompressed = nullptr;
+            data = nullptr;
+        } else {
+            data = decompressed;
+        }
+    } else {
+        // Reads it in now, so no one waits on the
+        // disk when it's used.
+        touch_pages(stored, header->stored_size);
+    }
+    if (data && !is_valid_asset(header, data)) {
+        if (decompressed)
+            Util::pop_memory(decompressed);
+        decompressed = nullptr;
+        data = nullptr;
+    }
+    if (!data)
+        ERR("Asset %d is broken", id);
+
+    std::lock_guard<std::mutex> guard(loader.lock);
+    slot->broken = !data;
+    slot->data = data;
+    slot->decompressed = decompressed;
+    if (data && (header->type == Type::TEXTURE || header->type == Type::ATLAS))
+        slot->texture = *(const Texture *) data;
+    // The page has to be on the GPU before the sprite is
+    // drawn, and it's kept since other sprites use it too.
+    if (data && slot->texture.atlas != ASSET_ID_NO_ASSET &&
+        header->type == Type::TEXTURE) {
+        system.slots[slot->texture.atlas].kept = true;
+        queue_load(slot->texture.atlas);
+    }
+    // The same goes for the distance field of a font.
+    if (data && header->type == Type::FONT) {
+        u32 texture = ((const Font *) data)->texture;
+        system.slots[texture].kept = true;
+        queue_load(texture);
+    }
+    // Textures have to be uploaded, and anything no one
+    // holds on to any more can be freed.
+    if (!slot->needs_update) {
+        slot->needs_update = true;
+        loader.updates[loader.num_updates++] = id;
+    }
+    slot->residency.store(Residency::RESIDENT, std::memory_order_release);
+}
+
+static void loader_thread() {
+    while (true) {
+        AssetID id;
+        {
+            std::unique_lock<std::mutex> guard(loader.lock);
+            loader.wake_up.wait(guard, []() {
+                return loader.head != loader.tail || !loader.running;
+            });
+            if (!loader.running) return;
+            u64 num_assets = system.file_header->number_of_assets;
+            id = loader.queue[loader.head++ % num_assets];
+            system.slots[id].residency = Residency::LOADING;
+        }
+        load_asset(id);
+    }
+}
+
+// Needs the loader to be locked.
+static void queue_load(AssetID id) {
+    Slot *slot = system.slots + id;
+    if (slot->residency != Residency::UNLOADED) return;
+    u64 num_assets = system.file_header->number_of_assets;
+    slot->residency = Residency::QUEUED;
+    loader.queue[loader.tail++ % num_assets] = id;
+    loader.wake_up.notify_one();
+}
+
+static bool is_valid_id(AssetID id, Type type) {
+    if (!system.file_header || system.file_header->number_of_assets <= id) {
         ERR("Invalid asset id (%d)", id);
         HALT_AND_CATCH_FIRE;
-        return nullptr;
+        return false;
     }
-    if (type == Type::NONE || system.headers[id].type == type) {
-        return &system.assets[id];
-    } else {
+    if (type != Type::NONE && system.headers[id].type != type) {
         ERR("Not the expected type (%d)", id);
         HALT_AND_CATCH_FIRE;
+        return false;
+    }
+    return true;
+}
+
+static const void *resident_asset(AssetID id) {
+    Slot *slot = system.slots + id;
+    if (slot->broken) return nullptr;
+    Type type = system.headers[id].type;
+    if (type == Type::TEXTURE || type == Type::ATLAS)
+        return &slot->texture;
+    return slot->data;
+}
+
+void acquire(AssetID id) {
+    if (!is_valid_id(id, Type::NONE)) return;
+    std::lock_guard<std::mutex> guard(loader.lock);
+    system.slots[id].references++;
+    queue_load(id);
+}
+
+void release(AssetID id) {
+    if (!is_valid_id(id, Type::NONE)) return;
+    std::lock_guard<std::mutex> guard(loader.lock);
+    Slot *slot = system.slots + id;
+    ASSERT(slot->references, "Releasing an asset that isn't acquired");
+    if (--slot->references || slot->needs_update) return;
+    slot->needs_update = true;
+    loader.updates[loader.num_updates++] = id;
+}
+
+Residency residency(AssetID id) {
+    if (!is_valid_id(id, Type::NONE)) return Residency::UNLOADED;
+    return system.slots[id].residency.load(std::memory_order_acquire);
+}
+
+const void *raw_fetch(AssetID id, Type type) {
+    if (!is_valid_id(id, type)) return nullptr;
+    Slot *slot = system.slots + id;
+    if (slot->kept &&
+        slot->residency.load(std::memory_order_acquire) == Residency::RESIDENT &&
+        !slot->broken)
+        return resident_asset(id);
+
+    bool load_here = false;
+    {
+        std::lock_guard<std::mutex> guard(loader.lock);
+        slot->kept = true;
+        if (slot->residency == Residency::UNLOADED) {
+            slot->residency = Residency::LOADING;
+            load_here = true;
+        }
+    }
+    // Loading it here is faster than waiting in line
+    // for the loader thread.
+    if (load_here)
+        load_asset(id);
+    while (slot->residency.load(std::memory_order_acquire) != Residency::RESIDENT)
+        std::this_thread::yield();
+    // No one checks what they fetch, so the game stops here
+    // rather than somewhere far away.
+    if (slot->broken) {
+        ERR("Fetched asset %d (\"%s\") is broken", id,
+            system.strings + system.headers[id].path_offset);
+        HALT_AND_CATCH_FIRE;
         return nullptr;
     }
+    // The loader only queues the page of a sprite, it's
+    // loaded here too so they're uploaded together.
+    if (type == Type::TEXTURE && slot->texture.atlas != ASSET_ID_NO_ASSET)
+        raw_fetch(slot->texture.atlas, Type::ATLAS);
+    if (type == Type::FONT)
+        raw_fetch(((const Font *) slot->data)->texture, Type::TEXTURE);
+    return resident_asset(id);
 }
 
-Image *fetch_image(AssetID id) {
-    return &raw_fetch(id, Type::TEXTURE)->image;
+const void *raw_try_fetch(AssetID id, Type type) {
+    if (!is_valid_id(id, type)) return nullptr;
+    Slot *slot = system.slots + id;
+    if (slot->residency.load(std::memory_order_acquire) != Residency::RESIDENT)
+        return nullptr;
+    // A sprite can't be drawn without its page.
+    if (type == Type::TEXTURE && !slot->broken &&
+        slot->texture.atlas != ASSET_ID_NO_ASSET &&
+        system.slots[slot->texture.atlas].residency.load(
+            std::memory_order_acquire) != Residency::RESIDENT)
+        return nullptr;
+    // Nor can text without its distance field.
+    if (type == Type::FONT && !slot->broken &&
+        system.slots[((const Font *) slot->data)->texture].residency.load(
+            std::memory_order_acquire) != Residency::RESIDENT)
+        return nullptr;
+    return resident_asset(id);
 }
 
-Font *fetch_font(AssetID id) {
-    return &raw_fetch(id, Type::FONT)->font;
+const Texture *fetch_image(AssetID id) {
+    return (const Texture *) raw_fetch(id, Type::TEXTURE);
 }
 
-Sound *fetch_sound(AssetID id) {
-    return &raw_fetch(id, Type::SOUND)->sound;
+const Font *fetch_font(AssetID id) {
+    return (const Font *) raw_fetch(id, Type::FONT);
 }
 
-template <typename T>
-size_t read_from_file(FILE *stream, void *ptr, size_t num = 1) {
-    if (!num) {
-        ERR("Has to read something from file, invalid read");
-        return 0;
+const Sound *fetch_sound(AssetID id) {
+    return (const Sound *) raw_fetch(id, Type::SOUND);
+}
+
+const Texture *try_fetch_image(AssetID id) {
+    return (const Texture *) raw_try_fetch(id, Type::TEXTURE);
+}
+
+const Font *try_fetch_font(AssetID id) {
+    return (const Font *) raw_try_fetch(id, Type::FONT);
+}
+
+const Sound *try_fetch_sound(AssetID id) {
+    return (const Sound *) raw_try_fetch(id, Type::SOUND);
+}
+
+AssetID fetch_by_hash(u64 hash) {
+    if (!system.names) return ASSET_ID_NO_ASSET;
+    // The table always has empty slots, so this stops.
+    u64 mask = system.file_header->number_of_names - 1;
+    for (u64 slot = hash & mask;; slot = (slot + 1) & mask) {
+        const Name *name = system.names + slot;
+        if (name->asset_id == ASSET_ID_NO_ASSET) return ASSET_ID_NO_ASSET;
+        if (name->hash == hash) return name->asset_id;
     }
-    size_t read = 0;
-    do {
-        size_t last_read = fread(ptr, sizeof(T), num - read, stream);
-        ASSERT(last_read, "Failed to read anything from asset file.");
-        read += last_read;
-        ptr = (void *) ((u8 *) ptr + last_read * sizeof(T));
-    } while (read < num);
-    return read;
 }
 
+AssetID fetch_by_name(const char *name) {
+    return fetch_by_hash(hash_name(name));
+}
+
+// Drops what's in memory, the pages of the mapped
+// file are read in again if it's loaded later.
+static void free_asset(Slot *slot, const Header *header) {
+    if (slot->decompressed)
+        Util::pop_memory(slot->decompressed);
+    else if (slot->data)
+        release_pages(slot->data, header->asset_size);
+    slot->data = nullptr;
+    slot->decompressed = nullptr;
+}
+
+void update() {
+#ifdef DEBUG
+    reload_changed();
+#endif
+    std::lock_guard<std::mutex> guard(loader.lock);
+    for (u64 i = 0; i < loader.num_updates; i++) {
+        AssetID id = loader.updates[i];
+        const Header *header = system.headers + id;
+        Slot *slot = system.slots + id;
+        slot->needs_update = false;
+        if (slot->residency != Residency::RESIDENT || !slot->data) continue;
+        if (header->type == Type::TEXTURE || header->type == Type::ATLAS) {
+            const Texture *texture = (const Texture *) slot->data;
+            // A sprite is uploaded with its page.
+            if (texture->atlas == ASSET_ID_NO_ASSET)
+                Renderer::upload_texture(texture->image(), texture->id);
+            // The GPU has its own copy now.
+            free_asset(slot, header);
+        } else if (!slot->references && !slot->kept) {
+            slot->residency = Residency::UNLOADED;
+            free_asset(slot, header);
+        }
+    }
+    loader.num_updates = 0;
+}
+
+// The file is mapped and only the headers are checked,
+// the assets are loaded when they're asked for.
 bool load(const char *file_path) {
-    system.arena = Util::request_arena();
-    FILE *file = fopen(file_path, "rb");
-    if (!file) {
+    int file = open(file_path, O_RDONLY);
+    if (file == -1) {
         ERR("Failed to open resource file!");
         return false;
     }
+    struct stat info;
+    if (fstat(file, &info) == -1 || (u64) info.st_size < sizeof(FileHeader)) {
+        ERR("Resource file is too small");
+        close(file);
+        return false;
+    }
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        ERR("Failed to map resource file!");
+        return false;
+    }
+    system.mapping = (const u8 *) mapping;
+    system.mapping_size = info.st_size;
 
-    read_from_file<FileHeader>(file, &system.file_header);
-    u32 num_assets = system.file_header.number_of_assets;
-
-    system.headers = system.arena->push<Header>(num_assets);
-    read_from_file<Header>(file, system.headers, num_assets);
-
-    system.strings = system.arena->push<char>(
-        system.file_header.size_of_strings);
-    read_from_file<Header>(file, system.strings,
-                                system.file_header.size_of_strings);
-
-    char *read_head = system.strings;
-    for (u64 asset = 0; asset < num_assets; asset++)
-        system.headers[asset].file_path += (u64) read_head;
+    const FileHeader *file_header = (const FileHeader *) system.mapping;
+    if (file_header->magic != FILE_MAGIC) {
+        ERR("Not a resource file");
+        unload();
+        return false;
+    }
+    if (file_header->version != FILE_VERSION) {
+        ERR("Resource file is version %d, expected %d, rebuild it with mist",
+            file_header->version, FILE_VERSION);
+        unload();
+        return false;
+    }
+    u64 num_assets = file_header->number_of_assets;
+    if (num_assets > system.mapping_size / sizeof(Header) ||
+        !fits(file_header->headers_offset, num_assets * sizeof(Header),
+              system.mapping_size) ||
+        !fits(file_header->strings_offset, file_header->size_of_strings,
+              system.mapping_size) ||
+        file_header->number_of_names != name_table_size(num_assets) ||
+        !fits(file_header->names_offset,
+              file_header->number_of_names * sizeof(Name),
+              system.mapping_size)) {
+        ERR("Resource file is cut short");
+        unload();
+        return false;
+    }
+    system.file_header = file_header;
+    system.headers = at_offset<Header>(system.mapping, file_header->headers_offset);
+    system.strings = at_offset<char>(system.mapping, file_header->strings_offset);
+    system.names = at_offset<Name>(system.mapping, file_header->names_offset);
 
-    system.assets = system.arena->push<Data>(
-        system.file_header.number_of_assets);
     for (u64 asset = 0; asset < num_assets; asset++) {
-        Header header = system.headers[asset];
-        Data *asset_ptr = &system.assets[asset];
-        fseek(file, header.offset, SEEK_SET);
-        read_from_file<Data>(file, asset_ptr);
-        switch (header.type) {
-        case Type::TEXTURE: {
-            u64 size = asset_ptr->image.size();
-            asset_ptr->image.data = system.arena->push<u8>(size);
-            read_from_file<u8>(file, asset_ptr->image.data, size);
-            Renderer::upload_texture(asset_ptr->image, asset_ptr->image.id);
-        } break;
-        case Type::FONT: {
-            asset_ptr->font.glyphs =
-                system.arena->push<Font::Glyph>(asset_ptr->font.num_glyphs);
-            read_from_file<Font::Glyph>(file, asset_ptr->font.glyphs,
-                                        asset_ptr->font.num_glyphs);
-            if (asset_ptr->font.num_kernings) {
-                asset_ptr->font.kernings =
-                    system.arena->push<Font::Kerning>(asset_ptr->font.num_kernings);
-                read_from_file<Font::Glyph>(file, asset_ptr->font.kernings,
-                        asset_ptr->font.num_kernings);
-            }
-        } break;
-        case Type::SOUND: {
-            asset_ptr->sound.data = system.arena->push<u8>(asset_ptr->sound.size);
-            read_from_file<u8>(file, asset_ptr->sound.data, asset_ptr->sound.size);
-        } break;
-        default:
-            ERR("UNKOWN ASSET TYPE %d", header.type);
+        const Header *header = system.headers + asset;
+        if (!is_stored_in_file(header, system.mapping_size) ||
+            !fits(header->path_offset, header->path_length,
+                  file_header->size_of_strings)) {
+            ERR("Asset %d is broken or outside the resource file", asset);
+            unload();
+            return false;
+        }
+    }
+    // A lookup stops at an empty slot, so there has to be one.
+    u64 empty_names = 0;
+    for (u64 slot = 0; slot < file_header->number_of_names; slot++) {
+        u32 id = system.names[slot].asset_id;
+        if (id == ASSET_ID_NO_ASSET) {
+            empty_names++;
+        } else if (id >= num_assets) {
+            empty_names = 0;
             break;
-        };
+        }
+    }
+    if (!empty_names) {
+        ERR("The names in the resource file are broken");
+        unload();
+        return false;
     }
+
+    system.slots = new Slot[num_assets]();
+    loader.queue = Util::push_memory<AssetID>(num_assets);
+    loader.updates = Util::push_memory<AssetID>(num_assets);
+    loader.head = loader.tail = loader.num_updates = 0;
+    loader.running = true;
+    loader.num_threads = MIN(Jobs::num_threads(), MAX_LOADER_THREADS);
+    for (u32 i = 0; i < loader.num_threads; i++)
+        loader.threads[i] = std::thread(loader_thread);
+#ifdef DEBUG
+    start_watching();
+#endif
     return true;
 }
 
+void unload() {
+#ifdef DEBUG
+    stop_watching();
+#endif
+    {
+        std::lock_guard<std::mutex> guard(loader.lock);
+        loader.running = false;
+    }
+    loader.wake_up.notify_all();
+    for (u32 i = 0; i < loader.num_threads; i++)
+        loader.threads[i].join();
+    loader.num_threads = 0;
+    if (loader.queue)
+        Util::pop_memory(loader.queue);
+    if (loader.updates)
+        Util::pop_memory(loader.updates);
+    loader.queue = loader.updates = nullptr;
+    if (system.slots) {
+        for (u64 asset = 0; asset < system.file_header->number_of_assets; asset++)
+            if (system.slots[asset].decompressed)
+                Util::pop_memory(system.slots[asset].decompressed);
+        delete[] system.slots;
+    }
+    if (system.mapping)
+        munmap((void *) system.mapping, system.mapping_size);
+    system = {};
+}
+
 }  // namespace Asset
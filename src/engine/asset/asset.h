@@ -16,6 +16,42 @@
 // "src/fog_assets.cpp", and remember to write the name of the asset, since the
 // actual number might change randomly
 // </p>
+// <p>
+// Assets can also be found by their path, which doesn't change
+// when other files are added, with "fetch_by_name". The hash of
+// the path can be worked out when compiling, so looking up a
+// name costs about as much as using the number.
+// </p>
+// <p>
+// Loading the asset file only maps it, the assets are loaded
+// when they're first asked for. "fetch_*" loads the asset
+// right away if it has to, and keeps it for good, which is
+// what most of the game wants. It stops the game if the
+// asset is broken. Assets that come and go are "acquire"d,
+// which loads them on the loader threads, and "release"d
+// when they're no longer needed, which frees them once no
+// one holds a reference. "try_fetch_*" never waits, it
+// returns nullptr until the asset is resident.
+// </p>
+// <p>
+// Textures are uploaded to the GPU on the main thread, in
+// "update", and the pixels are dropped after that. Only
+// the Texture itself is kept, so textures stay resident.
+// Small images are sprites in the page of an atlas, the page
+// is loaded with the first of its sprites and kept, so is
+// the distance field of a font. Mist can give textures
+// smaller levels for when they're drawn small, and store
+// them as BC3, see "util/block_compression.h".
+// </p>
+// <p>
+// Debug builds watch the files the assets were baked from,
+// and bake a file again in "update" when it's saved, with
+// the same code as mist. Textures are uploaded to the same
+// layer, a sprite keeps its place in the page, and the
+// shaders in "res" are compiled again. The asset file isn't
+// changed, so mist has to be run to keep the changes, and
+// for new files or sprites that change size.
+// </p>
 
 ///* AssetID
 // An AssetID is a simple and easy way to identify an asset, they are unique
@@ -26,8 +62,49 @@ namespace Asset {
 
 const u32 ASSET_ID_NO_ASSET = 0xFFFF;
 
-#pragma pack(push, 8) // Standard
-enum class Type {
+///* File format
+// <p>
+// The asset file is made to be mapped straight into memory
+// and used as it is. There are no pointers in it, everything
+// refers to other parts of the file with offsets, so nothing
+// has to be patched up when it's loaded. All fields have a
+// fixed size, are little endian and padded explicitly, so
+// the layout doesn't depend on the compiler.
+// </p>
+// <ul>
+//   <li>FileHeader, at the start of the file.</li>
+//   <li>Headers, one per asset at "headers_offset".</li>
+//   <li>Strings, the paths of the assets at "strings_offset".</li>
+//   <li>Names, a hash table from the hash of every path to
+//       its asset at "names_offset", see "fetch_by_name".</li>
+//   <li>Assets, every one starts on ASSET_ALIGNMENT. An asset
+//       is a Texture, Sound or Font followed by its data, the
+//       offsets to the data are from the start of the asset.</li>
+// </ul>
+// <p>
+// Assets that get a lot smaller are compressed, see
+// "util/compression.h". They are decompressed into memory
+// when the file is loaded, on all the threads, and the rest
+// are used straight from the file.
+// </p>
+// <p>
+// The version is bumped whenever the layout changes, and
+// files from other versions are refused.
+// </p>
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "The asset file is little endian");
+
+const u32 FILE_MAGIC = 'F' | 'O' << 8 | 'G' << 16 | '!' << 24;
+const u32 FILE_VERSION = 7;
+// Enough for any SIMD loads, and a cache line.
+const u64 ASSET_ALIGNMENT = 64;
+
+enum class Encoding : u32 {
+    RAW,
+    LZ4,
+};
+
+enum class Type : u32 {
     NONE,
     TEXTURE,
     FONT,
@@ -39,27 +116,107 @@ enum class Type {
 };
 
 struct FileHeader {
+    u32 magic;
+    u32 version;
     u64 number_of_assets;
-    u64 size_of_headers;
+    u64 headers_offset;
+    u64 strings_offset;
     u64 size_of_strings;
+    u64 names_offset;
+    u64 number_of_names;
+    u64 data_offset;
     u64 size_of_data;
 };
+static_assert(sizeof(FileHeader) == 72, "The file layout changed");
 
 struct Header {
-    // Relative pointer until "rebuild_pointers".
     Type type;
-    char *file_path;
-    u64 file_path_length;
+    u32 asset_id;
+    // Into the strings, the length counts the '\0'.
+    u64 path_offset;
+    u64 path_length;
     u64 timestamp;
+    // From the start of the file.
     u64 offset;
-    u32 asset_size;
+    // How large the asset is once it's loaded.
+    u64 asset_size;
+    // How much of the file it takes up.
+    u64 stored_size;
+    Encoding encoding;
+    u32 padding;
+};
+static_assert(sizeof(Header) == 64, "The file layout changed");
+
+// A slot in the table of names. A name starts looking in
+// the slot its hash points to, and moves on to the next
+// one until it finds itself or an empty slot.
+struct Name {
+    u64 hash;
+    // ASSET_ID_NO_ASSET if the slot is empty.
     u32 asset_id;
+    u32 padding;
+};
+static_assert(sizeof(Name) == 16, "The file layout changed");
+
+// Twice as many slots as assets, and a power of two, so
+// a name is almost always in the first slot it looks in.
+constexpr u64 name_table_size(u64 num_assets) {
+    u64 size = 1;
+    while (size < num_assets * 2)
+        size *= 2;
+    return size;
+}
+
+// Returns what's "offset" bytes after "base".
+template <typename T>
+const T *at_offset(const void *base, u64 offset) {
+    return (const T *) ((const u8 *) base + offset);
+}
+
+// Small images are sprites, packed together into the pages
+// of an ATLAS by mist so they share a layer on the GPU. A
+// sprite has no pixels of its own, it says where it is in
+// the page. The page is a Texture too, that fills the layer.
+struct Texture {
+    u32 width;
+    u32 height;
+    u16 components;
+    // The layer it's uploaded to.
+    u16 id;
+    // Where it is in the layer.
+    u16 x;
+    u16 y;
+    // The page with the pixels, or ASSET_ID_NO_ASSET
+    // if they come right after.
+    u32 atlas;
+    // The smaller copies for when it's drawn small,
+    // they come after the first.
+    u16 levels;
+    ImageFormat format;
+    u64 pixels_offset;
+    u64 size;
+
+    // Only in the file, a fetched texture doesn't
+    // keep its pixels, the GPU has them.
+    const u8 *pixels() const {
+        return at_offset<u8>(this, pixels_offset);
+    }
+
+    Image image() const {
+        return {(u8 *) pixels(), width, height, (u8) components, id,
+                (u8) levels, format};
+    }
 };
+static_assert(sizeof(Texture) == 40, "The file layout changed");
+
+// Enough for 512x512, down to one pixel.
+const u32 MAX_TEXTURE_LEVELS = 10;
 
 // NOTE(ed): Only ASCII is supported.
 struct Font {
     struct Glyph {
         u8 id;
+        u8 padding[3];
         f32 x, y;
         f32 w, h;
         f32 x_offset, y_offset;
@@ -68,6 +225,7 @@ struct Font {
 
     struct Kerning {
         u16 key;
+        u16 padding;
         f32 ammount;
 
         bool operator< (const Kerning &other) const {
@@ -75,46 +233,82 @@ struct Font {
         }
     };
 
-    f32 find_kerning(char a, char b) {
+    // The distance field, it's loaded with the font,
+    // and the layer it's uploaded to.
+    u32 texture;
+    u16 layer;
+    u16 padding;
+    f32 height;
+    u32 num_glyphs;
+    u64 num_kernings;
+    u64 glyphs_offset;
+    u64 kernings_offset;
+
+    const Glyph *glyphs() const {
+        return at_offset<Glyph>(this, glyphs_offset);
+    }
+
+    const Kerning *kernings() const {
+        return at_offset<Kerning>(this, kernings_offset);
+    }
+
+    f32 find_kerning(char a, char b) const {
         u16 key = (a << 8) | b;
+        const Kerning *table = kernings();
         s64 low = 0;
         s64 high = num_kernings;
         s64 last_guess = -1;
         while (low <= high) {
             s64 cur = (low + high) / 2;
-            if (cur < 0 || num_kernings < cur || cur == last_guess)
+            if (cur < 0 || num_kernings <= (u64) cur || cur == last_guess)
                 break;
             last_guess = cur;
-            u16 cur_key = kernings[cur].key;
+            u16 cur_key = table[cur].key;
             if (cur_key > key)
                 high = cur + 1;
             else if (cur_key < key)
                 low = cur + 1;
             else
-                return kernings[cur].ammount;
+                return table[cur].ammount;
         }
         return 0;
     }
-
-    u64 texture;
-    f32 height;
-    const s64 num_glyphs = 256;
-    s64 num_kernings;
-
-    Glyph *glyphs;
-    Kerning *kernings;
 };
+static_assert(sizeof(Font::Glyph) == 32, "The file layout changed");
+static_assert(sizeof(Font::Kerning) == 8, "The file layout changed");
+static_assert(sizeof(Font) == 40, "The file layout changed");
+static_assert(sizeof(Sound) == 32, "The file layout changed");
 
-struct Data {
-    union {
-        Image image;
-        Sound sound;
-        char *shader_source;
-        Font font;
-    };
+///* Residency
+// Where an asset is, as it goes from the file into memory.
+enum class Residency : u32 {
+    UNLOADED,
+    // Waiting for a loader thread.
+    QUEUED,
+    LOADING,
+    RESIDENT,
 };
 
-#pragma pack(pop)
+///*
+// Asks for the asset to be loaded on the loader threads and
+// holds a reference to it. Can be called from any thread.
+void acquire(AssetID id);
+
+///*
+// Lets go of a reference, when there are none left the
+// asset is freed on the next "update", unless it has been
+// fetched with "fetch_*". Can be called from any thread.
+void release(AssetID id);
+
+///*
+// Where the asset is right now.
+Residency residency(AssetID id);
+
+///*
+// Uploads the textures that have loaded and frees the
+// assets no one holds a reference to. Called once a frame
+// on the main thread, before drawing.
+void update();
 
 ///*
 // Checks if the passed in "id" is mapped to an image,
@@ -122,7 +316,7 @@ struct Data {
 // not recommended to modify any data received from the
 // asset system, as multiple threads could be reading
 // from it and it's bound to cause headaches.
-Image *fetch_image(AssetID id);
+const Texture *fetch_image(AssetID id);
 
 ///*
 // Checks if the passed in "id" is mapped to a font,
@@ -130,19 +324,36 @@ Image *fetch_image(AssetID id);
 // not recommended to modify any data received from the
 // asset system, as multiple threads could be reading
 // from it and it's bound to cause headaches.
-Font *fetch_font(AssetID id);
+const Font *fetch_font(AssetID id);
 
-};  // namespace Asset
+///*
+// The hash of the name of an asset, which is its path as it
+// was given to mist, like "res/test.png". It's FNV-1a, and
+// can be worked out when the game is compiled.
+////
+// constexpr u64 HIT = Asset::hash_name("res/hit.wav");
+// Mixer::play_sound(Asset::fetch_by_hash(HIT));
+constexpr u64 hash_name(const char *name) {
+    u64 hash = 0xCBF29CE484222325;
+    for (; *name; name++)
+        hash = (hash ^ (u8) *name) * 0x100000001B3;
+    return hash;
+}
+
+///*
+// Looks up the AssetID of a name, or of the hash of a name,
+// in the table mist writes into the asset file. It takes
+// about as long as a single hash table lookup. Returns
+// ASSET_ID_NO_ASSET if there is no such asset. The names
+// themselves aren't compared, only their hashes.
+AssetID fetch_by_hash(u64 hash);
+AssetID fetch_by_name(const char *name);
 
-// The file format: 
-//
-// Number of Assets,
-// Size of String list,
-// Size of header,
-// size of body
-// =============================
-// String list
-// =============================
-// Headers
-// =============================
-// Assets
+///*
+// Like "fetch_*", but returns nullptr right away if the asset
+// isn't resident. What is returned is only safe to use while
+// holding a reference from "acquire".
+const Texture *try_fetch_image(AssetID id);
+const Font *try_fetch_font(AssetID id);
+
+};  // namespace Asset
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+namespace Bake {
+
+TextureOptions texture_options = {1, false};
+
+//
+// Used to read in the WAV header.
+//
+struct WAVHeader {
+    char riff[4];
+    s32 size;
+    char wave[4];
+
+    // FMT chunk
+    char fmt[4];
+    s32 fmt_size;
+    s16 format;
+    s16 channels;
+    s32 sample_rate;
+    s32 byte_rate;
+    s16 block_align;
+    s16 bitdepth;
+
+};
+
+struct WAVChunk {
+    char type[4];
+    s32 size;
+};
+
+struct WAVData {
+    u32 size;
+    f32 *data;
+    WAVData *next;
+};
+
+// .sdf is for the font files, they are loaded in the font
+// pass only if there is a matching .fnt file.
+const std::unordered_map<std::string, Asset::Type> valid_endings = {
+    // Image file formats
+    {".psd", Asset::Type::TEXTURE},
+    {".png", Asset::Type::TEXTURE},
+    {".jpg", Asset::Type::TEXTURE},
+    {".bmp", Asset::Type::TEXTURE},
+
+    // Fonts
+    {".fnt", Asset::Type::FONT},
+
+    // Sound
+    {".wav", Asset::Type::SOUND},
+    // TODO(ed): This might be nice to have
+    // {".ogg", Asset::Type::SOUND},
+
+    // Config files? Is this a good idea?
+    {".cfg", Asset::Type::CONFIG},
+};
+
+Asset::Type type_of(const std::string &path) {
+    size_t pos = path.find_last_of(".");
+    if (pos == std::string::npos) return Asset::Type::NONE;
+    auto ending = valid_endings.find(path.substr(pos));
+    if (ending == valid_endings.end()) return Asset::Type::NONE;
+    return ending->second;
+}
+
+u64 align(u64 offset) {
+    return (offset + Asset::ASSET_ALIGNMENT - 1) & ~(Asset::ASSET_ALIGNMENT - 1);
+}
+
+// Adds "num" things to the end of the blob, aligned so they
+// can be read with SIMD, and returns where they start.
+template <typename T>
+u64 append(Blob *blob, const T *data, u64 num = 1) {
+    u64 offset = align(blob->bytes.size());
+    blob->bytes.resize(offset + sizeof(T) * num);
+    if (num)
+        memcpy(blob->bytes.data() + offset, data, sizeof(T) * num);
+    return offset;
+}
+
+// The asset at the start of the blob, this moves
+// when something is appended.
+template <typename T>
+T *first(Blob *blob) {
+    return (T *) blob->bytes.data();
+}
+
+void bake(Baked *baked, const std::string &path, Asset::Type type,
+          Blob *blob) {
+    baked->push_back({path, type, std::move(*blob)});
+}
+
+bool load_texture(Baked *baked, const std::string &path) {
+    int w, h, c;
+    u8 *buffer = stbi_load(path.c_str(), &w, &h, &c, 0);
+    if (!buffer) return false;
+    if (w > 512 || h > 512) {
+        printf("Cannot load %s, because it is too large.\n", path.c_str());
+    }
+    // The id is set when it's added to the file.
+    Asset::Texture texture = {(u32) w, (u32) h, (u16) c, 0, 0, 0,
+                              Asset::ASSET_ID_NO_ASSET, 1,
+                              ImageFormat::PIXELS, 0, (u64) w * h * c};
+    Blob blob;
+    append(&blob, &texture);
+    u64 pixels = append(&blob, buffer, texture.size);
+    first<Asset::Texture>(&blob)->pixels_offset = pixels;
+    stbi_image_free(buffer);
+    bake(baked, path, Asset::Type::TEXTURE, &blob);
+    return true;
+}
+
+long read_next_long(char **read_head) {
+    *read_head = strchr(*read_head, '=') + 1;
+    assert(*read_head && **read_head);
+    return strtol(*read_head, read_head, 10);
+}
+
+bool starts_with(const char *a, const char *b) {
+    while (*b && *(a) == *(b)) {a++; b++;};
+    return *b == '\0';
+}
+
+void load_font(Baked *baked, const std::string &path) {
+    Asset::Font font = {};
+    {
+        // The distance field has the same name, and is
+        // baked right before the font.
+        std::string sdf_path = path.substr(0, path.size() - 3) + "sdf";
+        bool has_sdf = load_texture(baked, sdf_path);
+        assert(has_sdf);
+    }
+    // TODO(ed): This is hard coded for a reason, maybe make this
+    // more explicit...
+    float inv_width  = 1.0 / 512.0;
+    float inv_height = 1.0 / 512.0;
+    FILE *font_file = fopen(path.c_str(), "r");
+    assert(font_file);
+    char *read_line = nullptr;
+    size_t size = 0;
+    // TODO: Might switch O(n) for O(nlogn) to save space.
+    font.num_glyphs = 256;
+    std::vector<Asset::Font::Glyph> glyphs(font.num_glyphs);
+    std::vector<Asset::Font::Kerning> kernings;
+    long expected_glyphs = 0, expected_kernings = 0;
+    while (getline(&read_line, &size, font_file) != -1) {
+        char *line = read_line;
+        if (starts_with(line, "char")) {
+            if (starts_with(line, "chars")) {
+                expected_glyphs = read_next_long(&line);
+                assert(expected_glyphs);
+            } else {
+                Asset::Font::Glyph g = {
+                    // id
+                    (u8) read_next_long(&line),
+                    {},
+                    // x, y
+                    read_next_long(&line) * inv_width,
+                    read_next_long(&line) * inv_height,
+                    // w, h
+                    read_next_long(&line) * inv_width,
+                    read_next_long(&line) * inv_height,
+                    // xo, yo
+                    read_next_long(&line) * inv_width,
+                    read_next_long(&line) * inv_height,
+                    // advance
+                    read_next_long(&line) * inv_width
+                };
+                font.height = std::max(g.h, font.height);
+                glyphs[g.id] = g;
+            }
+        } else if (starts_with(line, "kerning")) {
+            if (starts_with(line, "kernings")) {
+                expected_kernings = read_next_long(&line);
+                kernings.reserve(expected_kernings);
+            } else {
+                long first = read_next_long(&line);
+                long second = read_next_long(&line);
+                assert(first <= 0xFF && second <= 0xFF);
+                kernings.push_back({
+                    (u16) (first << 8 | second),
+                    0,
+                    read_next_long(&line) * inv_width
+                });
+            }
+        }
+
+        free(read_line);
+        read_line = nullptr;
+        size = 0;
+    }
+    fclose(font_file);
+    assert(expected_kernings == (long) kernings.size());
+    std::sort(kernings.begin(), kernings.end());
+    font.num_kernings = kernings.size();
+
+    Blob blob;
+    append(&blob, &font);
+    u64 glyphs_offset = append(&blob, glyphs.data(), glyphs.size());
+    u64 kernings_offset = append(&blob, kernings.data(), kernings.size());
+    first<Asset::Font>(&blob)->glyphs_offset = glyphs_offset;
+    first<Asset::Font>(&blob)->kernings_offset = kernings_offset;
+    bake(baked, path, Asset::Type::FONT, &blob);
+}
+
+void load_sound(Baked *baked, const std::string &path) {
+    FILE *wav_file = fopen(path.c_str(), "rb");
+    fseek(wav_file, 0, SEEK_END);
+    long end = ftell(wav_file);
+    rewind(wav_file);
+
+    WAVHeader wav_header;
+    fread((WAVHeader *) &wav_header, sizeof(wav_header), 1, wav_file);
+    if (wav_header.format != 1 && wav_header.format != 3) {
+        printf("Failed to load \"%s\", only accepts uncompressed data (%d)\n",
+               path.c_str(), wav_header.format);
+        fclose(wav_file);
+        return;
+    }
+
+    if (wav_header.channels > 2) {
+        printf("Failed to load \"%s\", only supports 1 or 2 channels (%d)\n",
+               path.c_str(), wav_header.format);
+        fclose(wav_file);
+        return;
+    }
+
+    std::vector<u8> data;
+    while (end != ftell(wav_file)) {
+        WAVChunk chunk;
+        fread(&chunk, sizeof(WAVChunk), 1, wav_file);
+        if (chunk.type[0] == 'd' && chunk.type[1] == 'a' &&
+            chunk.type[2] == 't' && chunk.type[3] == 'a') {
+            u64 size = data.size();
+            data.resize(size + chunk.size);
+            fread((void *) (data.data() + size), 1, chunk.size, wav_file);
+        } else {
+            fseek(wav_file, chunk.size, SEEK_CUR);
+        }
+    }
+    fclose(wav_file);
+
+    Sound sound = {};
+    sound.size = data.size();
+    sound.num_samples = data.size() / (wav_header.channels * wav_header.bitdepth / 8);
+    sound.sample_rate = wav_header.sample_rate;
+    sound.bits_per_sample = wav_header.bitdepth;
+    sound.is_stereo = 1 < wav_header.channels;
+
+    Blob blob;
+    append(&blob, &sound);
+    u64 samples = append(&blob, data.data(), data.size());
+    first<Sound>(&blob)->samples_offset = samples;
+    bake(baked, path, Asset::Type::SOUND, &blob);
+}
+
+void process_asset(Baked *baked, const std::string *path) {
+    Asset::Type type = type_of(*path);
+    if (type == Asset::Type::NONE) return;
+
+    switch (type) {
+        case (Asset::Type::TEXTURE):
+            load_texture(baked, *path);
+            break;
+        case (Asset::Type::FONT):
+            load_font(baked, *path);
+            break;
+        case (Asset::Type::SOUND):
+            load_sound(baked, *path);
+            break;
+        default:
+            printf("!!!! Unhandled asset, unkown type: %s, %d\n", path->c_str(),
+                   (int) type);
+            return;
+    }
+}
+
+// The smaller levels are filtered, so the gutter has to
+// be at least a pixel wide in them.
+u32 atlas_gutter() {
+    u32 gutter = 1 << (texture_options.levels - 1);
+    return CLAMP(ATLAS_GUTTER, MAX_ATLAS_GUTTER, gutter);
+}
+
+// The space for a sprite in its page, it's rounded so every
+// block and every pixel of the smaller levels only covers one
+// sprite, otherwise they bleed into each other.
+u32 cell_size(u32 size) {
+    u32 alignment = MIN(1u << (texture_options.levels - 1), MAX_ATLAS_GUTTER);
+    if (texture_options.block_compress)
+        alignment = MAX(alignment, BlockCompression::BLOCK_SIZE);
+    return (size + 2 * atlas_gutter() + alignment - 1) / alignment * alignment;
+}
+
+// A pixel as RGBA, the same way stb_image would expand it.
+void to_rgba(const u8 *from, u32 components, u8 *to) {
+    if (components < 3) {
+        to[0] = to[1] = to[2] = from[0];
+        to[3] = components == 2 ? from[1] : 255;
+    } else {
+        memcpy(to, from, components);
+        to[3] = components == 4 ? from[3] : 255;
+    }
+}
+
+// Copies the sprite into its cell in the page as RGBA, the
+// edge is repeated out to the edges of the cell.
+void copy_to_page(u8 *page, const Asset::Texture *sprite, const u8 *pixels,
+                  u32 cell_x, u32 cell_y) {
+    s32 width = sprite->width;
+    s32 height = sprite->height;
+    for (u32 y = cell_y; y < cell_y + cell_size(height); y++) {
+        for (u32 x = cell_x; x < cell_x + cell_size(width); x++) {
+            s32 from_x = CLAMP(0, width - 1, (s32) x - sprite->x);
+            s32 from_y = CLAMP(0, height - 1, (s32) y - sprite->y);
+            to_rgba(pixels + (from_y * width + from_x) * sprite->components,
+                    sprite->components, page + (y * ATLAS_SIZE + x) * 4);
+        }
+    }
+}
+
+// Every pixel is the average of four, the colors are weighted
+// by alpha so what can't be seen doesn't darken the edges.
+std::vector<u8> half_size(const std::vector<u8> &pixels, u32 width, u32 height,
+                          u32 components) {
+    u32 half_width = MAX(width / 2, 1u);
+    u32 half_height = MAX(height / 2, 1u);
+    std::vector<u8> half(half_width * half_height * components);
+    for (u32 y = 0; y < half_height; y++) {
+        for (u32 x = 0; x < half_width; x++) {
+            const u8 *from[4];
+            for (u32 i = 0; i < 4; i++) {
+                u32 from_x = MIN(x * 2 + i % 2, width - 1);
+                u32 from_y = MIN(y * 2 + i / 2, height - 1);
+                from[i] = pixels.data() + (from_y * width + from_x) * components;
+            }
+            u8 *to = half.data() + (y * half_width + x) * components;
+            u32 alpha = 0;
+            if (components == 4)
+                for (u32 i = 0; i < 4; i++)
+                    alpha += from[i][3];
+            for (u32 c = 0; c < components; c++) {
+                u32 sum = 0;
+                if (c < 3 && components == 4 && alpha) {
+                    for (u32 i = 0; i < 4; i++)
+                        sum += from[i][c] * from[i][3];
+                    to[c] = (sum + alpha / 2) / alpha;
+                } else {
+                    for (u32 i = 0; i < 4; i++)
+                        sum += from[i][c];
+                    to[c] = (sum + 2) / 4;
+                }
+            }
+        }
+    }
+    return half;
+}
+
+// Adds the smaller levels and encodes them as BC3, if it's
+// asked for, so textures are stored the way the GPU wants.
+// Sprites are done with their page.
+void bake_levels(Blob *blob) {
+    Asset::Texture texture = *first<Asset::Texture>(blob);
+    if (texture.atlas != Asset::ASSET_ID_NO_ASSET) return;
+    u32 levels = 1;
+    while (levels < texture_options.levels &&
+           (texture.width >> levels || texture.height >> levels))
+        levels++;
+    if (levels == 1 && !texture_options.block_compress) return;
+
+    const u8 *pixels = blob->bytes.data() + texture.pixels_offset;
+    std::vector<u8> level(pixels, pixels + texture.size);
+    if (texture_options.block_compress && texture.components != 4) {
+        std::vector<u8> rgba((u64) texture.width * texture.height * 4);
+        for (u64 i = 0; i < (u64) texture.width * texture.height; i++)
+            to_rgba(&level[i * texture.components], texture.components,
+                    &rgba[i * 4]);
+        level.swap(rgba);
+        texture.components = 4;
+    }
+    texture.levels = levels;
+    texture.format = texture_options.block_compress ? ImageFormat::BC3
+                                                    : ImageFormat::PIXELS;
+    const Image image = texture.image();
+
+    std::vector<u8> data;
+    for (u32 i = 0; i < levels; i++) {
+        u32 width = image.level_width(i), height = image.level_height(i);
+        if (i)
+            level = half_size(level, image.level_width(i - 1),
+                              image.level_height(i - 1), texture.components);
+        u64 at = data.size();
+        data.resize(at + image.level_size(i));
+        if (texture_options.block_compress)
+            BlockCompression::encode_bc3(level.data(), width, height, &data[at]);
+        else
+            memcpy(&data[at], level.data(), level.size());
+    }
+    texture.size = data.size();
+    Blob baked;
+    append(&baked, &texture);
+    texture.pixels_offset = append(&baked, data.data(), data.size());
+    *first<Asset::Texture>(&baked) = texture;
+    blob->bytes.swap(baked.bytes);
+}
+
+}  // namespace Bake
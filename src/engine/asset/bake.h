@@ -0,0 +1,68 @@
+///# Baking
+// How the files in "res" are turned into assets. Mist bakes
+// all of them into the asset file, and debug builds bake a
+// file again when it changes, see "asset/hot_reload.cpp".
+
+#include <string>
+#include <vector>
+
+namespace Bake {
+
+// An asset as it's written to the file, a Texture,
+// Sound or Font followed by its data.
+struct Blob {
+    std::vector<u8> bytes;
+};
+
+// An asset that is ready to be added to the file, but
+// doesn't have an id yet.
+struct BakedAsset {
+    std::string path;
+    Asset::Type type;
+    Blob blob;
+};
+
+// Every file is baked on its own, on any thread, into
+// one or more assets.
+typedef std::vector<BakedAsset> Baked;
+
+// The size of a layer on the GPU, a page of the atlas fills one.
+const u32 ATLAS_SIZE = 512;
+// Sprites are drawn with nearest filtering, but a UV on the
+// edge can round to the texel next to it, so the edge of
+// every sprite is repeated around it.
+const u32 ATLAS_GUTTER = 1;
+
+// Sprites are kept apart in the first 4 levels, the ones
+// after that blend sprites next to each other, which only
+// shows when they're drawn at a sixteenth of their size.
+const u32 MAX_ATLAS_GUTTER = 8;
+
+// How textures are baked, set on the command line.
+struct TextureOptions {
+    u32 levels;
+    bool block_compress;
+};
+
+// The type of asset the file is baked into, from its
+// ending, NONE if it isn't an asset.
+Asset::Type type_of(const std::string &path);
+
+// Bakes the file into "baked", nothing is added if
+// it fails.
+void process_asset(Baked *baked, const std::string *path);
+
+// The space between sprites, and the space a sprite
+// takes in its page.
+u32 atlas_gutter();
+u32 cell_size(u32 size);
+
+// Copies the sprite into its cell in the page as RGBA.
+void copy_to_page(u8 *page, const Asset::Texture *sprite, const u8 *pixels,
+                  u32 cell_x, u32 cell_y);
+
+// Gives the texture its smaller levels, and encodes it
+// the way "texture_options" says.
+void bake_levels(Blob *blob);
+
+}  // namespace Bake
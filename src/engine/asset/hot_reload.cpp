@@ -0,0 +1,284 @@
+#include <sys/inotify.h>
+#include <time.h>
+#include <algorithm>
+#include <unordered_map>
+
+namespace Asset {
+
+// Debug builds watch the directories the assets were baked
+// from, and bake a file again in "update" when it's written.
+// The new asset takes the place of the old one in its slot,
+// textures are uploaded to the same layer and shaders are
+// compiled again. The asset file isn't touched, so mist has
+// to be run for the changes to stick, and for new files.
+struct Watcher {
+    int inotify = -1;
+    // The directory of every watch.
+    std::unordered_map<int, std::string> directories;
+    // Files that have been written, but not baked.
+    std::vector<std::string> changed;
+} watcher;
+
+static bool ends_with(const std::string &path, const char *ending) {
+    u64 length = strlen(ending);
+    return path.size() >= length &&
+           path.compare(path.size() - length, length, ending) == 0;
+}
+
+static const char *path_of(AssetID id) {
+    return system.strings + system.headers[id].path_offset;
+}
+
+// Any file can be written, so the path is checked too.
+static AssetID find_asset(const std::string &path) {
+    AssetID id = fetch_by_name(path.c_str());
+    if (id == ASSET_ID_NO_ASSET || path != path_of(id))
+        return ASSET_ID_NO_ASSET;
+    return id;
+}
+
+// The asset as it is in the file, decompressed if it has to be.
+static std::vector<u8> read_from_file(AssetID id) {
+    const Header *header = system.headers + id;
+    const u8 *stored = system.mapping + header->offset;
+    if (header->encoding == Encoding::RAW)
+        return std::vector<u8>(stored, stored + header->stored_size);
+    std::vector<u8> asset(header->asset_size);
+    if (!Compression::decompress(stored, header->stored_size, asset.data(),
+                                 asset.size()))
+        asset.clear();
+    return asset;
+}
+
+static bool read_texture(AssetID id, Texture *texture) {
+    std::vector<u8> asset = read_from_file(id);
+    if (asset.size() < sizeof(Texture)) return false;
+    *texture = *(const Texture *) asset.data();
+    return true;
+}
+
+static bool is_busy(AssetID id) {
+    Residency residency = system.slots[id].residency;
+    return residency == Residency::QUEUED || residency == Residency::LOADING;
+}
+
+// Puts the asset in the slot, as if it was loaded from the
+// file, and it's kept since the file has the old one. The
+// old one is left where it is, someone could still be using
+// it. Returns false if the slot is busy loading.
+static bool install(AssetID id, Bake::Blob *blob) {
+    Header header = system.headers[id];
+    header.asset_size = blob->bytes.size();
+    if (!is_valid_asset(&header, blob->bytes.data())) {
+        ERR("\"%s\" baked into a broken asset", path_of(id));
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(loader.lock);
+    Slot *slot = system.slots + id;
+    if (is_busy(id)) return false;
+    bool is_texture = header.type == Type::TEXTURE || header.type == Type::ATLAS;
+    // No one gets the pixels of a texture, so they can go.
+    if (is_texture && slot->decompressed)
+        Util::pop_memory(slot->decompressed);
+    u8 *data = Util::push_memory<u8>(header.asset_size);
+    memcpy(data, blob->bytes.data(), header.asset_size);
+    slot->broken = false;
+    slot->data = data;
+    slot->decompressed = data;
+    if (is_texture)
+        slot->texture = *(const Texture *) data;
+    slot->kept = true;
+    if (!slot->needs_update) {
+        slot->needs_update = true;
+        loader.updates[loader.num_updates++] = id;
+    }
+    slot->residency.store(Residency::RESIDENT, std::memory_order_release);
+    return true;
+}
+
+// Textures are baked the same way as the one they replace,
+// every layer has the same levels and format.
+static void use_options_of(const Texture *texture) {
+    Bake::texture_options = {texture->levels,
+                             texture->format == ImageFormat::BC3};
+}
+
+// A sprite can't move, so the whole page is put together
+// again from the files of the sprites in it.
+static bool rebuild_page(AssetID page_id, AssetID changed, Bake::Blob *sprite) {
+    Texture page;
+    if (!read_texture(page_id, &page)) return true;
+    use_options_of(&page);
+
+    Bake::Blob blob;
+    Texture texture = {Bake::ATLAS_SIZE, Bake::ATLAS_SIZE, 4, page.id, 0, 0,
+                       ASSET_ID_NO_ASSET, 1, ImageFormat::PIXELS, 0,
+                       Bake::ATLAS_SIZE * Bake::ATLAS_SIZE * 4};
+    Bake::append(&blob, &texture);
+    texture.pixels_offset = Bake::align(blob.bytes.size());
+    blob.bytes.resize(texture.pixels_offset + texture.size);
+    *Bake::first<Texture>(&blob) = texture;
+
+    for (u64 id = 0; id < system.file_header->number_of_assets; id++) {
+        // Only a sprite is as small as a Texture.
+        const Header *header = system.headers + id;
+        if (header->type != Type::TEXTURE ||
+            header->asset_size != sizeof(Texture))
+            continue;
+        Texture placed;
+        if (!read_texture(id, &placed) || placed.atlas != page_id) continue;
+
+        Bake::Baked baked;
+        Bake::Blob *source = sprite;
+        if (id != changed) {
+            std::string path = path_of(id);
+            Bake::process_asset(&baked, &path);
+            if (baked.empty()) continue;
+            source = &baked[0].blob;
+        }
+        const Texture *loaded = Bake::first<Texture>(source);
+        if (loaded->width != placed.width || loaded->height != placed.height) {
+            ERR("\"%s\" changed size, run mist to place it again", path_of(id));
+            continue;
+        }
+        placed.components = loaded->components;
+        u32 gutter = Bake::atlas_gutter();
+        Bake::copy_to_page(blob.bytes.data() + texture.pixels_offset, &placed,
+                           source->bytes.data() + loaded->pixels_offset,
+                           placed.x - gutter, placed.y - gutter);
+    }
+    Bake::bake_levels(&blob);
+    return install(page_id, &blob);
+}
+
+enum class Reload {
+    DONE,
+    FAILED,
+    // The asset is loading, it's tried again next frame.
+    WAIT,
+};
+
+static Reload reload_file(const std::string &path) {
+    if (ends_with(path, ".glsl")) {
+        Renderer::reload_shaders();
+        return Reload::DONE;
+    }
+    // The distance field is baked with its font.
+    std::string source = path;
+    if (ends_with(path, ".sdf"))
+        source = path.substr(0, path.size() - 3) + "fnt";
+    AssetID id = find_asset(source);
+    if (id == ASSET_ID_NO_ASSET) {
+        if (Bake::type_of(source) != Type::NONE)
+            ERR("\"%s\" isn't in the asset file, run mist to add it",
+                source.c_str());
+        return Reload::FAILED;
+    }
+    if (is_busy(id)) return Reload::WAIT;
+
+    Bake::Baked baked;
+    Bake::process_asset(&baked, &source);
+    if (baked.empty()) {
+        ERR("Failed to bake \"%s\"", source.c_str());
+        return Reload::FAILED;
+    }
+    // The texture of a font is baked right before it.
+    u16 last_texture = 0;
+    AssetID last_texture_id = ASSET_ID_NO_ASSET;
+    for (Bake::BakedAsset &asset : baked) {
+        AssetID asset_id = find_asset(asset.path);
+        if (asset_id == ASSET_ID_NO_ASSET) continue;
+        if (asset.type == Type::TEXTURE) {
+            Texture old;
+            if (!read_texture(asset_id, &old)) continue;
+            if (old.atlas != ASSET_ID_NO_ASSET) {
+                if (!rebuild_page(old.atlas, asset_id, &asset.blob))
+                    return Reload::WAIT;
+                continue;
+            }
+            Bake::first<Texture>(&asset.blob)->id = old.id;
+            last_texture = old.id;
+            last_texture_id = asset_id;
+            use_options_of(&old);
+            Bake::bake_levels(&asset.blob);
+        } else if (asset.type == Type::FONT) {
+            Font *font = Bake::first<Font>(&asset.blob);
+            font->texture = last_texture_id;
+            font->layer = last_texture;
+        }
+        if (!install(asset_id, &asset.blob)) return Reload::WAIT;
+    }
+    return Reload::DONE;
+}
+
+static void start_watching() {
+    watcher.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher.inotify == -1) {
+        ERR("Failed to watch the assets for changes");
+        return;
+    }
+    auto watch = [](const std::string &directory) {
+        for (auto &watched : watcher.directories)
+            if (watched.second == directory) return;
+        int id = inotify_add_watch(watcher.inotify, directory.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (id != -1)
+            watcher.directories[id] = directory;
+    };
+    // The shaders are read straight from "res".
+    watch("res");
+    for (u64 id = 0; id < system.file_header->number_of_assets; id++) {
+        std::string path = path_of(id);
+        size_t end = path.find_last_of('/');
+        watch(end == std::string::npos ? "." : path.substr(0, end));
+    }
+}
+
+static void reload_changed() {
+    if (watcher.inotify == -1) return;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(watcher.inotify, buffer, sizeof(buffer))) > 0) {
+        for (char *at = buffer; at < buffer + length;) {
+            const inotify_event *event = (const inotify_event *) at;
+            at += sizeof(inotify_event) + event->len;
+            auto directory = watcher.directories.find(event->wd);
+            if (!event->len || directory == watcher.directories.end())
+                continue;
+            std::string path = directory->second + "/" + event->name;
+            if (!ends_with(path, ".glsl") && !ends_with(path, ".sdf") &&
+                Bake::type_of(path) == Type::NONE)
+                continue;
+            // Editors can write a file more than once.
+            if (std::find(watcher.changed.begin(), watcher.changed.end(),
+                          path) == watcher.changed.end())
+                watcher.changed.push_back(path);
+        }
+    }
+
+    std::vector<std::string> waiting;
+    for (const std::string &path : watcher.changed) {
+        timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Reload reload = reload_file(path);
+        if (reload == Reload::WAIT)
+            waiting.push_back(path);
+        if (reload != Reload::DONE) continue;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        LOG("Reloaded \"%s\" in %.1f ms", path.c_str(),
+            (end.tv_sec - start.tv_sec) * 1000.0 +
+            (end.tv_nsec - start.tv_nsec) / 1000000.0);
+    }
+    watcher.changed.swap(waiting);
+}
+
+static void stop_watching() {
+    if (watcher.inotify != -1)
+        close(watcher.inotify);
+    watcher.inotify = -1;
+    watcher.directories.clear();
+    watcher.changed.clear();
+}
+
+}  // namespace Asset
@@ -14,296 +14,414 @@
 #include "util/debug.cpp"
 #include "math/block_math.h"
 #include "asset/asset.h"
+#include "asset/bake.h"
+#include "util/memory.h"
+#include "util/jobs.h"
+#include "util/compression.h"
+#include "util/block_compression.h"
+
+#include "util/memory.cpp"
+#include "util/jobs.cpp"
+#include "util/compression.cpp"
+#include "util/block_compression.cpp"
 
 #define STB_IMAGE_IMPLEMENTATION
+// The failure string is a global, which the
+// threads would fight over.
+#define STBI_NO_FAILURE_STRINGS
 #include <stb_image.h>
 
-//
-// Used to read in the WAV header.
-//
-struct WAVHeader {
-    char riff[4];
-    s32 size;
-    char wave[4];
-
-    // FMT chunk
-    char fmt[4];
-    s32 fmt_size;
-    s16 format;
-    s16 channels;
-    s32 sample_rate;
-    s32 byte_rate;
-    s16 block_align;
-    s16 bitdepth;
-
-};
+#include "asset/bake.cpp"
 
-struct WAVChunk {
-    char type[4];
-    s32 size;
-};
-
-struct WAVData {
-    u32 size;
-    f32 *data;
-    WAVData *next;
-};
+using namespace Bake;
 
 struct AssetFile {
-    Asset::FileHeader header;
     std::vector<Asset::Header> asset_headers;
-    std::vector<Asset::Data> assets;
+    std::vector<std::string> paths;
+    std::vector<Blob> blobs;
+    u16 num_textures;
+    // The assets that are packed into an atlas.
+    std::vector<u32> sprites;
 };
 
-std::unordered_map<std::string, Asset::Type> valid_endings;
-
-// Generate a source file containing IDs to the source code.
+s64 add_asset_to_file(AssetFile *file, const std::string &path,
+                      Asset::Type type, Blob *blob) {
+    Asset::Header header = {};
+    header.type = type;
+    header.asset_id = file->asset_headers.size();
+    header.path_length = path.size() + 1;
+    header.asset_size = blob->bytes.size();
+    header.stored_size = header.asset_size;
+    header.encoding = Asset::Encoding::RAW;
+
+    file->asset_headers.push_back(header);
+    file->paths.push_back(path);
+    file->blobs.push_back(std::move(*blob));
+    assert(file->asset_headers.size() == file->blobs.size());
+    return header.asset_id;
+}
 
-Asset::Header get_asset_header(const std::string *path, Asset::Type type) {
-    char *file_path = (char *) malloc(path->size() * sizeof(path[0]));
-    const char *from = path->c_str();
-    char *to = file_path;
-    while (*from) *(to++) = *(from++);
-    *(to++) = *(from++);
-    // struct stat buffer;
-    // if (stat(file_path, &buffer) == -1) return {};
-
-    return {type,
-            file_path,
-            path->size() + 1,
-            0,  // buffer.st_mtime,
-            0,  //(u32) buffer.st_size,
-            Asset::ASSET_ID_NO_ASSET};
+template <typename T>
+size_t write_to_file(FILE *stream, const T *ptr, size_t num = 1) {
+    auto write = fwrite(ptr, sizeof(T), num, stream);
+    ASSERT(write == num, "Failed to read from asset file");
+    return write * sizeof(T);
 }
 
-void add_asset_to_file(AssetFile *file, Asset::Header *header, Asset::Data *asset) {
-    assert(header);
-    assert(asset);
-    header->asset_id = file->asset_headers.size();
+//
+// The cache, every baked file is kept in the cache directory
+// under a hash of everything that went into it. If nothing
+// has changed the file isn't baked again.
+//
 
-    file->header.number_of_assets++;
-    file->header.size_of_strings += header->file_path_length;
-    file->header.size_of_headers += sizeof(Asset::Header);
-    file->header.size_of_data += header->asset_size;
+// Bump this when anything changes how assets are baked,
+// so old cache entries aren't used.
+const u32 BAKER_VERSION = 1;
+const u32 CACHE_MAGIC = 'M' | 'I' << 8 | 'S' << 16 | 'T' << 24;
+const u64 NO_KEY = 0;
+
+u64 hash_bytes(u64 hash, const void *data, u64 size) {
+    // FNV-1a
+    const u8 *bytes = (const u8 *) data;
+    for (u64 i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001B3;
+    return hash;
+}
 
-    file->asset_headers.push_back(*header);
-    file->assets.push_back(*asset);
-    assert(file->asset_headers.size() == file->assets.size());
+bool hash_file(u64 *hash, const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    u8 buffer[1 << 16];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)))
+        *hash = hash_bytes(*hash, buffer, read);
+    fclose(file);
+    return true;
 }
 
-void load_texture(AssetFile *file, Asset::Header *header) {
-    static u16 id = 0;
-    int w, h, c;
-    u8 *buffer = stbi_load(header->file_path, &w, &h, &c, 0);
-    if (w > 512 || h > 512) {
-        printf("Cannot load %s, because it is too large.\n", header->file_path);
-    }
-    if (!buffer) return;
-    Image image = {buffer, (u32) w, (u32) h, (u8) c, id++};
-    header->asset_size = sizeof(Asset::Data) + w * h * c * sizeof(u8);
-    Asset::Data asset = {image};
+// Every file that's read when baking "path".
+std::vector<std::string> sources_of(const std::string &path) {
+    std::vector<std::string> sources = {path};
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".fnt") == 0)
+        sources.push_back(path.substr(0, path.size() - 3) + "sdf");
+    return sources;
+}
 
-    add_asset_to_file(file, header, &asset);
+u64 cache_key(const std::string &path) {
+    u64 hash = 0xCBF29CE484222325;
+    hash = hash_bytes(hash, &BAKER_VERSION, sizeof(BAKER_VERSION));
+    hash = hash_bytes(hash, &Asset::FILE_VERSION, sizeof(Asset::FILE_VERSION));
+    hash = hash_bytes(hash, path.c_str(), path.size() + 1);
+    for (const std::string &source : sources_of(path))
+        if (!hash_file(&hash, source)) return NO_KEY;
+    return hash == NO_KEY ? 1 : hash;
 }
 
-long read_next_long(char **read_head) {
-    *read_head = strchr(*read_head, '=') + 1;
-    assert(*read_head && **read_head);
-    return strtol(*read_head, read_head, 10);
+std::string cache_path(const char *cache_dir, u64 key) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016lx.bake", key);
+    return cache_dir + std::string(name);
 }
 
-bool starts_with(const char *a, const char *b) {
-    while (*b && *(a) == *(b)) {a++; b++;};
-    return *b == '\0';
+template <typename T>
+bool read_from_cache(FILE *stream, T *ptr, size_t num = 1) {
+    return fread(ptr, sizeof(T), num, stream) == num;
 }
 
-void load_font(AssetFile *file, Asset::Header *header) {
-    Asset::Font font = {};
-    {
-        Asset::Header sdf_header = *header;
-        sdf_header.asset_id = 0xFFFFFFF;  // Invalid value
-        sdf_header.type = Asset::Type::TEXTURE;
-        sdf_header.file_path = (char *) malloc(header->file_path_length);
-        strcpy(sdf_header.file_path, header->file_path);
-        sdf_header.file_path[header->file_path_length - 2] = 'f';
-        sdf_header.file_path[header->file_path_length - 3] = 'd';
-        sdf_header.file_path[header->file_path_length - 4] = 's';
-        load_texture(file, &sdf_header);
-        assert(sdf_header.asset_id != 0xFFFFFFF);
-        font.texture = file->assets[sdf_header.asset_id].image.id;
+bool load_from_cache(Baked *baked, const char *cache_dir, u64 key) {
+    FILE *file = fopen(cache_path(cache_dir, key).c_str(), "rb");
+    if (!file) return false;
+    u32 magic = 0, num_assets = 0;
+    bool ok = read_from_cache(file, &magic) && magic == CACHE_MAGIC
+           && read_from_cache(file, &num_assets);
+    for (u32 i = 0; ok && i < num_assets; i++) {
+        BakedAsset asset;
+        u32 path_length = 0;
+        u64 size = 0;
+        ok = read_from_cache(file, &asset.type)
+          && read_from_cache(file, &path_length);
+        if (!ok) break;
+        asset.path.resize(path_length);
+        ok = read_from_cache(file, &asset.path[0], path_length)
+          && read_from_cache(file, &size);
+        if (!ok) break;
+        asset.blob.bytes.resize(size);
+        ok = read_from_cache(file, asset.blob.bytes.data(), size);
+        baked->push_back(std::move(asset));
     }
-    // TODO(ed): This is hard coded for a reason, maybe make this
-    // more explicit...
-    float inv_width  = 1.0 / 512.0;
-    float inv_height = 1.0 / 512.0;
-    FILE *font_file = fopen(header->file_path, "r");
-    assert(font_file);
-    char *read_line = nullptr;
-    size_t size = 0;
-    // TODO: Might switch O(n) for O(nlogn) to save space.
-    font.glyphs = (Asset::Font::Glyph *) malloc(font.num_glyphs * sizeof(Asset::Font::Glyph));
-    long expected_glyphs = 0, expected_kernings = 0;
-    while (getline(&read_line, &size, font_file) != -1) {
-        char *line = read_line;
-        if (starts_with(line, "char")) {
-            if (starts_with(line, "chars")) {
-                expected_glyphs = read_next_long(&line);
-                assert(expected_glyphs);
-            } else {
-                Asset::Font::Glyph g = {
-                    // id
-                    (u8) read_next_long(&line),
-                    // x, y
-                    read_next_long(&line) * inv_width,
-                    read_next_long(&line) * inv_height,
-                    // w, h
-                    read_next_long(&line) * inv_width,
-                    read_next_long(&line) * inv_height,
-                    // xo, yo
-                    read_next_long(&line) * inv_width,
-                    read_next_long(&line) * inv_height,
-                    // advance
-                    read_next_long(&line) * inv_width
-                };
-                font.height = std::max(g.h, font.height);
-                font.glyphs[g.id] = g;
-            }
-        } else if (starts_with(line, "kerning")) {
-            if (starts_with(line, "kernings")) {
-                expected_kernings = read_next_long(&line);
-                font.kernings = (Asset::Font::Kerning *) malloc(expected_kernings *
-                                                  sizeof(Asset::Font::Kerning));
-            } else {
-                long first = read_next_long(&line);
-                long second = read_next_long(&line);
-                assert(first <= 0xFF && second <= 0xFF);
-                font.kernings[font.num_kernings++] = {
-                    (u16) (first << 8 | second),
-                    read_next_long(&line) * inv_width
-                };
-            }
-        }
+    fclose(file);
+    // A broken entry is baked again.
+    if (!ok) baked->clear();
+    return ok;
+}
 
-        free(read_line);
-        read_line = nullptr;
-        size = 0;
+void save_to_cache(Baked *baked, const char *cache_dir, u64 key) {
+    std::string path = cache_path(cache_dir, key);
+    // Written to the side and moved in place, so a
+    // half written entry is never read.
+    std::string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file) return;
+    u32 num_assets = baked->size();
+    write_to_file(file, &CACHE_MAGIC);
+    write_to_file(file, &num_assets);
+    for (BakedAsset &asset : *baked) {
+        u32 path_length = asset.path.size();
+        u64 size = asset.blob.bytes.size();
+        write_to_file(file, &asset.type);
+        write_to_file(file, &path_length);
+        write_to_file(file, asset.path.c_str(), path_length);
+        write_to_file(file, &size);
+        write_to_file(file, asset.blob.bytes.data(), size);
     }
-    assert(expected_kernings == font.num_kernings);
-    std::sort(font.kernings, font.kernings + font.num_kernings);
-
-    header->asset_size = sizeof(Asset::Data) +
-                         sizeof(Asset::Font::Kerning) * font.num_kernings +
-                         sizeof(Asset::Font::Glyph)   * font.num_glyphs;
-    Asset::Data asset = {.font = font};
-    add_asset_to_file(file, header, &asset);
+    fclose(file);
+    rename(temporary.c_str(), path.c_str());
 }
 
-void load_atlas(AssetFile *file, Asset::Header *header) {
-    // TODO:
+// Returns true if it came from the cache.
+bool bake_or_fetch(Baked *baked, const std::string &path, const char *cache_dir) {
+    u64 key = cache_dir ? cache_key(path) : NO_KEY;
+    if (key != NO_KEY && load_from_cache(baked, cache_dir, key))
+        return true;
+    process_asset(baked, &path);
+    // Files that failed are baked again, so the
+    // error is shown every time.
+    if (key != NO_KEY && !baked->empty())
+        save_to_cache(baked, cache_dir, key);
+    return false;
 }
 
-void load_sound(AssetFile *file, Asset::Header *header) {
-    FILE *wav_file = fopen(header->file_path, "rb");
-    fseek(wav_file, 0, SEEK_END);
-    long end = ftell(wav_file);
-    rewind(wav_file);
-
-    WAVHeader wav_header;
-    fread((WAVHeader *) &wav_header, sizeof(wav_header), 1, wav_file);
-    if (wav_header.format != 1 && wav_header.format != 3) {
-        printf("Failed to load \"%s\", only accepts uncompressed data (%d)\n",
-               header->file_path, wav_header.format);
-        fclose(wav_file);
-        return;
-    }
+bool fits_in_atlas(const Asset::Texture *texture) {
+    return cell_size(texture->width) <= ATLAS_SIZE &&
+           cell_size(texture->height) <= ATLAS_SIZE;
+}
 
-    if (wav_header.channels > 2) {
-        printf("Failed to load \"%s\", only supports 1 or 2 channels (%d)\n",
-               header->file_path, wav_header.format);
-        fclose(wav_file);
-        return;
-    }
+// The top of everything placed in a page, as flat segments
+// from left to right that cover the whole width.
+struct Skyline {
+    struct Segment {
+        u32 x, y, width;
+    };
+    std::vector<Segment> segments;
+};
+
+// How high a rectangle with its left edge on the
+// segment ends up, it rests on the highest segment
+// under it.
+bool skyline_fits(const Skyline *skyline, u32 index, u32 width, u32 height,
+                  u32 *y) {
+    const std::vector<Skyline::Segment> &segments = skyline->segments;
+    u32 x = segments[index].x;
+    if (x + width > ATLAS_SIZE) return false;
+    u32 top = 0;
+    for (u32 i = index; i < segments.size() && segments[i].x < x + width; i++)
+        top = MAX(top, segments[i].y);
+    if (top + height > ATLAS_SIZE) return false;
+    *y = top;
+    return true;
+}
 
-    u64 size = 0;
-    u8 *data = nullptr;
-    while (end != ftell(wav_file)) {
-        WAVChunk chunk;
-        fread(&chunk, sizeof(WAVChunk), 1, wav_file);
-        if (chunk.type[0] == 'd' && chunk.type[1] == 'a' &&
-            chunk.type[2] == 't' && chunk.type[3] == 'a') {
-            if (!data)
-                data = (u8 *) malloc(size + chunk.size);
-            else
-                data = (u8 *) realloc(data, size + chunk.size);
-            fread((void *) (data + size), 1, chunk.size, wav_file);
-            size += chunk.size;
+// Places the rectangle where its bottom is the lowest, and
+// then furthest to the left.
+bool skyline_place(Skyline *skyline, u32 width, u32 height, u32 *x, u32 *y) {
+    std::vector<Skyline::Segment> &segments = skyline->segments;
+    u32 best = segments.size();
+    u32 best_y = ATLAS_SIZE;
+    for (u32 i = 0; i < segments.size(); i++) {
+        u32 top;
+        if (skyline_fits(skyline, i, width, height, &top) && top < best_y) {
+            best = i;
+            best_y = top;
+        }
+    }
+    if (best == segments.size()) return false;
+    *x = segments[best].x;
+    *y = best_y;
+
+    // The new segment covers the ones under it.
+    u32 right = *x + width;
+    segments.insert(segments.begin() + best, {*x, best_y + height, width});
+    for (u32 i = best + 1; i < segments.size() && segments[i].x < right;) {
+        Skyline::Segment *segment = &segments[i];
+        u32 end = segment->x + segment->width;
+        if (end > right) {
+            segment->width = end - right;
+            segment->x = right;
+            break;
+        }
+        segments.erase(segments.begin() + i);
+    }
+    for (u32 i = 0; i + 1 < segments.size();) {
+        if (segments[i].y == segments[i + 1].y) {
+            segments[i].width += segments[i + 1].width;
+            segments.erase(segments.begin() + i + 1);
         } else {
-            fseek(wav_file, chunk.size, SEEK_CUR);
+            i++;
         }
     }
-    // TODO: Fill out struct Sound and seralize it.
-    Sound sound;
-    sound.data = data;
-    sound.size = size;
-    sound.num_samples = size / (wav_header.channels * wav_header.bitdepth / 8);
-    sound.sample_rate = wav_header.sample_rate;
-    sound.bits_per_sample = wav_header.bitdepth;
-    sound.is_stereo = 1 < wav_header.channels;
-
-    Asset::Data asset = {.sound = sound};
-    header->asset_size = sizeof(Asset::Data) + size;
-    add_asset_to_file(file, header, &asset);
+    return true;
 }
 
-void process_asset(AssetFile *file, const std::string *path) {
-    size_t pos = path->find_last_of(".");
-    if (pos == std::string::npos) return;
-    std::string file_ending = path->substr(pos);
-    if (!valid_endings.count(file_ending)) return;
-    Asset::Type type = valid_endings[file_ending];
-
-    Asset::Header header = get_asset_header(path, type);
-    switch (header.type) {
-        case (Asset::Type::TEXTURE):
-            load_texture(file, &header);
-            break;
-        case (Asset::Type::FONT):
-            load_font(file, &header);
-            break;
-        case (Asset::Type::SOUND):
-            load_sound(file, &header);
-            break;
-        case (Asset::Type::ATLAS):
-            // load_atlas(file, header);
-            // break;
-        default:
-            printf("!!!! Unhandled asset, unkown type: %s, %d\n", path->c_str(),
-                   (int) header.type);
-            return;
+// Packs the sprites into pages, which are added after the
+// other assets as ATLASes. A sprite only keeps where it is
+// in the page, its pixels are moved there.
+void pack_atlases(AssetFile *file) {
+    auto texture_of = [file](u32 asset) {
+        return first<Asset::Texture>(&file->blobs[asset]);
+    };
+    // Tallest first packs the tightest, and the order only
+    // depends on the sprites so the file is the same every time.
+    std::vector<u32> &sprites = file->sprites;
+    std::sort(sprites.begin(), sprites.end(), [&](u32 a, u32 b) {
+        const Asset::Texture *one = texture_of(a), *other = texture_of(b);
+        if (one->height != other->height)
+            return one->height > other->height;
+        if (one->width != other->width)
+            return one->width > other->width;
+        return a < b;
+    });
+
+    std::vector<Skyline> pages;
+    std::vector<u32> page_of(sprites.size());
+    std::vector<u32> cell_x(sprites.size()), cell_y(sprites.size());
+    for (u32 i = 0; i < sprites.size(); i++) {
+        Asset::Texture *sprite = texture_of(sprites[i]);
+        u32 width = cell_size(sprite->width);
+        u32 height = cell_size(sprite->height);
+        u32 page, x, y;
+        for (page = 0; page < pages.size(); page++)
+            if (skyline_place(&pages[page], width, height, &x, &y)) break;
+        if (page == pages.size()) {
+            pages.push_back({{{0, 0, ATLAS_SIZE}}});
+            bool placed = skyline_place(&pages[page], width, height, &x, &y);
+            assert(placed);
+        }
+        sprite->x = x + atlas_gutter();
+        sprite->y = y + atlas_gutter();
+        cell_x[i] = x;
+        cell_y[i] = y;
+        page_of[i] = page;
     }
+
+    AssetID first_page = file->asset_headers.size();
+    std::vector<Blob> blobs(pages.size());
+    for (u32 page = 0; page < pages.size(); page++) {
+        Asset::Texture texture = {ATLAS_SIZE, ATLAS_SIZE, 4,
+                                  file->num_textures++, 0, 0,
+                                  Asset::ASSET_ID_NO_ASSET, 1,
+                                  ImageFormat::PIXELS, 0,
+                                  ATLAS_SIZE * ATLAS_SIZE * 4};
+        append(&blobs[page], &texture);
+        texture.pixels_offset = align(blobs[page].bytes.size());
+        blobs[page].bytes.resize(texture.pixels_offset + texture.size);
+        *first<Asset::Texture>(&blobs[page]) = texture;
+    }
+    for (u32 i = 0; i < sprites.size(); i++) {
+        Blob *blob = &file->blobs[sprites[i]];
+        Asset::Texture *sprite = first<Asset::Texture>(blob);
+        Blob *page = &blobs[page_of[i]];
+        const Asset::Texture *page_texture = first<Asset::Texture>(page);
+        copy_to_page(page->bytes.data() + page_texture->pixels_offset, sprite,
+                     blob->bytes.data() + sprite->pixels_offset, cell_x[i],
+                     cell_y[i]);
+        sprite->id = page_texture->id;
+        sprite->components = page_texture->components;
+        sprite->atlas = first_page + page_of[i];
+        sprite->pixels_offset = 0;
+        sprite->size = 0;
+        blob->bytes.resize(sizeof(Asset::Texture));
+        Asset::Header *header = &file->asset_headers[sprites[i]];
+        header->asset_size = header->stored_size = blob->bytes.size();
+    }
+    for (u32 page = 0; page < pages.size(); page++) {
+        char path[32];
+        snprintf(path, sizeof(path), "res/atlas_%u.atl", page);
+        add_asset_to_file(file, path, Asset::Type::ATLAS, &blobs[page]);
+    }
+    printf("\tPacked %lu sprites into %lu layers, %u layers in total\n",
+           sprites.size(), pages.size(), file->num_textures);
 }
 
-template <typename T>
-size_t write_to_file(FILE *stream, const T *ptr, size_t num = 1) {
-    auto write = fwrite(ptr, sizeof(T), num, stream);
-    ASSERT(write == num, "Failed to read from asset file");
-    return write * sizeof(T);
+void bake_all_levels(AssetFile *file) {
+    Jobs::parallel_for(file->blobs.size(), 1, [file](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; i++) {
+            Asset::Header *header = &file->asset_headers[i];
+            if (header->type != Asset::Type::TEXTURE &&
+                header->type != Asset::Type::ATLAS)
+                continue;
+            bake_levels(&file->blobs[i]);
+            header->asset_size = header->stored_size = file->blobs[i].bytes.size();
+        }
+    });
+    if (texture_options.levels > 1 || texture_options.block_compress)
+        printf("\tTextures have %u levels%s\n", texture_options.levels,
+               texture_options.block_compress ? ", stored as BC3" : "");
 }
 
-void dump_asset_file(AssetFile *file, const char *out_path) {
-    FILE *output_file = fopen(out_path, "wb");
+// The ids are handed out here, in the order the files
+// were given, so the file doesn't depend on which thread
+// finished first.
+void add_baked_assets(AssetFile *file, Baked *baked) {
+    // The glyphs of a font are placed in the whole layer.
+    bool has_font = false;
+    for (BakedAsset &asset : *baked)
+        has_font |= asset.type == Asset::Type::FONT;
+    u16 last_texture = 0;
+    u32 last_texture_id = Asset::ASSET_ID_NO_ASSET;
+    for (BakedAsset &asset : *baked) {
+        if (asset.type == Asset::Type::TEXTURE) {
+            Asset::Texture *texture = first<Asset::Texture>(&asset.blob);
+            if (!has_font && fits_in_atlas(texture)) {
+                file->sprites.push_back(file->asset_headers.size());
+            } else {
+                last_texture = file->num_textures++;
+                last_texture_id = file->asset_headers.size();
+                texture->id = last_texture;
+            }
+        } else if (asset.type == Asset::Type::FONT) {
+            Asset::Font *font = first<Asset::Font>(&asset.blob);
+            font->texture = last_texture_id;
+            font->layer = last_texture;
+        }
+        add_asset_to_file(file, asset.path, asset.type, &asset.blob);
+    }
+}
 
-    write_to_file(output_file, &file->header);
-    u64 header_location = ftell(output_file);
-    write_to_file(output_file, &file->asset_headers[0],
-                  file->header.number_of_assets);
+// Compressing has to save at least this much of the asset,
+// otherwise it's stored as it is and mapped straight from
+// the file, which is free.
+const u64 WORTH_COMPRESSING = 8;
+
+// The blobs are swapped for the compressed bytes, after
+// the ids are set since they're part of the data.
+void compress_assets(AssetFile *file) {
+    Jobs::parallel_for(file->blobs.size(), 1, [file](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; i++) {
+            Asset::Header *header = &file->asset_headers[i];
+            std::vector<u8> &bytes = file->blobs[i].bytes;
+            std::vector<u8> compressed(Compression::max_compressed_size(bytes.size()));
+            u64 size = Compression::compress(bytes.data(), bytes.size(),
+                                             compressed.data());
+            if (size > bytes.size() - bytes.size() / WORTH_COMPRESSING) continue;
+            compressed.resize(size);
+            bytes.swap(compressed);
+            header->stored_size = size;
+            header->encoding = Asset::Encoding::LZ4;
+        }
+    });
+}
 
+void pad_to(FILE *stream, u64 offset) {
+    while ((u64) ftell(stream) < offset)
+        fputc(0, stream);
+}
+
+// Generate a source file containing IDs to the source code.
+void write_asset_ids(AssetFile *file) {
     FILE *source_file = fopen("src/fog_assets.cpp", "w");
-    u64 string_begin = ftell(output_file);
-    u64 string_cur = string_begin;
     for (u64 i = 0; i < file->asset_headers.size(); i++) {
-        auto *header = &file->asset_headers[i];
-        std::string file_path(header->file_path);
+        const std::string &path = file->paths[i];
+        std::string file_path = path;
         while (true) {
             size_t begin = file_path.find_first_of('/');
             if (begin == std::string::npos) break;
@@ -312,104 +430,166 @@ void dump_asset_file(AssetFile *file, const char *out_path) {
         size_t end = file_path.find_last_of('.');
         for (auto &c : file_path) c = toupper(c);
         file_path = file_path.substr(4, end - 4);  // Len of "res/"
-        if (header->type == Asset::Type::FONT) {
+        if (file->asset_headers[i].type == Asset::Type::FONT) {
             file_path += "_FONT";
         }
-        printf("\tFound asset: %s -> %s\n", header->file_path,
-               file_path.c_str());
+        printf("\tFound asset: %s -> %s\n", path.c_str(), file_path.c_str());
         fprintf(source_file, "constexpr AssetID ASSET_%s = %lu;\n",
                 file_path.c_str(), i);
-
-        write_to_file(output_file, header->file_path, header->file_path_length);
-        header->file_path = (char *) (string_cur - string_begin);
-        string_cur = ftell(output_file);
     }
     fclose(source_file);
-    assert(string_cur - string_begin == file->header.size_of_strings);
-
-    // Serialization of assets
-    u64 data_begin = ftell(output_file);
-    for (u64 i = 0; i < file->assets.size(); i++) {
-        Asset::Data asset = file->assets[i];
-        Asset::Header *header = &file->asset_headers[i];
-        header->offset = ftell(output_file);
-        switch (file->asset_headers[i].type) {
-            case (Asset::Type::TEXTURE): {
-                write_to_file(output_file, &asset);
-                u64 size = asset.image.width * asset.image.height *
-                           asset.image.components;
-                write_to_file(output_file, asset.image.data, size);
-            } break;
-            case (Asset::Type::SHADER): {
-                write_to_file(output_file, asset.shader_source, header->asset_size);
-            } break;
-            case (Asset::Type::FONT): {
-                write_to_file(output_file, &asset);
-                u64 num_glyphs = asset.font.num_glyphs;
-                write_to_file(output_file, asset.font.glyphs, num_glyphs);
-                u64 num_kernings = asset.font.num_kernings;
-                write_to_file(output_file, asset.font.kernings, num_kernings);
-            } break;
-            case (Asset::Type::SOUND): {
-                write_to_file(output_file, &asset);
-                write_to_file(output_file, asset.sound.data, asset.sound.size);
-            } break;
-            default:
-                printf("UNIMPLEMENTED ASSET TYPE\n");
-                continue;
-                break;
-        };
-        header->asset_size = ftell(output_file) - header->offset;
-    }
-    u64 data_end = ftell(output_file);
-    assert(data_end - data_begin == file->header.size_of_data);
-
-    fseek(output_file, header_location, SEEK_SET);
-    write_to_file(output_file, &file->asset_headers[0],
-                  file->header.number_of_assets);
-
-    fclose(output_file);
-    printf("\tLoaded %lu assets\n", file->assets.size());
 }
 
-int main(int nargs, char **vargs) {
-    // Image file formats
-    valid_endings[".psd"] = Asset::Type::TEXTURE;
-    valid_endings[".png"] = Asset::Type::TEXTURE;
-    valid_endings[".jpg"] = Asset::Type::TEXTURE;
-    valid_endings[".bmp"] = Asset::Type::TEXTURE;
-    // .sdf is for the font files, they are loaded
-    // in the font pass only if there is a matching
-    // .fnt file.
+// The table the game looks up names in, the paths are hashed
+// and placed the same way "Asset::fetch_by_hash" looks.
+std::vector<Asset::Name> build_names(AssetFile *file) {
+    u64 num_assets = file->asset_headers.size();
+    std::vector<Asset::Name> names(Asset::name_table_size(num_assets));
+    for (Asset::Name &name : names)
+        name = {0, Asset::ASSET_ID_NO_ASSET, 0};
+    u64 mask = names.size() - 1;
+    u64 longest = 0;
+    for (u64 i = 0; i < num_assets; i++) {
+        u64 hash = Asset::hash_name(file->paths[i].c_str());
+        u64 slot = hash & mask;
+        u64 probes = 1;
+        for (; names[slot].asset_id != Asset::ASSET_ID_NO_ASSET;
+             slot = (slot + 1) & mask, probes++) {
+            if (names[slot].hash != hash) continue;
+            ERR("\"%s\" and \"%s\" have the same hash, rename one of them",
+                file->paths[i].c_str(),
+                file->paths[names[slot].asset_id].c_str());
+            HALT_AND_CATCH_FIRE;
+        }
+        names[slot] = {hash, (u32) i, 0};
+        longest = MAX(longest, probes);
+    }
+    printf("\tNamed %lu assets, found in at most %lu probes\n", num_assets,
+           longest);
+    return names;
+}
 
-    // Fonts
-    valid_endings[".fnt"] = Asset::Type::FONT;
+// Everything is placed before anything is written, so
+// the file is written from start to end in one go.
+void dump_asset_file(AssetFile *file, const char *out_path) {
+    u64 num_assets = file->asset_headers.size();
+    Asset::FileHeader header = {};
+    header.magic = Asset::FILE_MAGIC;
+    header.version = Asset::FILE_VERSION;
+    header.number_of_assets = num_assets;
+    header.headers_offset = sizeof(Asset::FileHeader);
+    header.strings_offset = header.headers_offset + num_assets * sizeof(Asset::Header);
+    for (u64 i = 0; i < num_assets; i++) {
+        Asset::Header *asset = &file->asset_headers[i];
+        asset->path_offset = header.size_of_strings;
+        header.size_of_strings += asset->path_length;
+    }
+    std::vector<Asset::Name> names = build_names(file);
+    header.names_offset = align(header.strings_offset + header.size_of_strings);
+    header.number_of_names = names.size();
+    header.data_offset = align(header.names_offset +
+                               names.size() * sizeof(Asset::Name));
+    u64 data_end = header.data_offset;
+    for (u64 i = 0; i < num_assets; i++) {
+        Asset::Header *asset = &file->asset_headers[i];
+        asset->offset = align(data_end);
+        data_end = asset->offset + asset->stored_size;
+    }
+    header.size_of_data = data_end - header.data_offset;
 
-    // Atlas
-    valid_endings[".atl"] = Asset::Type::ATLAS;
+    write_asset_ids(file);
 
-    // Sound
-    valid_endings[".wav"] = Asset::Type::SOUND;
-    // TODO(ed): This might be nice to have
-    // valid_endings[".ogg"] = Asset::Type::SOUND;
+    FILE *output_file = fopen(out_path, "wb");
+    write_to_file(output_file, &header);
+    if (num_assets)
+        write_to_file(output_file, &file->asset_headers[0], num_assets);
+    for (u64 i = 0; i < num_assets; i++)
+        write_to_file(output_file, file->paths[i].c_str(),
+                      file->asset_headers[i].path_length);
+    pad_to(output_file, header.names_offset);
+    write_to_file(output_file, names.data(), names.size());
+    for (u64 i = 0; i < num_assets; i++) {
+        pad_to(output_file, file->asset_headers[i].offset);
+        const std::vector<u8> &bytes = file->blobs[i].bytes;
+        write_to_file(output_file, bytes.data(), bytes.size());
+    }
+    assert((u64) ftell(output_file) == data_end);
 
-    // Config files? Is this a good idea?
-    valid_endings[".cfg"] = Asset::Type::CONFIG;
+    fclose(output_file);
+    printf("\tLoaded %lu assets\n", num_assets);
+}
 
+int main(int nargs, char **vargs) {
     printf("\n\t=== ASSET FINDING ===\n");
 
-    // TODO(ed): Some form of compression on this data
-    // would make it a lot less space savy
     AssetFile file = {};
     const char *out_path = "bin/data.fog";
-    for (int i = 0; i < nargs; i++) {
-        if (std::strcmp(vargs[i], "-o") == 0) {
+    const char *cache_dir = nullptr;
+    s32 num_workers = -1;
+    bool should_compress = true;
+    std::vector<std::string> paths;
+    for (int i = 1; i < nargs; i++) {
+        if (std::strcmp(vargs[i], "-o") == 0 && i + 1 < nargs) {
             out_path = vargs[++i];
+        } else if (std::strcmp(vargs[i], "-j") == 0 && i + 1 < nargs) {
+            // The number of threads, 1 bakes everything in order.
+            num_workers = atoi(vargs[++i]) - 1;
+        } else if (std::strcmp(vargs[i], "-c") == 0 && i + 1 < nargs) {
+            // Where the baked files are kept between builds.
+            cache_dir = vargs[++i];
+            mkdir(cache_dir, 0755);
+        } else if (std::strcmp(vargs[i], "-m") == 0 && i + 1 < nargs) {
+            // How many levels textures have, 1 is only the texture.
+            s32 levels = atoi(vargs[++i]);
+            texture_options.levels = CLAMP(1, (s32) Asset::MAX_TEXTURE_LEVELS,
+                                           levels);
+        } else if (std::strcmp(vargs[i], "-b") == 0) {
+            // Textures are stored as BC3.
+            texture_options.block_compress = true;
+        } else if (std::strcmp(vargs[i], "-u") == 0) {
+            // Nothing is compressed, so all of it is mapped.
+            should_compress = false;
         } else {
-            std::string path = vargs[i];
-            process_asset(&file, &path);
+            paths.push_back(vargs[i]);
+        }
+    }
+
+    Jobs::init(num_workers);
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    std::vector<Baked> baked(paths.size());
+    std::atomic<u32> cached(0);
+    Jobs::parallel_for(paths.size(), 1, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; i++)
+            if (bake_or_fetch(&baked[i], paths[i], cache_dir))
+                cached++;
+    });
+    for (Baked &assets : baked)
+        add_baked_assets(&file, &assets);
+    pack_atlases(&file);
+    bake_all_levels(&file);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("\tBaked %lu files (%u from the cache) in %.1f ms on %u threads\n",
+           paths.size(), cached.load(),
+           (end.tv_sec - start.tv_sec) * 1000.0 +
+           (end.tv_nsec - start.tv_nsec) / 1000000.0,
+           Jobs::num_threads());
+
+    if (should_compress) {
+        u64 before = 0, after = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        compress_assets(&file);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        for (Asset::Header &header : file.asset_headers) {
+            before += header.asset_size;
+            after += header.stored_size;
         }
+        printf("\tCompressed %.1f MB to %.1f MB in %.1f ms\n",
+               before / (f64) (1 << 20), after / (f64) (1 << 20),
+               (end.tv_sec - start.tv_sec) * 1000.0 +
+               (end.tv_nsec - start.tv_nsec) / 1000000.0);
     }
+    Jobs::destroy();
 
     printf("\t=== ASSET WRITING ===\n");
 
@@ -20,11 +20,15 @@ bool debug_view_is_on();
 #include "util/memory.h"
 #include "util/performance.h"
 #include "util/block_list.h"
+#include "util/jobs.h"
+#include "util/compression.h"
+#include "util/block_compression.h"
 #include "platform/input.h"
 #include "renderer/command.h"
 #include "renderer/camera.h"
 #include "renderer/particle_system.h"
 #include "logic/logic.h"
+#include "logic/entity.h"
 #include "logic/block_physics.h"
 #define OPENGL_RENDERER
 #define OPENGL_TEXTURE_WIDTH 512
@@ -37,13 +41,22 @@ bool debug_view_is_on();
 
 #include "util/io.cpp"
 #include "util/memory.cpp"
+#include "util/jobs.cpp"
+#include "util/compression.cpp"
+#include "util/block_compression.cpp"
 #include "platform/input.cpp"
 #include "renderer/command.cpp"
 #include "renderer/text.cpp"
 #include "renderer/particle_system.cpp"
 #include "asset/asset.cpp"
+#ifdef DEBUG
+#include "asset/bake.h"
+#include "asset/bake.cpp"
+#include "asset/hot_reload.cpp"
+#endif
 #include "util/performance.cpp"
 #include "logic/logic.cpp"
+#include "logic/entity.cpp"
 #include "logic/block_physics.cpp"
 
 #include "platform/mixer.h"
@@ -91,8 +104,11 @@ void setup_debug_keybindings() {
         if (pressed(Player::P1, Name::DEBUG_VIEW))
             debug_view = !debug_view;
     };
-    Logic::add_callback(Logic::At::PRE_UPDATE, debug_callback, Logic::now(),
-                        Logic::FOREVER);
+    Logic::LogicID id = Logic::add_callback(Logic::At::PRE_UPDATE,
+                                            debug_callback, Logic::now(),
+                                            Logic::FOREVER);
+    // Nothing else touches the flags while the callbacks run.
+    Logic::set_access(id, 0, Logic::add_resource());
 }
 
 bool debug_view_is_on() {
@@ -113,12 +129,14 @@ int main(int argc, char **argv) {
     init_random();
 
     Util::do_all_allocations();
+    ASSERT(Jobs::init(), "Failed to start the job system");
     ASSERT(Renderer::init("Hello there", 500, 500),
            "Failed to initalize renderer");
     ASSERT(Mixer::init(),
             "Failed to initalize audio mixer");
     Asset::load("data.fog");
     ASSERT(Logic::init(), "Failed to initalize logic system");
+    ASSERT(Logic::init_entities(), "Failed to initalize entities");
 
     ASSERT(Physics::init(), "Failed to intalize physics");
 
@@ -157,11 +175,14 @@ int main(int argc, char **argv) {
         Game::draw();
         Logic::call(Logic::At::POST_DRAW);
 
+        Asset::update();
         Renderer::blit();
         STOP_PERF(RENDER);
         STOP_PERF(MAIN);
     }
     
+    Asset::unload();
+    Jobs::destroy();
     __close_app_responsibly();
     return 0;
 }
@@ -1,5 +1,11 @@
 #include "block_physics.h"
 
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace Physics {
 
 using Util::create_list;
@@ -31,6 +37,18 @@ ShapeID add_shape(u32 points_length, Vec2 *points) {
     for (u32 i = 0; i < points_length; i++)
         shape.points[i] = points[i] - center;
     shape.points.length = points_length;  // Change the length to match.
+
+    // Cheap bounds, to rule out shapes before doing
+    // the full check.
+    shape.aabb = {shape.points[0], shape.points[0]};
+    for (u32 i = 0; i < points_length; i++) {
+        Vec2 point = shape.points[i];
+        shape.aabb.min.x = MIN(shape.aabb.min.x, point.x);
+        shape.aabb.min.y = MIN(shape.aabb.min.y, point.y);
+        shape.aabb.max.x = MAX(shape.aabb.max.x, point.x);
+        shape.aabb.max.y = MAX(shape.aabb.max.y, point.y);
+        shape.radius = MAX(shape.radius, length(point));
+    }
     // Allocate worstcase memory.
     // This is a tad wastefull but it shouldn't be much
     // since most shapes should be fairly simple in their
@@ -58,36 +76,92 @@ ShapeID add_shape(u32 points_length, Vec2 *points) {
         continue;
     }
 
+    shape.id = global_shape_list.length;
     global_shape_list.append(shape);
-    return global_shape_list.length - 1;
+    return shape.id;
 }
 
 ShapeID add_shape(List<Vec2> points) {
     return add_shape(points.length, points.data);
 }
 
-Shape find_shape(ShapeID id)
+Shape *find_shape(ShapeID id)
 {
 	ASSERT(id < (u32) global_shape_list.length, "Invalid id");
-	Shape shape = global_shape_list[id];
-    ASSERT(id == shape.id, "Failed even though it shouldn't");
+	Shape *shape = global_shape_list + id;
+    ASSERT(id == shape->id, "Failed even though it shouldn't");
     return shape;
 }
 
 void center_body(Body *body)
 {
-	body->offset = find_shape(body->shape).center;
+	body->offset = find_shape(body->shape)->center;
 	body->offset = hadamard(body->offset, body->scale);
 }
 
-Limit project_shape(Shape shape, Vec2 axis, 
+void attach_cache(Body *body, BodyCache *cache) {
+    body->cache = cache;
+    cache->dirty = true;
+    refresh_cache(body);
+}
+
+static bool cache_is_current(Body *body) {
+    BodyCache *cache = body->cache;
+    return !cache->dirty
+        && cache->shape == body->shape
+        && cache->rotation == body->rotation
+        && cache->scale.x == body->scale.x && cache->scale.y == body->scale.y
+        && cache->offset.x == body->offset.x && cache->offset.y == body->offset.y;
+}
+
+static void build_cache(Body *body, BodyCache *cache) {
+    Shape *shape = find_shape(body->shape);
+    cache->shape = body->shape;
+    cache->rotation = body->rotation;
+    cache->scale = body->scale;
+    cache->offset = body->offset;
+    cache->dirty = false;
+    if (shape->points.length > MAX_CACHED_POINTS) {
+        // Too large, the slow path is used instead.
+        cache->num_points = 0;
+        return;
+    }
+
+    cache->num_points = shape->points.length;
+    for (u32 i = 0; i < shape->points.length; i++) {
+        Vec2 point = rotate(hadamard(shape->points[i], body->scale) +
+                            body->offset, body->rotation);
+        cache->points[i] = point;
+        if (i == 0) {
+            cache->aabb = {point, point};
+            continue;
+        }
+        cache->aabb.min.x = MIN(cache->aabb.min.x, point.x);
+        cache->aabb.min.y = MIN(cache->aabb.min.y, point.y);
+        cache->aabb.max.x = MAX(cache->aabb.max.x, point.x);
+        cache->aabb.max.y = MAX(cache->aabb.max.y, point.y);
+    }
+    cache->num_axes = shape->normals.length;
+    Vec2 scale = inverse(body->scale);
+    for (u32 i = 0; i < shape->normals.length; i++)
+        cache->axes[i] = rotate(normalize(hadamard(shape->normals[i], scale)),
+                                body->rotation);
+}
+
+void refresh_cache(Body *body) {
+    BodyCache *cache = body->cache;
+    if (!cache || cache_is_current(body)) return;
+    build_cache(body, cache);
+}
+
+Limit project_shape(Shape *shape, Vec2 axis, 
 		Vec2 scale=V2(1, 1), Vec2 offset=V2(0, 0))
 {
 	Limit limit = {};
 	f32 delta = dot(offset, axis);
-	for (u32 i = 0; i < shape.points.length; i++)
+	for (u32 i = 0; i < shape->points.length; i++)
 	{
-		f32 projection = dot(hadamard(shape.points.data[i], scale), axis);
+		f32 projection = dot(hadamard(shape->points.data[i], scale), axis);
 		limit.upper = MAX(limit.upper, projection + delta);
 		limit.lower = MIN(limit.lower, projection + delta);
 	}
@@ -103,6 +177,7 @@ Body create_body(ShapeID shape_id, f32 mass, u32 layer, f32 bounce,
 	body.damping = damping;
 	body.shape = shape_id;
 	body.bounce = bounce;
+	body.friction = 0.2f;
 	body.layer = layer;
 	if (mass == 0.0)
 		body.inverse_mass = 0.0f;
@@ -113,7 +188,7 @@ Body create_body(ShapeID shape_id, f32 mass, u32 layer, f32 bounce,
 }
 
 void debug_draw_body(Body *body) {
-	Shape shape = find_shape(body->shape);
+	Shape shape = *find_shape(body->shape);
 	for (u32 i = 0; i < shape.points.length; i++)
 	{
 		u32 v_i = i;
@@ -155,6 +230,79 @@ void integrate(Body *body, f32 delta) {
 
     body->acceleration = V2(0, 0);
     body->force = V2(0, 0);
+
+    refresh_cache(body);
+}
+
+// The bounds of an unrotated body in world space.
+static AABB unrotated_aabb(Body *body, Shape *shape) {
+    Vec2 a = hadamard(shape->aabb.min, body->scale);
+    Vec2 b = hadamard(shape->aabb.max, body->scale);
+    // The scale can be negative, which flips the box.
+    Vec2 origin = body->position + body->offset;
+    return {V2(MIN(a.x, b.x), MIN(a.y, b.y)) + origin,
+            V2(MAX(a.x, b.x), MAX(a.y, b.y)) + origin};
+}
+
+static bool bounds_overlap(Body *body_a, Shape *shape_a,
+                           Body *body_b, Shape *shape_b) {
+    if (body_a->rotation == 0 && body_b->rotation == 0)
+        return overlaps(unrotated_aabb(body_a, shape_a),
+                        unrotated_aabb(body_b, shape_b));
+
+    Vec2 center_a = body_a->position + rotate(body_a->offset, body_a->rotation);
+    Vec2 center_b = body_b->position + rotate(body_b->offset, body_b->rotation);
+    f32 radius_a = shape_a->radius * MAX(ABS(body_a->scale.x), ABS(body_a->scale.y));
+    f32 radius_b = shape_b->radius * MAX(ABS(body_b->scale.x), ABS(body_b->scale.y));
+    f32 reach = radius_a + radius_b;
+    return length_squared(center_b - center_a) <= reach * reach;
+}
+
+static Limit project_cache(BodyCache *cache, Vec2 axis) {
+    Limit limit = {};
+    for (u32 i = 0; i < cache->num_points; i++) {
+        f32 projection = dot(cache->points[i], axis);
+        limit.upper = MAX(limit.upper, projection);
+        limit.lower = MIN(limit.lower, projection);
+    }
+    return limit;
+}
+
+// The same test as below, but on the cached world space
+// points and axes, so there is nothing to transform.
+static Overlap check_cached_overlap(Body *body_a, Body *body_b) {
+    Overlap overlap = {body_a, body_b, -1.0f};
+    BodyCache *caches[] = {body_a->cache, body_b->cache};
+    Vec2 relative_position = body_b->position - body_a->position;
+    for (u32 n = 0; n < 2; n++) {
+        BodyCache *cache = caches[n];
+        for (u32 i = 0; i < cache->num_axes; i++) {
+            Vec2 normal = cache->axes[i];
+            Limit limit_a = project_cache(body_a->cache, normal);
+            Limit limit_b = project_cache(body_b->cache, normal);
+            f32 projected_distance = dot(relative_position, normal);
+
+            f32 depth;
+            if (projected_distance > 0)
+                depth = limit_a.upper - limit_b.lower - projected_distance;
+            else
+                depth = limit_b.upper - limit_a.lower + projected_distance;
+
+            if (depth < 0)
+                return overlap;
+
+            if (depth < overlap.depth || overlap.depth == -1.0f) {
+                overlap.depth = depth;
+                overlap.normal = normal;
+            }
+        }
+    }
+
+    if (dot(overlap.normal, relative_position) < 0)
+        overlap.normal = -overlap.normal;
+
+    overlap.is_valid = true;
+    return overlap;
 }
 
 Overlap check_overlap(Body *body_a, Body *body_b) {
@@ -166,15 +314,23 @@ Overlap check_overlap(Body *body_a, Body *body_b) {
     Overlap overlap = {body_a, body_b, -1.0f};
     if ((body_a->layer & body_b->layer) == 0) return overlap;
 
-	Shape shape_a = find_shape(body_a->shape);
-	Shape shape_b = find_shape(body_b->shape);
+	Shape *shape_a = find_shape(body_a->shape);
+	Shape *shape_b = find_shape(body_b->shape);
+    if (!bounds_overlap(body_a, shape_a, body_b, shape_b)) return overlap;
+
+    if (body_a->cache && body_b->cache && !debug_view_is_on()) {
+        refresh_cache(body_a);
+        refresh_cache(body_b);
+        if (body_a->cache->num_points && body_b->cache->num_points)
+            return check_cached_overlap(body_a, body_b);
+    }
 
     Vec2 center = (body_a->position + body_b->position) * 0.5;
 
 	Vec2 relative_position = (body_b->position) - (body_a->position);
 
 	Vec2 scale = inverse(body_a->scale);
-	List<Vec2> normals = shape_a.normals;
+	List<Vec2> normals = shape_a->normals;
 	for (u32 n = 0; n < 2; n++) {
 		for (u32 i = 0; i < normals.length; i++) {
 			Vec2 normal, axis_a, axis_b;
@@ -244,7 +400,7 @@ Overlap check_overlap(Body *body_a, Body *body_b) {
 			}
 		}
 
-		normals = shape_b.normals;
+		normals = shape_b->normals;
 		scale = inverse(body_b->scale);
 	}
 
@@ -261,6 +417,122 @@ Overlap check_overlap(Body *body_a, Body *body_b) {
 	return overlap;
 }
 
+#ifdef __SSE2__
+// Does the same thing as "check_cached_overlap", but projects
+// every point on four axes at once. The axes are padded with
+// copies of the last one, checking an axis twice changes nothing.
+static Overlap check_cached_overlap_sse(Body *body_a, Body *body_b) {
+    const u32 MAX_AXES = 2 * MAX_CACHED_POINTS;
+    Overlap overlap = {body_a, body_b, -1.0f};
+    BodyCache *cache_a = body_a->cache;
+    BodyCache *cache_b = body_b->cache;
+
+    alignas(16) f32 axis_x[MAX_AXES];
+    alignas(16) f32 axis_y[MAX_AXES];
+    alignas(16) f32 depths[MAX_AXES];
+    u32 num_axes = 0;
+    for (u32 i = 0; i < cache_a->num_axes; i++, num_axes++) {
+        axis_x[num_axes] = cache_a->axes[i].x;
+        axis_y[num_axes] = cache_a->axes[i].y;
+    }
+    for (u32 i = 0; i < cache_b->num_axes; i++, num_axes++) {
+        axis_x[num_axes] = cache_b->axes[i].x;
+        axis_y[num_axes] = cache_b->axes[i].y;
+    }
+    u32 padded = (num_axes + 3) & ~3u;
+    for (u32 i = num_axes; i < padded; i++) {
+        axis_x[i] = axis_x[num_axes - 1];
+        axis_y[i] = axis_y[num_axes - 1];
+    }
+
+    Vec2 relative_position = body_b->position - body_a->position;
+    __m128 relative_x = _mm_set1_ps(relative_position.x);
+    __m128 relative_y = _mm_set1_ps(relative_position.y);
+    __m128 zero = _mm_setzero_ps();
+    for (u32 i = 0; i < padded; i += 4) {
+        __m128 x = _mm_load_ps(axis_x + i);
+        __m128 y = _mm_load_ps(axis_y + i);
+
+        __m128 lower_a = zero, upper_a = zero;
+        for (u32 p = 0; p < cache_a->num_points; p++) {
+            Vec2 point = cache_a->points[p];
+            __m128 projection = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(point.x), x),
+                                           _mm_mul_ps(_mm_set1_ps(point.y), y));
+            lower_a = _mm_min_ps(lower_a, projection);
+            upper_a = _mm_max_ps(upper_a, projection);
+        }
+
+        __m128 lower_b = zero, upper_b = zero;
+        for (u32 p = 0; p < cache_b->num_points; p++) {
+            Vec2 point = cache_b->points[p];
+            __m128 projection = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(point.x), x),
+                                           _mm_mul_ps(_mm_set1_ps(point.y), y));
+            lower_b = _mm_min_ps(lower_b, projection);
+            upper_b = _mm_max_ps(upper_b, projection);
+        }
+
+        __m128 distance = _mm_add_ps(_mm_mul_ps(relative_x, x),
+                                     _mm_mul_ps(relative_y, y));
+        __m128 forward = _mm_sub_ps(_mm_sub_ps(upper_a, lower_b), distance);
+        __m128 backward = _mm_add_ps(_mm_sub_ps(upper_b, lower_a), distance);
+        __m128 positive = _mm_cmpgt_ps(distance, zero);
+        __m128 depth = _mm_or_ps(_mm_and_ps(positive, forward),
+                                 _mm_andnot_ps(positive, backward));
+
+        if (_mm_movemask_ps(_mm_cmplt_ps(depth, zero)))
+            return overlap;
+        _mm_store_ps(depths + i, depth);
+    }
+
+    for (u32 i = 0; i < num_axes; i++) {
+        if (depths[i] < overlap.depth || overlap.depth == -1.0f) {
+            overlap.depth = depths[i];
+            overlap.normal = V2(axis_x[i], axis_y[i]);
+        }
+    }
+
+    if (dot(overlap.normal, relative_position) < 0)
+        overlap.normal = -overlap.normal;
+
+    overlap.is_valid = true;
+    return overlap;
+}
+#endif
+
+void check_overlaps(u32 num_pairs, BodyPair *pairs, Overlap *result) {
+    bool use_cache = !debug_view_is_on();
+    for (u32 i = 0; i < num_pairs; i++) {
+        Body *body_a = pairs[i].a;
+        Body *body_b = pairs[i].b;
+        Overlap overlap = {body_a, body_b, -1.0f};
+        if ((body_a->layer & body_b->layer) == 0) {
+            result[i] = overlap;
+            continue;
+        }
+
+#ifdef __SSE2__
+        if (use_cache && body_a->cache && body_b->cache) {
+            refresh_cache(body_a);
+            refresh_cache(body_b);
+            BodyCache *cache_a = body_a->cache;
+            BodyCache *cache_b = body_b->cache;
+            if (cache_a->num_points && cache_b->num_points) {
+                // The cached boxes are tighter than the circles.
+                AABB aabb_a = {cache_a->aabb.min + body_a->position,
+                               cache_a->aabb.max + body_a->position};
+                AABB aabb_b = {cache_b->aabb.min + body_b->position,
+                               cache_b->aabb.max + body_b->position};
+                if (overlaps(aabb_a, aabb_b))
+                    overlap = check_cached_overlap_sse(body_a, body_b);
+                result[i] = overlap;
+                continue;
+            }
+        }
+#endif
+        result[i] = check_overlap(body_a, body_b);
+    }
+}
+
 void solve(Overlap overlap)
 {
 	Body *a = overlap.a;
@@ -303,104 +575,1401 @@ Overlap reversed(Overlap overlap)
 	};
 }
 
-#if 0
-void update_world(f32 delta)
-{
-	global_world.overlaps.clear();
-	for (u32 i = 0; i < global_world.limits.length; i++) {
-		Limit *limit = global_world.limits + i;
-		Body *body = get_body_ptr(limit->owner);
-        // TODO(ed): This can be made smarter, namely
-        // in linear time, is we had two lists...
-        // :o
-		if (!body) {
-			global_world.limits.remove(i);
-			i--;
-			recalculate_highest();
-			continue;
-		}
+AABB calculate_aabb(Body *body) {
+    if (body->cache) {
+        refresh_cache(body);
+        if (body->cache->num_points)
+            return {body->cache->aabb.min + body->position,
+                    body->cache->aabb.max + body->position};
+    }
 
-		integrate(body, delta);
-		*limit = project_body(*body, global_world.sorting_axis);
-	}
+    Shape *shape = find_shape(body->shape);
+    if (body->rotation == 0)
+        return unrotated_aabb(body, shape);
+
+    AABB aabb = {};
+    for (u32 i = 0; i < shape->points.length; i++) {
+        Vec2 point = rotate(hadamard(shape->points[i], body->scale) + body->offset,
+                            body->rotation);
+        if (i == 0) {
+            aabb.min = point;
+            aabb.max = point;
+            continue;
+        }
+        aabb.min.x = MIN(aabb.min.x, point.x);
+        aabb.min.y = MIN(aabb.min.y, point.y);
+        aabb.max.x = MAX(aabb.max.x, point.x);
+        aabb.max.y = MAX(aabb.max.y, point.y);
+    }
+    aabb.min += body->position;
+    aabb.max += body->position;
+    return aabb;
+}
+
+bool overlaps(AABB a, AABB b) {
+    return a.min.x <= b.max.x && b.min.x <= a.max.x &&
+           a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+AABB swept_aabb(Body *body, Vec2 motion) {
+    AABB aabb = calculate_aabb(body);
+    aabb.min.x += MIN(0, motion.x);
+    aabb.min.y += MIN(0, motion.y);
+    aabb.max.x += MAX(0, motion.x);
+    aabb.max.y += MAX(0, motion.y);
+    return aabb;
+}
+
+// The transformed points and axes of the body, in "scratch"
+// if the body doesn't have a cache. Shapes that are too large
+// to cache are swept as their bounding box.
+static BodyCache *sweep_cache(Body *body, BodyCache *scratch) {
+    BodyCache *cache = body->cache;
+    if (cache) {
+        refresh_cache(body);
+    } else {
+        cache = scratch;
+        build_cache(body, cache);
+    }
+    if (cache->num_points) return cache;
+
+    AABB aabb = calculate_aabb(body);
+    aabb.min -= body->position;
+    aabb.max -= body->position;
+    scratch->aabb = aabb;
+    scratch->num_points = 4;
+    scratch->points[0] = aabb.min;
+    scratch->points[1] = V2(aabb.max.x, aabb.min.y);
+    scratch->points[2] = aabb.max;
+    scratch->points[3] = V2(aabb.min.x, aabb.max.y);
+    scratch->num_axes = 2;
+    scratch->axes[0] = V2(1, 0);
+    scratch->axes[1] = V2(0, 1);
+    return scratch;
+}
+
+static Limit project_points(BodyCache *cache, Vec2 axis) {
+    f32 first = dot(cache->points[0], axis);
+    Limit limit = {first, first};
+    for (u32 i = 1; i < cache->num_points; i++) {
+        f32 projection = dot(cache->points[i], axis);
+        limit.upper = MAX(limit.upper, projection);
+        limit.lower = MIN(limit.lower, projection);
+    }
+    return limit;
+}
+
+Impact time_of_impact(Body *body_a, Vec2 motion_a, Body *body_b, Vec2 motion_b) {
+    Impact impact = {};
+    if ((body_a->layer & body_b->layer) == 0) return impact;
+
+    BodyCache scratch_a, scratch_b;
+    BodyCache *cache_a = sweep_cache(body_a, &scratch_a);
+    BodyCache *cache_b = sweep_cache(body_b, &scratch_b);
+    BodyCache *caches[] = {cache_a, cache_b};
+
+    // Everything is seen from "a", so only "b" moves. Along
+    // every axis there is a window of time when they overlap,
+    // they hit when all the windows overlap.
+    Vec2 relative_position = body_b->position - body_a->position;
+    Vec2 relative_motion = motion_b - motion_a;
+    f32 enter = -1.0f;
+    f32 exit = 2.0f;
+    for (u32 n = 0; n < 2; n++) {
+        BodyCache *cache = caches[n];
+        for (u32 i = 0; i < cache->num_axes; i++) {
+            Vec2 axis = cache->axes[i];
+            Limit limit_a = project_points(cache_a, axis);
+            Limit limit_b = project_points(cache_b, axis);
+            f32 distance = dot(relative_position, axis);
+            f32 speed = dot(relative_motion, axis);
+            // When the edges of "b" reach the edges of "a".
+            f32 lower_gap = limit_a.lower - (distance + limit_b.upper);
+            f32 upper_gap = limit_a.upper - (distance + limit_b.lower);
+
+            if (speed == 0) {
+                if (lower_gap > 0 || upper_gap < 0) return impact;
+                continue;
+            }
+
+            f32 first = lower_gap / speed;
+            f32 second = upper_gap / speed;
+            f32 axis_enter = MIN(first, second);
+            f32 axis_exit = MAX(first, second);
+            if (axis_enter > enter) {
+                enter = axis_enter;
+                impact.normal = axis;
+            }
+            exit = MIN(exit, axis_exit);
+            if (enter > exit || enter > 1.0f || exit < 0.0f)
+                return impact;
+        }
+    }
+
+    impact.time = CLAMP(0.0f, 1.0f, enter);
+    // Same direction as the normal of an overlap.
+    Vec2 at_impact = relative_position + relative_motion * impact.time;
+    if (dot(impact.normal, at_impact) < 0)
+        impact.normal = -impact.normal;
+    impact.is_valid = true;
+    return impact;
+}
+
+Impact raycast(Body *body, Vec2 from, Vec2 to) {
+    Impact impact = {};
+    BodyCache scratch;
+    BodyCache *cache = sweep_cache(body, &scratch);
+
+    // Clip the segment against the slab along every axis,
+    // like a sweep where the body is a point.
+    Vec2 start = from - body->position;
+    Vec2 delta = to - from;
+    f32 enter = -1.0f;
+    f32 exit = 2.0f;
+    for (u32 i = 0; i < cache->num_axes; i++) {
+        Vec2 axis = cache->axes[i];
+        Limit limit = project_points(cache, axis);
+        f32 distance = dot(start, axis);
+        f32 speed = dot(delta, axis);
+        if (speed == 0) {
+            if (distance < limit.lower || limit.upper < distance)
+                return impact;
+            continue;
+        }
+
+        f32 first = (limit.lower - distance) / speed;
+        f32 second = (limit.upper - distance) / speed;
+        f32 axis_enter = MIN(first, second);
+        if (axis_enter > enter) {
+            enter = axis_enter;
+            // Facing the ray.
+            impact.normal = speed > 0 ? -axis : axis;
+        }
+        exit = MIN(exit, MAX(first, second));
+        if (enter > exit || enter > 1.0f || exit < 0.0f)
+            return impact;
+    }
+
+    impact.time = MAX(enter, 0.0f);
+    impact.is_valid = true;
+    return impact;
+}
+
+bool overlaps_circle(Body *body, Vec2 center, f32 radius) {
+    BodyCache scratch;
+    BodyCache *cache = sweep_cache(body, &scratch);
+    Vec2 relative = center - body->position;
+
+    // The axes of the body, and the one from the closest
+    // corner to the center.
+    Vec2 closest = cache->points[0];
+    for (u32 i = 1; i < cache->num_points; i++) {
+        if (length_squared(cache->points[i] - relative) <
+            length_squared(closest - relative))
+            closest = cache->points[i];
+    }
+    for (u32 i = 0; i <= cache->num_axes; i++) {
+        Vec2 axis;
+        if (i == cache->num_axes) {
+            Vec2 towards = relative - closest;
+            if (length_squared(towards) == 0) return true;
+            axis = normalize(towards);
+        } else {
+            axis = cache->axes[i];
+        }
+        Limit limit = project_points(cache, axis);
+        f32 distance = dot(relative, axis);
+        if (distance + radius < limit.lower || limit.upper < distance - radius)
+            return false;
+    }
+    return true;
+}
+
+Grid create_grid(f32 cell_size, u32 num_buckets) {
+    ASSERT(cell_size > 0, "Cells need to have a size");
+    u32 buckets = 1;
+    while (buckets < num_buckets) buckets <<= 1;
+
+    Grid grid = {};
+    grid.cell_size = cell_size;
+    grid.inverse_cell_size = 1.0f / cell_size;
+    grid.num_buckets = buckets;
+    grid.bucket_start = Util::push_memory<u32>(buckets + 1);
+    grid.proxies = create_list<Proxy>(64);
+    grid.entries = create_list<GridEntry>(64);
+    grid.built = false;
+    grid.mark = 0;
+    return grid;
+}
+
+void destroy_grid(Grid *grid) {
+    Util::pop_memory(grid->bucket_start);
+    destroy_list(&grid->proxies);
+    destroy_list(&grid->entries);
+    *grid = {};
+}
+
+static s32 grid_cell(const Grid *grid, f32 value) {
+    return (s32) floor(value * grid->inverse_cell_size);
+}
+
+static u32 grid_bucket(const Grid *grid, s32 x, s32 y) {
+    // Large primes, so neighbouring cells end up spread out.
+    u32 hash = ((u32) x * 73856093u) ^ ((u32) y * 19349663u);
+    return hash & (grid->num_buckets - 1);
+}
+
+void Grid::clear() {
+    proxies.clear();
+    entries.clear();
+    built = false;
+}
+
+ProxyID Grid::add(AABB aabb, Layer layer, void *user) {
+    Proxy proxy = {};
+    proxy.aabb = aabb;
+    proxy.layer = layer;
+    proxy.user = user;
+    proxy.min_x = grid_cell(this, aabb.min.x);
+    proxy.min_y = grid_cell(this, aabb.min.y);
+    proxy.max_x = grid_cell(this, aabb.max.x);
+    proxy.max_y = grid_cell(this, aabb.max.y);
+    proxies.append(proxy);
+    built = false;
+    return proxies.length - 1;
+}
+
+void Grid::build() {
+    // A counting sort on the buckets, first count how many
+    // entries go in each bucket.
+    for (u32 i = 0; i <= num_buckets; i++)
+        bucket_start[i] = 0;
+    for (u32 i = 0; i < proxies.length; i++) {
+        Proxy *proxy = proxies + i;
+        for (s32 y = proxy->min_y; y <= proxy->max_y; y++)
+            for (s32 x = proxy->min_x; x <= proxy->max_x; x++)
+                bucket_start[grid_bucket(this, x, y)]++;
+    }
+
+    // Then where they end.
+    u32 total = 0;
+    for (u32 i = 0; i < num_buckets; i++) {
+        total += bucket_start[i];
+        bucket_start[i] = total;
+    }
+    bucket_start[num_buckets] = total;
+    entries.resize(total + 1);
+    entries.length = total;
+
+    // Filling them from the back leaves each bucket
+    // pointing at its first entry.
+    for (u32 i = 0; i < proxies.length; i++) {
+        Proxy *proxy = proxies + i;
+        for (s32 y = proxy->min_y; y <= proxy->max_y; y++) {
+            for (s32 x = proxy->min_x; x <= proxy->max_x; x++) {
+                u32 slot = --bucket_start[grid_bucket(this, x, y)];
+                entries.data[slot] = {i, x, y};
+            }
+        }
+    }
+    built = true;
+}
+
+void Grid::find_pairs(List<Pair> *pairs) {
+    ASSERT(built, "Grid has to be built before it's used");
+    for (u32 bucket = 0; bucket < num_buckets; bucket++) {
+        u32 end = bucket_start[bucket + 1];
+        for (u32 i = bucket_start[bucket]; i < end; i++) {
+            GridEntry *outer = entries.data + i;
+            Proxy *a = proxies.data + outer->proxy;
+            for (u32 j = i + 1; j < end; j++) {
+                GridEntry *inner = entries.data + j;
+                // Different cells can share a bucket.
+                if (outer->x != inner->x || outer->y != inner->y)
+                    continue;
+                Proxy *b = proxies.data + inner->proxy;
+                if ((a->layer & b->layer) == 0) continue;
+                if (!overlaps(a->aabb, b->aabb)) continue;
+                // Both proxies can share several cells, only the
+                // first one they share reports the pair.
+                if (MAX(a->min_x, b->min_x) != outer->x ||
+                    MAX(a->min_y, b->min_y) != outer->y)
+                    continue;
+                pairs->append({MIN(outer->proxy, inner->proxy),
+                               MAX(outer->proxy, inner->proxy)});
+            }
+        }
+    }
+}
+
+void Grid::query(AABB aabb, Layer layer, List<ProxyID> *result) {
+    ASSERT(built, "Grid has to be built before it's used");
+    s32 min_x = grid_cell(this, aabb.min.x);
+    s32 min_y = grid_cell(this, aabb.min.y);
+    s32 max_x = grid_cell(this, aabb.max.x);
+    s32 max_y = grid_cell(this, aabb.max.y);
+    for (s32 y = min_y; y <= max_y; y++) {
+        for (s32 x = min_x; x <= max_x; x++) {
+            u32 bucket = grid_bucket(this, x, y);
+            u32 end = bucket_start[bucket + 1];
+            for (u32 i = bucket_start[bucket]; i < end; i++) {
+                GridEntry *entry = entries.data + i;
+                if (entry->x != x || entry->y != y) continue;
+                Proxy *proxy = proxies.data + entry->proxy;
+                if ((proxy->layer & layer) == 0) continue;
+                if (!overlaps(proxy->aabb, aabb)) continue;
+                if (MAX(proxy->min_x, min_x) != x ||
+                    MAX(proxy->min_y, min_y) != y)
+                    continue;
+                result->append(entry->proxy);
+            }
+        }
+    }
+}
+
+void Grid::query_radius(Vec2 center, f32 radius, Layer layer,
+                        List<ProxyID> *result) {
+    u32 first = result->length;
+    query({center - V2(radius, radius), center + V2(radius, radius)},
+          layer, result);
+    // The corners of the box are too far away.
+    u32 kept = first;
+    for (u32 i = first; i < result->length; i++) {
+        AABB aabb = proxies[(*result)[i]].aabb;
+        Vec2 closest = V2(CLAMP(aabb.min.x, aabb.max.x, center.x),
+                          CLAMP(aabb.min.y, aabb.max.y, center.y));
+        if (length_squared(closest - center) <= radius * radius)
+            (*result)[kept++] = (*result)[i];
+    }
+    result->length = kept;
+}
+
+// When the segment enters the box, if it does before "max_time".
+static bool segment_hits_aabb(AABB aabb, Vec2 from, Vec2 delta,
+                              f32 max_time, f32 *time) {
+    f32 enter = 0.0f;
+    f32 exit = max_time;
+    for (u32 i = 0; i < 2; i++) {
+        f32 start = i ? from.y : from.x;
+        f32 speed = i ? delta.y : delta.x;
+        f32 lower = i ? aabb.min.y : aabb.min.x;
+        f32 upper = i ? aabb.max.y : aabb.max.x;
+        if (speed == 0) {
+            if (start < lower || upper < start) return false;
+            continue;
+        }
+        f32 first = (lower - start) / speed;
+        f32 second = (upper - start) / speed;
+        enter = MAX(enter, MIN(first, second));
+        exit = MIN(exit, MAX(first, second));
+        if (enter > exit) return false;
+    }
+    *time = enter;
+    return true;
+}
+
+void Grid::raycast(Vec2 from, Vec2 to, Layer layer, RaycastCallback callback) {
+    ASSERT(built, "Grid has to be built before it's used");
+    // Proxies cover many cells, the mark makes sure
+    // each one is only reported once.
+    if (++mark == 0) {
+        for (u32 i = 0; i < proxies.length; i++)
+            proxies[i].mark = 0;
+        mark = 1;
+    }
+
+    // Step from cell to cell along the segment, always
+    // crossing the closest border next.
+    Vec2 delta = to - from;
+    s32 x = grid_cell(this, from.x);
+    s32 y = grid_cell(this, from.y);
+    s32 step_x = delta.x < 0 ? -1 : 1;
+    s32 step_y = delta.y < 0 ? -1 : 1;
+    f32 cell_time_x = delta.x != 0 ? ABS(cell_size / delta.x) : 2.0f;
+    f32 cell_time_y = delta.y != 0 ? ABS(cell_size / delta.y) : 2.0f;
+    f32 border_x = (x + (delta.x < 0 ? 0 : 1)) * cell_size;
+    f32 border_y = (y + (delta.y < 0 ? 0 : 1)) * cell_size;
+    f32 next_x = delta.x != 0 ? (border_x - from.x) / delta.x : 2.0f;
+    f32 next_y = delta.y != 0 ? (border_y - from.y) / delta.y : 2.0f;
+
+    s32 cells_left = ABS(grid_cell(this, to.x) - x) +
+                     ABS(grid_cell(this, to.y) - y);
+    f32 max_time = 1.0f;
+    f32 time = 0.0f;
+    while (time <= max_time) {
+        u32 bucket = grid_bucket(this, x, y);
+        u32 end = bucket_start[bucket + 1];
+        for (u32 i = bucket_start[bucket]; i < end; i++) {
+            GridEntry *entry = entries.data + i;
+            if (entry->x != x || entry->y != y) continue;
+            Proxy *proxy = proxies.data + entry->proxy;
+            if ((proxy->layer & layer) == 0) continue;
+            if (proxy->mark == mark) continue;
+            proxy->mark = mark;
+            f32 enter;
+            if (!segment_hits_aabb(proxy->aabb, from, delta, max_time, &enter))
+                continue;
+            max_time = MIN(max_time, callback(entry->proxy, max_time));
+        }
+
+        if (cells_left-- <= 0) break;
+        if (next_x < next_y) {
+            time = next_x;
+            next_x += cell_time_x;
+            x += step_x;
+        } else {
+            time = next_y;
+            next_y += cell_time_y;
+            y += step_y;
+        }
+    }
+}
+
+void Grid::query_segment(Vec2 from, Vec2 to, Layer layer,
+                         List<ProxyID> *result) {
+    raycast(from, to, layer, [result](ProxyID proxy, f32 max_time) {
+        result->append(proxy);
+        return max_time;
+    });
+}
+
+//
+// Tree
+//
+
+Tree create_tree(f32 margin, u32 capacity) {
+    Tree tree = {};
+    tree.margin = margin;
+    tree.root = Tree::NONE;
+    tree.free = Tree::NONE;
+    tree.num_leaves = 0;
+    tree.nodes = create_list<TreeNode>(MAX(capacity * 2, 2u));
+    tree.stack = create_list<s32>(64);
+    return tree;
+}
+
+void destroy_tree(Tree *tree) {
+    destroy_list(&tree->nodes);
+    destroy_list(&tree->stack);
+    *tree = {};
+}
+
+static AABB combine(AABB a, AABB b) {
+    return {V2(MIN(a.min.x, b.min.x), MIN(a.min.y, b.min.y)),
+            V2(MAX(a.max.x, b.max.x), MAX(a.max.y, b.max.y))};
+}
+
+static bool contains(AABB outer, AABB inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y &&
+           inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+}
+
+// Cheaper to get than the area, and works as well
+// for guessing how often a box is hit.
+static f32 perimeter(AABB aabb) {
+    return 2.0f * ((aabb.max.x - aabb.min.x) + (aabb.max.y - aabb.min.y));
+}
+
+static s32 allocate_node(Tree *tree) {
+    s32 index;
+    if (tree->free != Tree::NONE) {
+        index = tree->free;
+        tree->free = tree->nodes[index].parent;
+    } else {
+        index = tree->nodes.length;
+        tree->nodes.append({});
+    }
+    TreeNode *node = tree->nodes + index;
+    *node = {};
+    node->parent = Tree::NONE;
+    node->left = Tree::NONE;
+    node->right = Tree::NONE;
+    return index;
+}
 
-	// Sort the list, a stable insertion sort
+static void free_node(Tree *tree, s32 index) {
+    TreeNode *node = tree->nodes + index;
+    node->height = -1;
+    node->parent = tree->free;
+    tree->free = index;
+}
+
+static void refit_node(Tree *tree, s32 index) {
+    TreeNode *node = tree->nodes + index;
+    TreeNode *left = tree->nodes + node->left;
+    TreeNode *right = tree->nodes + node->right;
+    node->aabb = combine(left->aabb, right->aabb);
+    node->layer = left->layer | right->layer;
+    node->height = 1 + MAX(left->height, right->height);
+}
+
+static void replace_child(Tree *tree, s32 parent, s32 from, s32 to) {
+    if (parent == Tree::NONE) {
+        tree->root = to;
+        return;
+    }
+    TreeNode *node = tree->nodes + parent;
+    if (node->left == from) node->left = to;
+    else node->right = to;
+}
+
+// Moves the child "up" into the place of "index", the
+// taller of its children goes with it and the shorter
+// one takes its old place.
+static s32 rotate_up(Tree *tree, s32 index, s32 up) {
+    TreeNode *node = tree->nodes + index;
+    TreeNode *raised = tree->nodes + up;
+    s32 first = raised->left;
+    s32 second = raised->right;
+    bool first_taller = tree->nodes[first].height > tree->nodes[second].height;
+    s32 keep = first_taller ? first : second;
+    s32 lower = first_taller ? second : first;
+
+    replace_child(tree, node->parent, index, up);
+    raised->parent = node->parent;
+    raised->left = index;
+    raised->right = keep;
+    node->parent = up;
+    if (node->left == up) node->left = lower;
+    else node->right = lower;
+    tree->nodes[lower].parent = index;
+
+    refit_node(tree, index);
+    refit_node(tree, up);
+    return up;
+}
+
+static s32 balance(Tree *tree, s32 index) {
+    TreeNode *node = tree->nodes + index;
+    if (node->height < 2) return index;
+    s32 difference = tree->nodes[node->right].height -
+                     tree->nodes[node->left].height;
+    if (difference > 1) return rotate_up(tree, index, node->right);
+    if (difference < -1) return rotate_up(tree, index, node->left);
+    return index;
+}
+
+static void fix_upwards(Tree *tree, s32 index) {
+    while (index != Tree::NONE) {
+        index = balance(tree, index);
+        refit_node(tree, index);
+        index = tree->nodes[index].parent;
+    }
+}
+
+static void insert_leaf(Tree *tree, s32 leaf) {
+    if (tree->root == Tree::NONE) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = Tree::NONE;
+        return;
+    }
+
+    // Walk down to where adding the leaf grows the
+    // boxes the least.
+    AABB aabb = tree->nodes[leaf].aabb;
+    s32 index = tree->root;
+    while (tree->nodes[index].height > 0) {
+        TreeNode *node = tree->nodes + index;
+        f32 combined = perimeter(combine(node->aabb, aabb));
+        // Making a new parent here, or pushing everything
+        // below further out.
+        f32 here = 2.0f * combined;
+        f32 growth = 2.0f * (combined - perimeter(node->aabb));
+        f32 costs[2];
+        s32 children[] = {node->left, node->right};
+        for (u32 i = 0; i < 2; i++) {
+            TreeNode *child = tree->nodes + children[i];
+            f32 grown = perimeter(combine(child->aabb, aabb));
+            if (child->height > 0) grown -= perimeter(child->aabb);
+            costs[i] = grown + growth;
+        }
+        if (here < costs[0] && here < costs[1]) break;
+        index = costs[0] < costs[1] ? children[0] : children[1];
+    }
+
+    s32 sibling = index;
+    s32 old_parent = tree->nodes[sibling].parent;
+    s32 parent = allocate_node(tree);
+    TreeNode *node = tree->nodes + parent;
+    node->parent = old_parent;
+    node->left = sibling;
+    node->right = leaf;
+    tree->nodes[sibling].parent = parent;
+    tree->nodes[leaf].parent = parent;
+    replace_child(tree, old_parent, sibling, parent);
+    fix_upwards(tree, parent);
+}
+
+static void remove_leaf(Tree *tree, s32 leaf) {
+    if (tree->root == leaf) {
+        tree->root = Tree::NONE;
+        return;
+    }
+    s32 parent = tree->nodes[leaf].parent;
+    TreeNode *node = tree->nodes + parent;
+    s32 sibling = node->left == leaf ? node->right : node->left;
+    s32 grandparent = node->parent;
+    replace_child(tree, grandparent, parent, sibling);
+    tree->nodes[sibling].parent = grandparent;
+    free_node(tree, parent);
+    fix_upwards(tree, grandparent);
+}
+
+static AABB fatten(AABB aabb, f32 margin, Vec2 motion) {
+    aabb.min -= V2(margin, margin);
+    aabb.max += V2(margin, margin);
+    // Stretched where it's going, so moving bodies
+    // don't have to be moved in the tree as often.
+    if (motion.x < 0) aabb.min.x += motion.x;
+    else aabb.max.x += motion.x;
+    if (motion.y < 0) aabb.min.y += motion.y;
+    else aabb.max.y += motion.y;
+    return aabb;
+}
+
+ProxyID Tree::insert(AABB aabb, Layer layer, void *user) {
+    s32 leaf = allocate_node(this);
+    TreeNode *node = nodes + leaf;
+    node->aabb = fatten(aabb, margin, V2(0, 0));
+    node->layer = layer;
+    node->user = user;
+    node->height = 0;
+    insert_leaf(this, leaf);
+    num_leaves++;
+    return leaf;
+}
+
+void Tree::remove(ProxyID proxy) {
+    ASSERT(proxy < nodes.length && nodes[proxy].height == 0,
+           "Not a proxy in the tree");
+    remove_leaf(this, proxy);
+    free_node(this, proxy);
+    num_leaves--;
+}
+
+bool Tree::move(ProxyID proxy, AABB aabb, Vec2 motion) {
+    ASSERT(proxy < nodes.length && nodes[proxy].height == 0,
+           "Not a proxy in the tree");
+    TreeNode *node = nodes + proxy;
+    if (contains(node->aabb, aabb)) return false;
+    remove_leaf(this, proxy);
+    nodes[proxy].aabb = fatten(aabb, margin, motion * 2.0f);
+    insert_leaf(this, proxy);
+    return true;
+}
+
+s32 Tree::height() {
+    if (root == NONE) return 0;
+    return nodes[root].height;
+}
+
+// Splits the leaves at the middle of the longest side,
+// and builds a node for each half.
+static s32 build_nodes(Tree *tree, s32 *leaves, u32 count) {
+    if (count == 1) return leaves[0];
+    AABB centers = {};
+    for (u32 i = 0; i < count; i++) {
+        AABB aabb = tree->nodes[leaves[i]].aabb;
+        Vec2 center = (aabb.min + aabb.max) * 0.5f;
+        centers = i ? combine(centers, {center, center}) : AABB{center, center};
+    }
+    bool along_x = centers.max.x - centers.min.x > centers.max.y - centers.min.y;
+    TreeNode *nodes = tree->nodes.data;
+    u32 half = count / 2;
+    std::nth_element(leaves, leaves + half, leaves + count,
+                     [nodes, along_x](s32 a, s32 b) {
+        AABB box_a = nodes[a].aabb;
+        AABB box_b = nodes[b].aabb;
+        if (along_x) return box_a.min.x + box_a.max.x < box_b.min.x + box_b.max.x;
+        return box_a.min.y + box_a.max.y < box_b.min.y + box_b.max.y;
+    });
+
+    s32 left = build_nodes(tree, leaves, half);
+    s32 right = build_nodes(tree, leaves + half, count - half);
+    s32 parent = allocate_node(tree);
+    TreeNode *node = tree->nodes + parent;
+    node->left = left;
+    node->right = right;
+    tree->nodes[left].parent = parent;
+    tree->nodes[right].parent = parent;
+    refit_node(tree, parent);
+    return parent;
+}
+
+void Tree::rebuild() {
+    // The inner nodes are thrown away, the leaves are kept
+    // so the ids don't change.
+    stack.clear();
+    for (u32 i = 0; i < nodes.length; i++) {
+        if (nodes[i].height == 0) stack.append(i);
+        else if (nodes[i].height > 0) free_node(this, i);
+    }
+    root = NONE;
+    if (stack.length == 0) return;
+    // All the nodes needed are free, so the list doesn't move.
+    root = build_nodes(this, stack.data, stack.length);
+    nodes[root].parent = NONE;
+}
+
+// Calls "visit" with every leaf that overlaps the box.
+template <typename F>
+static void visit_tree(Tree *tree, AABB aabb, Layer layer, F visit) {
+    if (tree->root == Tree::NONE) return;
+    List<s32> *stack = &tree->stack;
+    stack->clear();
+    stack->append(tree->root);
+    while (stack->length) {
+        s32 index = (*stack)[--stack->length];
+        TreeNode *node = tree->nodes + index;
+        if ((node->layer & layer) == 0) continue;
+        if (!overlaps(node->aabb, aabb)) continue;
+        if (node->height == 0) {
+            visit(index);
+        } else {
+            stack->append(node->left);
+            stack->append(node->right);
+        }
+    }
+}
+
+void Tree::find_pairs(List<Pair> *pairs) {
+    // The tree is checked against itself, a pair of nodes
+    // is split until both are leaves. The same node twice
+    // means the children should be checked against each
+    // other, and against themselves.
+    if (root == NONE) return;
+    stack.clear();
+    stack.append(root);
+    stack.append(root);
+    while (stack.length) {
+        s32 b = stack[--stack.length];
+        s32 a = stack[--stack.length];
+        TreeNode *node_a = nodes + a;
+        TreeNode *node_b = nodes + b;
+        if (a == b) {
+            if (node_a->height == 0) continue;
+            s32 children[] = {node_a->left, node_a->left,
+                              node_a->right, node_a->right,
+                              node_a->left, node_a->right};
+            for (u32 i = 0; i < LEN(children); i++)
+                stack.append(children[i]);
+            continue;
+        }
+
+        if ((node_a->layer & node_b->layer) == 0) continue;
+        if (!overlaps(node_a->aabb, node_b->aabb)) continue;
+        if (node_a->height == 0 && node_b->height == 0) {
+            pairs->append({(u32) MIN(a, b), (u32) MAX(a, b)});
+            continue;
+        }
+        // Split the larger one.
+        if (node_b->height == 0 ||
+            (node_a->height > 0 &&
+             perimeter(node_a->aabb) > perimeter(node_b->aabb))) {
+            stack.append(node_a->left);
+            stack.append(b);
+            stack.append(node_a->right);
+            stack.append(b);
+        } else {
+            stack.append(a);
+            stack.append(node_b->left);
+            stack.append(a);
+            stack.append(node_b->right);
+        }
+    }
+}
+
+void Tree::query(AABB aabb, Layer layer, List<ProxyID> *result) {
+    visit_tree(this, aabb, layer, [result](s32 leaf) {
+        result->append(leaf);
+    });
+}
+
+void Tree::raycast(Vec2 from, Vec2 to, Layer layer, RaycastCallback callback) {
+    if (root == NONE) return;
+    Vec2 delta = to - from;
+    f32 max_time = 1.0f;
+    stack.clear();
+    stack.append(root);
+    while (stack.length) {
+        s32 index = stack[--stack.length];
+        TreeNode *node = nodes + index;
+        if ((node->layer & layer) == 0) continue;
+        f32 enter;
+        if (!segment_hits_aabb(node->aabb, from, delta, max_time, &enter))
+            continue;
+        if (node->height == 0) {
+            // The callback can't change the tree, so the
+            // node is still there.
+            max_time = MIN(max_time, callback(index, max_time));
+        } else {
+            stack.append(node->left);
+            stack.append(node->right);
+        }
+    }
+}
+
+//
+// Contacts
+//
+
+// How much the bodies are allowed to sink into each other,
+// and how much of the rest is pushed out every step.
+const f32 CONTACT_SLOP = 0.01f;
+const f32 CONTACT_CORRECTION = 0.4f;
+// Slower hits than this don't bounce.
+const f32 BOUNCE_THRESHOLD = 1.0f;
+
+static void destroy_contact_table(ContactTable *table) {
+    Util::pop_memory(table->contacts);
+    Util::pop_memory(table->used);
+    *table = {};
+}
+
+static void clear_contact_table(ContactTable *table, u32 min_capacity) {
+    if (table->capacity < min_capacity) {
+        u32 capacity = MAX(table->capacity, 64u);
+        while (capacity < min_capacity) capacity <<= 1;
+        destroy_contact_table(table);
+        table->capacity = capacity;
+        table->contacts = Util::push_memory<Contact>(capacity);
+        table->used = Util::push_memory<bool>(capacity);
+    }
+    for (u32 i = 0; i < table->capacity; i++)
+        table->used[i] = false;
+    table->length = 0;
+}
+
+static u32 contact_hash(BodyID a, BodyID b) {
+    u32 hash = 2166136261u;
+    u32 keys[] = {(u32) a.slot, a.gen, (u32) b.slot, b.gen};
+    for (u32 i = 0; i < LEN(keys); i++) {
+        hash ^= keys[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns the slot of the pair, or the empty slot it would go in.
+static u32 find_contact(ContactTable *table, BodyID a, BodyID b) {
+    u32 mask = table->capacity - 1;
+    u32 slot = contact_hash(a, b) & mask;
+    while (table->used[slot]) {
+        Contact *contact = table->contacts + slot;
+        if (contact->a == a && contact->b == b) return slot;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static Contact *lookup_contact(ContactTable *table, BodyID a, BodyID b) {
+    if (!table->capacity) return nullptr;
+    u32 slot = find_contact(table, a, b);
+    return table->used[slot] ? table->contacts + slot : nullptr;
+}
+
+static Contact *insert_contact(ContactTable *table, BodyID a, BodyID b) {
+    u32 slot = find_contact(table, a, b);
+    if (!table->used[slot]) {
+        table->used[slot] = true;
+        table->length++;
+        table->contacts[slot] = {};
+        table->contacts[slot].a = a;
+        table->contacts[slot].b = b;
+    }
+    return table->contacts + slot;
+}
+
+static void apply_impulse(Contact *contact, Vec2 impulse) {
+    contact->body_a->velocity -= impulse * contact->body_a->inverse_mass;
+    contact->body_b->velocity += impulse * contact->body_b->inverse_mass;
+}
+
+static void solve_contacts(World *world, f32 delta) {
+    List<Contact *> *active = &world->active;
+
+    // Remember the velocities, the positions were moved with
+    // the unsolved ones and are fixed afterwards.
+    world->velocities.resize(world->bodies.length + 1);
+    world->velocities.length = world->bodies.length;
+    for (u32 i = 0; i < world->bodies.length; i++)
+        world->velocities[i] = world->bodies[i].velocity;
+
+    for (u32 i = 0; i < active->length; i++) {
+        Contact *contact = (*active)[i];
+        Body *a = contact->body_a;
+        Body *b = contact->body_b;
+        contact->mass = 1.0f / (a->inverse_mass + b->inverse_mass);
+        contact->friction = sqrt(a->friction * b->friction);
+
+        f32 normal_velocity = dot(b->velocity - a->velocity, contact->normal);
+        f32 bounce = MAX(a->bounce, b->bounce);
+        contact->target_velocity = 0;
+        if (normal_velocity < -BOUNCE_THRESHOLD)
+            contact->target_velocity = -bounce * normal_velocity;
+
+        if (world->warm_start) {
+            Vec2 tangent = rotate_ccw(contact->normal);
+            apply_impulse(contact, contact->normal * contact->normal_impulse +
+                                   tangent * contact->tangent_impulse);
+        } else {
+            contact->normal_impulse = 0;
+            contact->tangent_impulse = 0;
+        }
+    }
+
+    for (u32 iteration = 0; iteration < world->iterations; iteration++) {
+        for (u32 i = 0; i < active->length; i++) {
+            Contact *contact = (*active)[i];
+            Body *a = contact->body_a;
+            Body *b = contact->body_b;
+            Vec2 normal = contact->normal;
+            Vec2 tangent = rotate_ccw(normal);
+
+            // Push them apart, the total impulse can't pull.
+            f32 normal_velocity = dot(b->velocity - a->velocity, normal);
+            f32 impulse = contact->mass * (contact->target_velocity - normal_velocity);
+            f32 total = MAX(contact->normal_impulse + impulse, 0.0f);
+            impulse = total - contact->normal_impulse;
+            contact->normal_impulse = total;
+            apply_impulse(contact, normal * impulse);
+
+            // Friction, limited by how hard they are pushed together.
+            f32 tangent_velocity = dot(b->velocity - a->velocity, tangent);
+            f32 limit = contact->friction * contact->normal_impulse;
+            impulse = -contact->mass * tangent_velocity;
+            total = CLAMP(-limit, limit, contact->tangent_impulse + impulse);
+            impulse = total - contact->tangent_impulse;
+            contact->tangent_impulse = total;
+            apply_impulse(contact, tangent * impulse);
+        }
+    }
+
+    // Move the bodies as if they had the solved velocities
+    // the whole step.
+    for (u32 i = 0; i < world->bodies.length; i++) {
+        Body *body = world->bodies + i;
+        body->position += (body->velocity - world->velocities[i]) * delta;
+    }
+
+    // Push out what is left of the overlap.
+    for (u32 i = 0; i < active->length; i++) {
+        Contact *contact = (*active)[i];
+        Body *a = contact->body_a;
+        Body *b = contact->body_b;
+        f32 depth = MAX(contact->depth - CONTACT_SLOP, 0.0f) * CONTACT_CORRECTION;
+        Vec2 correction = contact->normal * depth * contact->mass;
+        a->position -= correction * a->inverse_mass;
+        b->position += correction * b->inverse_mass;
+    }
+}
+
+// How many pairs each job checks.
+const u32 OVERLAP_BATCH = 256;
+
+World create_world(s32 capacity, f32 cell_size) {
+    ASSERT(capacity > 0, "A world needs room for bodies");
+    World world = {};
+    world.capacity = capacity;
+    // The callbacks need their constructors run.
+    world.slots = new BodySlot[capacity];
+    for (s32 i = 0; i < capacity; i++) {
+        world.slots[i].gen = 0;
+        world.slots[i].index = i + 1;
+    }
+    world.slots[capacity - 1].index = World::NONE;
+    world.free = 0;
+    world.caches = Util::push_memory<BodyCache>(capacity);
+
+    world.bodies = create_list<Body>(capacity);
+    world.owners = create_list<BodyID>(capacity);
+    world.limits = create_list<SweepLimit>(capacity);
+    world.previous = create_list<Vec2>(capacity);
+    world.pairs = create_list<BodyPair>(capacity);
+    world.results = create_list<Overlap>(capacity);
+    world.overlaps = create_list<WorldOverlap>(capacity);
+
+    world.iterations = 8;
+    world.warm_start = true;
+    world.active = create_list<Contact *>(capacity);
+    world.velocities = create_list<Vec2>(capacity);
+
+    world.grid = create_grid(cell_size, capacity * 2);
+    world.found = create_list<ProxyID>(64);
+    world.grid_is_stale = true;
+    return world;
+}
+
+void destroy_world(World *world) {
+    delete[] world->slots;
+    Util::pop_memory(world->caches);
+    destroy_list(&world->bodies);
+    destroy_list(&world->owners);
+    destroy_list(&world->limits);
+    destroy_list(&world->previous);
+    destroy_list(&world->pairs);
+    destroy_list(&world->results);
+    destroy_list(&world->overlaps);
+    destroy_list(&world->active);
+    destroy_list(&world->velocities);
+    destroy_contact_table(&world->contacts);
+    destroy_contact_table(&world->old_contacts);
+    destroy_grid(&world->grid);
+    destroy_list(&world->found);
+    *world = {};
+}
+
+BodyID World::add(Body body, OverlapCallback overlap) {
+    ASSERT(free != NONE, "Too many bodies in the world");
+    s32 slot = free;
+    BodySlot *to = slots + slot;
+    free = to->index;
+
+    to->gen++;
+    to->index = bodies.length;
+    to->overlap = overlap;
+
+    BodyID id = {slot, to->gen};
+    attach_cache(&body, caches + slot);
+    bodies.append(body);
+    owners.append(id);
+    // The limit is filled in and sorted in the next step.
+    limits.append({0, 0, 0, 0, 0, id});
+    grid_is_stale = true;
+    return id;
+}
+
+bool World::valid(BodyID id) {
+    if (id.slot < 0 || capacity <= id.slot) return false;
+    BodySlot *slot = slots + id.slot;
+    return slot->gen == id.gen && slot->index != NONE &&
+           slot->index < (s32) bodies.length &&
+           owners[slot->index] == id;
+}
+
+Body *World::get(BodyID id) {
+    if (!valid(id)) return nullptr;
+    return bodies + slots[id.slot].index;
+}
+
+void World::remove(BodyID id) {
+    if (!valid(id)) {
+        CHECK(false, "Trying to remove unknown body");
+        return;
+    }
+    BodySlot *slot = slots + id.slot;
+    // Move the last body into the hole.
+    s32 index = slot->index;
+    s32 last = bodies.length - 1;
+    if (index != last) {
+        bodies[index] = bodies[last];
+        owners[index] = owners[last];
+        slots[owners[index].slot].index = index;
+    }
+    bodies.length--;
+    owners.length--;
+
+    // The limit is removed in the next step.
+    grid_is_stale = true;
+    slot->gen++;
+    slot->overlap = nullptr;
+    slot->index = free;
+    free = id.slot;
+}
+
+// Continuous bodies that hit each other during the step are
+// moved back to where they first touched. Bodies that already
+// overlapped at the start are left to the discrete check.
+static Overlap sweep_pair(World *world, WorldOverlap found) {
+    Body *a = world->get(found.a);
+    Body *b = world->get(found.b);
+    Vec2 motion_a = V2(0, 0);
+    Vec2 motion_b = V2(0, 0);
+    if (a->continuous)
+        motion_a = a->position - world->previous[world->slots[found.a.slot].index];
+    if (b->continuous)
+        motion_b = b->position - world->previous[world->slots[found.b.slot].index];
+
+    Body start_a = *a;
+    Body start_b = *b;
+    start_a.position -= motion_a;
+    start_b.position -= motion_b;
+    Impact impact = time_of_impact(&start_a, motion_a, &start_b, motion_b);
+    if (!impact || impact.time == 0.0f) return {a, b, -1.0f};
+
+    a->position = start_a.position + motion_a * impact.time;
+    b->position = start_b.position + motion_b * impact.time;
+    return {a, b, 0.0f, impact.normal, true};
+}
+
+void World::step(f32 delta) {
+    grid_is_stale = true;
+    previous.resize(bodies.length + 1);
+    previous.length = bodies.length;
+    for (u32 i = 0; i < bodies.length; i++) {
+        previous[i] = bodies[i].position;
+        integrate(bodies + i, delta);
+    }
+
+    // Update the limits, and drop the ones
+    // that belong to removed bodies.
+    u32 num_limits = 0;
+    for (u32 i = 0; i < limits.length; i++) {
+        SweepLimit limit = limits[i];
+        Body *body = get(limit.owner);
+        if (!body) continue;
+        AABB aabb;
+        if (body->continuous) {
+            Vec2 start = previous[slots[limit.owner.slot].index];
+            aabb = swept_aabb(body, start - body->position);
+        } else {
+            aabb = calculate_aabb(body);
+        }
+        limit.lower = aabb.min.x;
+        limit.upper = aabb.max.x;
+        limit.bottom = aabb.min.y;
+        limit.top = aabb.max.y;
+        limit.layer = body->layer;
+        limits[num_limits++] = limit;
+    }
+    limits.length = num_limits;
+
+    // Sort the list, a stable insertion sort
     // since the list should already be sorted.
-	for (u32 i = 1; i < global_world.limits.length; i++) {
-		for (u32 j = i; 0 < j; j--) {
-			Limit a = global_world.limits[j - 0];
-			Limit b = global_world.limits[j - 1];
-			if (b.lower < a.lower)
-				break;
-			global_world.limits[j - 0] = b;
-			global_world.limits[j - 1] = a;
-		}
-	}
+    for (u32 i = 1; i < limits.length; i++) {
+        for (u32 j = i; 0 < j; j--) {
+            SweepLimit a = limits[j - 0];
+            SweepLimit b = limits[j - 1];
+            if (b.lower <= a.lower)
+                break;
+            limits[j - 0] = b;
+            limits[j - 1] = a;
+        }
+    }
 
-	// Collision detection and resolution.
-	for (u32 i = 0; i < global_world.limits.length; i++)
-	{
-		Limit outer = global_world.limits[i];
-		for (u32 j = i + 1; j < global_world.limits.length; j++)
-		{
-			Limit inner = global_world.limits[j];
-			if ((outer.layer & inner.layer) == 0)
-				break;
-			if (outer.upper < inner.lower)
-				break;
-			Body *a = get_body_ptr(outer.owner);
-			Body *b = get_body_ptr(inner.owner);
-
-			if (!a) break;
-			if (!b) continue;
-
-			if (a->trigger == true && b->trigger == true)
-				continue;
-			if (a->inverse_mass == 0 && b->inverse_mass == 0)
-				continue;
-
-			Overlap overlap = check_bodies(a, b, delta);
-			if (!overlap.is_valid)
-				continue; // Not a collision
-			global_world.overlaps.append(overlap);
+    // Collision detection, the pairs are collected
+    // first and checked in one batch.
+    pairs.clear();
+    overlaps.clear();
+    for (u32 i = 0; i < limits.length; i++) {
+        SweepLimit outer = limits[i];
+        for (u32 j = i + 1; j < limits.length; j++) {
+            SweepLimit inner = limits[j];
+            if (outer.upper < inner.lower)
+                break;
+            if ((outer.layer & inner.layer) == 0)
+                continue;
+            if (outer.top < inner.bottom || inner.top < outer.bottom)
+                continue;
+            Body *a = get(outer.owner);
+            Body *b = get(inner.owner);
+            if (a->trigger && b->trigger)
+                continue;
+            if (a->inverse_mass == 0 && b->inverse_mass == 0)
+                continue;
 
-		}
-	}
-	
-    // Solve collisions.
-	for (u32 i = 0; i < global_world.overlaps.length; i++) {
-		Overlap overlap = global_world.overlaps[i];
-		Body *a = get_body_ptr(overlap.a);
-		Body *b = get_body_ptr(overlap.b);
-
-		bool solved = false;
-		if (a->overlap)
-			solved |= a->overlap(a, b, overlap);
-		if (b->overlap)
-			solved |= b->overlap(b, a, reversed(overlap));
-
-		if (!solved)
-			solve(overlap, delta);
-	}
+            pairs.append({a, b});
+            overlaps.append({outer.owner, inner.owner});
+        }
+    }
 
-#if 0
-    // Copy state back to the entity.
-	for (u32 i = 0; i < global_world.bodies.length; i++) {
-		Body body = global_world.bodies[i];
-		if (body.owner.pos != (s32) i) continue;
-	}
+    // Pairs share bodies, but checking them only reads the
+    // bodies since "integrate" refreshed every cache, so the
+    // pairs are spread over the threads. The debug view is
+    // drawn in order.
+    results.resize(pairs.length + 1);
+    if (debug_view_is_on()) {
+        check_overlaps(pairs.length, pairs.data, results.data);
+    } else {
+#ifdef DEBUG
+        for (u32 i = 0; i < bodies.length; i++)
+            ASSERT(!bodies[i].cache || cache_is_current(bodies + i),
+                   "A cache has to be refreshed before the overlaps are checked");
 #endif
+        Jobs::parallel_for(pairs.length, OVERLAP_BATCH, [this](u32 begin, u32 end) {
+            check_overlaps(end - begin, pairs.data + begin, results.data + begin);
+        });
+    }
+    u32 num_overlaps = 0;
+    for (u32 i = 0; i < overlaps.length; i++) {
+        WorldOverlap found = overlaps[i];
+        found.overlap = results[i];
+        // Even if they overlap now, the first hit might have
+        // been on the other side.
+        if (pairs[i].a->continuous || pairs[i].b->continuous) {
+            Overlap swept = sweep_pair(this, found);
+            if (swept) found.overlap = swept;
+        }
+        if (!found.overlap) continue;
+        overlaps[num_overlaps++] = found;
+    }
+    overlaps.length = num_overlaps;
 
-	// Reset the bodies.
-	for (u32 i = 0; i < global_world.limits.length; i++) {
-		Limit *limit = global_world.limits + i;
-		Body *body = get_body_ptr(limit->owner);
-		if (!body) continue;
-		body->acceleration = {};
-		body->force = {};
-	}
+    // Call the callbacks, they are allowed to add and remove
+    // bodies, so the pointers are fetched again after every call.
+    for (u32 i = 0; i < overlaps.length; i++) {
+        WorldOverlap *found_ptr = overlaps + i;
+        WorldOverlap found = *found_ptr;
+        Overlap overlap = found.overlap;
+        found_ptr->solve = false;
+
+        bool solved = false;
+        if (!valid(found.a) || !valid(found.b)) continue;
+        if (slots[found.a.slot].overlap) {
+            overlap.a = get(found.a);
+            overlap.b = get(found.b);
+            solved |= slots[found.a.slot].overlap(overlap.a, overlap.b, overlap);
+        }
+
+        if (!valid(found.a) || !valid(found.b)) continue;
+        if (slots[found.b.slot].overlap) {
+            overlap.a = get(found.a);
+            overlap.b = get(found.b);
+            solved |= slots[found.b.slot].overlap(overlap.b, overlap.a,
+                                                  reversed(overlap));
+        }
+
+        if (!valid(found.a) || !valid(found.b)) continue;
+        overlap.a = get(found.a);
+        overlap.b = get(found.b);
+        found_ptr->solve = !solved && !overlap.a->trigger && !overlap.b->trigger;
+    }
+
+    if (iterations == 0) {
+        for (u32 i = 0; i < overlaps.length; i++) {
+            WorldOverlap found = overlaps[i];
+            if (!found.solve || !valid(found.a) || !valid(found.b)) continue;
+            found.overlap.a = get(found.a);
+            found.overlap.b = get(found.b);
+            solve(found.overlap);
+        }
+        return;
+    }
+
+    // Build this steps contacts, picking up the impulses from
+    // the last step if the pair was touching then too.
+    ContactTable last = contacts;
+    contacts = old_contacts;
+    old_contacts = last;
+    clear_contact_table(&contacts, overlaps.length * 2 + 1);
+    active.clear();
+    for (u32 i = 0; i < overlaps.length; i++) {
+        WorldOverlap found = overlaps[i];
+        if (!found.solve || !valid(found.a) || !valid(found.b)) continue;
+        Overlap overlap = found.overlap;
+        // The order along the sweep changes, the slots don't.
+        if (found.b.slot < found.a.slot) {
+            BodyID tmp = found.a;
+            found.a = found.b;
+            found.b = tmp;
+            overlap.normal = -overlap.normal;
+        }
+
+        Contact *contact = insert_contact(&contacts, found.a, found.b);
+        Contact *previous = lookup_contact(&old_contacts, found.a, found.b);
+        // A contact that turned around starts over.
+        if (previous && dot(previous->normal, overlap.normal) > 0.95f) {
+            contact->normal_impulse = previous->normal_impulse;
+            contact->tangent_impulse = previous->tangent_impulse;
+        }
+        contact->normal = overlap.normal;
+        contact->depth = overlap.depth;
+        contact->body_a = get(found.a);
+        contact->body_b = get(found.b);
+        active.append(contact);
+    }
+    solve_contacts(this, delta);
 }
-#endif
+//
+// Queries
+//
+
+void World::moved() {
+    grid_is_stale = true;
+}
+
+// The proxies are added in the same order as the
+// bodies, so a proxy is the index of its body.
+static void update_query_grid(World *world) {
+    if (!world->grid_is_stale) return;
+    Grid *grid = &world->grid;
+    grid->clear();
+    for (u32 i = 0; i < world->bodies.length; i++) {
+        Body *body = world->bodies + i;
+        grid->add(calculate_aabb(body), body->layer);
+    }
+    grid->build();
+    world->grid_is_stale = false;
+}
+
+static RayHit to_ray_hit(World *world, ProxyID proxy, Vec2 from, Vec2 to,
+                         Impact impact) {
+    RayHit hit = {};
+    hit.body = world->owners[proxy];
+    hit.time = impact.time;
+    hit.point = from + (to - from) * impact.time;
+    hit.normal = impact.normal;
+    hit.is_valid = true;
+    return hit;
+}
+
+RayHit World::raycast(Vec2 from, Vec2 to, Layer layer) {
+    update_query_grid(this);
+    RayHit hit = {};
+    grid.raycast(from, to, layer, [&](ProxyID proxy, f32 max_time) {
+        Impact impact = Physics::raycast(bodies + proxy, from, to);
+        if (!impact || impact.time > max_time) return max_time;
+        hit = to_ray_hit(this, proxy, from, to, impact);
+        return impact.time;
+    });
+    return hit;
 }
 
+void World::raycast(u32 num_rays, Ray *rays, RayHit *hits) {
+    update_query_grid(this);
+    for (u32 i = 0; i < num_rays; i++)
+        hits[i] = raycast(rays[i].from, rays[i].to, rays[i].layer);
+}
+
+void World::query_segment(Vec2 from, Vec2 to, Layer layer,
+                          List<RayHit> *result) {
+    update_query_grid(this);
+    grid.raycast(from, to, layer, [&](ProxyID proxy, f32 max_time) {
+        Impact impact = Physics::raycast(bodies + proxy, from, to);
+        if (impact)
+            result->append(to_ray_hit(this, proxy, from, to, impact));
+        return max_time;
+    });
+}
 
+void World::query_aabb(AABB aabb, Layer layer, List<BodyID> *result) {
+    update_query_grid(this);
+    found.clear();
+    grid.query(aabb, layer, &found);
+    for (u32 i = 0; i < found.length; i++)
+        result->append(owners[found[i]]);
+}
+
+void World::query_radius(Vec2 center, f32 radius, Layer layer,
+                         List<BodyID> *result) {
+    update_query_grid(this);
+    found.clear();
+    grid.query_radius(center, radius, layer, &found);
+    for (u32 i = 0; i < found.length; i++) {
+        ProxyID proxy = found[i];
+        if (overlaps_circle(bodies + proxy, center, radius))
+            result->append(owners[proxy]);
+    }
+}
+
+void World::query_radius(u32 num_queries, RadiusQuery *queries,
+                         List<BodyID> *result) {
+    update_query_grid(this);
+    for (u32 i = 0; i < num_queries; i++) {
+        RadiusQuery *query = queries + i;
+        query->first = result->length;
+        query_radius(query->center, query->radius, query->layer, result);
+        query->count = result->length - query->first;
+    }
+}
+}
@@ -19,11 +19,19 @@ using Util::List;
 typedef u32 Layer;
 typedef u32 ShapeID;
 
+struct AABB {
+    Vec2 min, max;
+};
+
 struct Shape {
 	ShapeID id;
 	Vec2 center;
 	List<Vec2> normals;
 	List<Vec2> points;
+
+	// Bounds of the points, relative to the center.
+	AABB aabb;
+	f32 radius;
 };
 
 struct Body;
@@ -39,6 +47,28 @@ struct Overlap {
     }
 };
 
+// Shapes with more points than this are never cached.
+const u32 MAX_CACHED_POINTS = 16;
+
+// The shape of a body after it has been scaled, offset and
+// rotated. The position is left out, so moving the body
+// doesn't make the cache stale.
+struct BodyCache {
+	// What the cache was built from.
+	ShapeID shape;
+	f32 rotation;
+	Vec2 scale;
+	Vec2 offset;
+	bool dirty;
+
+	// Bounds of the points, relative to the position.
+	AABB aabb;
+	u32 num_points;
+	u32 num_axes;
+	Vec2 points[MAX_CACHED_POINTS];
+	Vec2 axes[MAX_CACHED_POINTS];
+};
+
 struct Body {
 	ShapeID shape;
 	Layer layer;
@@ -59,12 +89,277 @@ struct Body {
 	f32 inverse_mass;
 	f32 damping;
 	f32 bounce;
+	f32 friction;
+
+	// Triggers report overlaps but are never solved.
+	bool trigger;
+	// Swept in a world, so it can't pass through things.
+	bool continuous;
+
+	// Optional, owned by whoever set it.
+	BodyCache *cache;
 };
 
 struct Limit {
     f32 lower, upper;
 };
 
+struct BodyPair {
+    Body *a, *b;
+};
+
+struct Impact {
+    // How far along the motion the bodies first touch,
+    // from 0 to 1.
+    f32 time;
+    Vec2 normal;
+    bool is_valid;
+
+    operator bool() const {
+        return is_valid;
+    }
+};
+
+//
+// Broadphase
+//
+
+typedef u32 ProxyID;
+
+struct Proxy {
+    AABB aabb;
+    Layer layer;
+    void *user;
+    // The cells covered, inclusive.
+    s32 min_x, min_y;
+    s32 max_x, max_y;
+    // The last raycast that saw this proxy.
+    u32 mark;
+};
+
+// A proxy placed in one of the cells it covers.
+struct GridEntry {
+    ProxyID proxy;
+    s32 x, y;
+};
+
+struct Pair {
+    ProxyID a, b;
+};
+
+// Called for every proxy the ray passes through the box of, the
+// returned time is how far along the ray to keep looking. Return
+// "max_time" to see everything, or the time of a hit to only find
+// the closest thing.
+typedef Function<f32(ProxyID proxy, f32 max_time)> RaycastCallback;
+
+struct Grid {
+    f32 cell_size;
+    f32 inverse_cell_size;
+    u32 num_buckets;
+    // Where each bucket starts in "entries", the
+    // bucket after it says where it ends.
+    u32 *bucket_start;
+    List<Proxy> proxies;
+    List<GridEntry> entries;
+    bool built;
+    u32 mark;
+
+    void clear();
+    ProxyID add(AABB aabb, Layer layer, void *user = nullptr);
+    void build();
+    void find_pairs(List<Pair> *pairs);
+    void query(AABB aabb, Layer layer, List<ProxyID> *result);
+    void query_radius(Vec2 center, f32 radius, Layer layer, List<ProxyID> *result);
+    void query_segment(Vec2 from, Vec2 to, Layer layer, List<ProxyID> *result);
+    void raycast(Vec2 from, Vec2 to, Layer layer, RaycastCallback callback);
+};
+
+// A node in the tree, the leaves are the proxies.
+struct TreeNode {
+    // Larger than what was added for leaves, so small
+    // moves don't change the tree.
+    AABB aabb;
+    // All the layers below this node.
+    Layer layer;
+    void *user;
+    // The next free node if this one isn't used.
+    s32 parent;
+    s32 left, right;
+    // 0 for leaves, -1 when free.
+    s32 height;
+};
+
+struct Tree {
+    static const s32 NONE = -1;
+
+    f32 margin;
+    s32 root;
+    s32 free;
+    u32 num_leaves;
+    List<TreeNode> nodes;
+    List<s32> stack;
+
+    ProxyID insert(AABB aabb, Layer layer, void *user = nullptr);
+    void remove(ProxyID proxy);
+    bool move(ProxyID proxy, AABB aabb, Vec2 motion = V2(0, 0));
+    void rebuild();
+    s32 height();
+
+    void find_pairs(List<Pair> *pairs);
+    void query(AABB aabb, Layer layer, List<ProxyID> *result);
+    void raycast(Vec2 from, Vec2 to, Layer layer, RaycastCallback callback);
+};
+
+//
+// World
+//
+
+///* BodyID
+// A handle to a body owned by a world, it stays
+// valid until the body is removed.
+struct BodyID {
+    s32 slot;
+    u32 gen;
+
+    bool operator==(const BodyID &other) const {
+        return slot == other.slot && gen == other.gen;
+    }
+};
+
+// Called with the body that owns the callback first,
+// returning true means the overlap was handled and
+// it shouldn't be solved.
+typedef Function<bool(Body *, Body *, Overlap)> OverlapCallback;
+
+struct BodySlot {
+    u32 gen;
+    // The index into "bodies" when in use, otherwise
+    // the next free slot.
+    s32 index;
+    OverlapCallback overlap;
+};
+
+// The extent of a body, bodies are swept along x.
+struct SweepLimit {
+    f32 lower, upper;
+    f32 bottom, top;
+    Layer layer;
+    BodyID owner;
+};
+
+struct WorldOverlap {
+    BodyID a, b;
+    Overlap overlap;
+    // If the overlap should be handed to the solver.
+    bool solve;
+};
+
+struct Ray {
+    Vec2 from, to;
+    Layer layer;
+};
+
+struct RayHit {
+    BodyID body;
+    // How far along the ray, from 0 to 1.
+    f32 time;
+    Vec2 point;
+    Vec2 normal;
+    bool is_valid;
+
+    operator bool() const {
+        return is_valid;
+    }
+};
+
+// The bodies found are "count" bodies from "first" in
+// the result list.
+struct RadiusQuery {
+    Vec2 center;
+    f32 radius;
+    Layer layer;
+    u32 first, count;
+};
+
+// A touching pair of bodies, kept between the steps so the
+// impulses can be reused as a starting guess.
+struct Contact {
+    BodyID a, b;
+    Vec2 normal; // Points from a to b.
+    f32 depth;
+    f32 normal_impulse;
+    f32 tangent_impulse;
+
+    // Only valid during the step.
+    Body *body_a, *body_b;
+    f32 mass;
+    f32 friction;
+    f32 target_velocity;
+};
+
+// Open addressing on the pair of bodies.
+struct ContactTable {
+    u32 capacity;
+    u32 length;
+    Contact *contacts;
+    bool *used;
+};
+
+struct World {
+    static const s32 NONE = -1;
+
+    s32 capacity;
+    s32 free;
+    BodySlot *slots;
+
+    // One per slot, so they don't move with the bodies.
+    BodyCache *caches;
+
+    // Packed, so integrating is one pass over memory.
+    List<Body> bodies;
+    List<BodyID> owners;
+
+    // Kept sorted between steps, so sorting them
+    // again is close to linear.
+    List<SweepLimit> limits;
+    // Where the bodies were before the step.
+    List<Vec2> previous;
+    List<BodyPair> pairs;
+    List<Overlap> results;
+    List<WorldOverlap> overlaps;
+
+    // The solver, 0 iterations solves each overlap
+    // once on its own.
+    u32 iterations;
+    bool warm_start;
+    ContactTable contacts;
+    ContactTable old_contacts;
+    List<Contact *> active;
+    List<Vec2> velocities;
+
+    // For the queries, rebuilt when they are used
+    // if the bodies might have moved.
+    Grid grid;
+    bool grid_is_stale;
+    List<ProxyID> found;
+
+    BodyID add(Body body, OverlapCallback overlap = nullptr);
+    void remove(BodyID id);
+    Body *get(BodyID id);
+    bool valid(BodyID id);
+
+    void step(f32 delta);
+
+    RayHit raycast(Vec2 from, Vec2 to, Layer layer = 0xFFFFFFFF);
+    void raycast(u32 num_rays, Ray *rays, RayHit *hits);
+    void query_segment(Vec2 from, Vec2 to, Layer layer, List<RayHit> *result);
+    void query_aabb(AABB aabb, Layer layer, List<BodyID> *result);
+    void query_radius(Vec2 center, f32 radius, Layer layer, List<BodyID> *result);
+    void query_radius(u32 num_queries, RadiusQuery *queries, List<BodyID> *result);
+    void moved();
+};
+
 List<Shape> global_shape_list;
 
 // 
@@ -121,6 +416,10 @@ ShapeID add_shape(List<Vec2> points);
 //    <tr><td>f32</td><td>inverse_mass</td><td>The inverse mass of the virtual body, 0 means infinet mass and the object won't ever move.</td>
 //    <tr><td>f32</td><td>damping</td><td>How fast the object should lose it's velocity.</td>
 //    <tr><td>f32</td><td>bounce</td><td>When solving a collison, this decides how elastic the collison should be.</td>
+//    <tr><td>f32</td><td>friction</td><td>How much the body resists sliding along other bodies in a world, 0.2 by default.</td>
+//    <tr><td>bool</td><td>trigger</td><td>If the body should only report overlaps in a world, and never be pushed around.</td>
+//    <tr><td>bool</td><td>continuous</td><td>If the body moves fast, a world sweeps it along its motion so it can't pass through other bodies.</td>
+//    <tr><td>BodyCache *</td><td>cache</td><td>Optional storage for the transformed shape, see "attach_cache".</td>
 // </table>
 
 ///* 
@@ -134,12 +433,201 @@ Body create_body(ShapeID shape_id, f32 mass = 1.0f, u32 layer=0xFFFFFFFF,
 // Make sure the body is centerd to where the shape thinks the center is.
 void center_body(Body *body);
 
+///*
+// Gives the body somewhere to store its transformed points and
+// normals, so they are only calculated when the rotation, scale
+// or offset changes and not for every check. The cache has to
+// outlive the body, bodies in a world get one automatically.
+void attach_cache(Body *body, BodyCache *cache);
+
+///*
+// Updates the cache if the body has been changed since it was
+// built. Set "dirty" on the cache to force an update.
+void refresh_cache(Body *body);
+
 ///*
 // Check if the two bodies overlap, if they
 // do a overlap object which evalutes to true is
 // returned, with a normal pointing towards "body_a".
+// Bodies that are far apart are ruled out by their
+// bounding circles, or boxes if neither is rotated,
+// before the SAT-test is run.
 Overlap check_overlap(Body *body_a, Body *body_b);
 
+///*
+// Checks a whole batch of pairs, the result for "pairs[i]" is
+// written to "result[i]" and is the same as "check_overlap"
+// would give. Bodies with caches are checked against four axes
+// at a time using SSE, the others fall back to "check_overlap".
+void check_overlaps(u32 num_pairs, BodyPair *pairs, Overlap *result);
+
+
+///* AABB
+// An axis aligned bounding box, it is loose and cheap to
+// check, so it is used to rule out bodies that are far
+// away from each other before the real check is done.
+
+///*
+// Calculates the AABB of the body in world space, the
+// rotation, scale and offset are all taken into account.
+AABB calculate_aabb(Body *body);
+
+///*
+// Returns true if the two boxes overlap or touch.
+bool overlaps(AABB a, AABB b);
+
+///* Impact
+// Describes when two moving bodies first touch.
+// <table class="member-table">
+//    <tr><th width="150">Type</th><th width="50">Name</th><th>Description</th></tr>
+//    <tr><td>f32</td><td>time</td><td>The fraction of the motion when they touch, 0 if they already overlap.</td>
+//    <tr><td>Vec2</td><td>normal</td><td>The axis they hit along, pointing the same way as the normal of an overlap.</td>
+//    <tr><td>bool</td><td>is_valid</td><td>If they hit at all, this is what is returned when the struct is cast to a bool.</td>
+// </table>
+
+///*
+// The box covering the body, along the whole motion.
+AABB swept_aabb(Body *body, Vec2 motion);
+
+///*
+// Finds when two bodies moving in straight lines first touch,
+// the bodies are at their start positions and move "motion_a"
+// and "motion_b" during the time step. Since bodies don't spin
+// this is exact, the SAT-axes are swept instead of stepping
+// the bodies forward. Fast bodies can use this to not pass
+// through thin ones.
+Impact time_of_impact(Body *body_a, Vec2 motion_a, Body *body_b, Vec2 motion_b);
+
+///*
+// Where the segment from "from" to "to" first enters the body,
+// the time is how far along the segment it is and the normal
+// is the side it hit. A segment starting inside hits at time 0.
+// Layers are not checked.
+Impact raycast(Body *body, Vec2 from, Vec2 to);
+
+///*
+// Returns true if the circle overlaps the body.
+bool overlaps_circle(Body *body, Vec2 center, f32 radius);
+
+///* Grid
+// A uniform grid used as a broadphase. Everything that
+// should be checked is added as a proxy with an AABB, a
+// layer and a user pointer, each frame. The cells are
+// hashed into buckets so the grid doesn't have any bounds,
+// but it works best if the cells are about as large as
+// the average body.
+//
+// Pairs and queries only report candidates, a proxy pair
+// is returned if the boxes overlap and the layers share
+// a bit. The narrowphase, "check_overlap", still has to be
+// run on them. Every pair is only reported once.
+// <table class="member-table">
+//    <tr><th width="150">Type</th><th width="50">Name</th><th>Description</th></tr>
+//    <tr><td>void</td><td>clear()</td><td>Removes all proxies, call this before adding the new frames proxies.</td>
+//    <tr><td>ProxyID</td><td>add(aabb, layer, user)</td><td>Adds a new proxy, the id is the index into "proxies".</td>
+//    <tr><td>void</td><td>build()</td><td>Sorts the proxies into the cells, has to be called before the pairs or queries are used.</td>
+//    <tr><td>void</td><td>find_pairs(pairs)</td><td>Appends all overlapping pairs of proxies to the list.</td>
+//    <tr><td>void</td><td>query(aabb, layer, result)</td><td>Appends all proxies that overlap the box to the list.</td>
+//    <tr><td>void</td><td>query_radius(center, radius, layer, result)</td><td>Appends all proxies whose box is within radius of the center.</td>
+//    <tr><td>void</td><td>query_segment(from, to, layer, result)</td><td>Appends all proxies whose box the segment passes through, in about the order they are passed.</td>
+//    <tr><td>void</td><td>raycast(from, to, layer, callback)</td><td>Walks the cells along the segment and calls the callback for each proxy, stopping when the callback says there's nothing closer.</td>
+// </table>
+
+///*
+// Creates a new grid, the number of buckets is rounded up to
+// a power of two.
+Grid create_grid(f32 cell_size, u32 num_buckets = 1024);
+
+///*
+// Frees the memory held by the grid.
+void destroy_grid(Grid *grid);
+
+///* Tree
+// A dynamic bounding volume tree, a broadphase that doesn't
+// care how large the things in it are. Unlike the grid the
+// proxies are kept between frames and moved when the things
+// they stand for move. The boxes in the tree are made larger
+// by "margin", so small moves are free and larger moves only
+// take the proxy out and put it back in.
+//
+// The tree is kept balanced with rotations as proxies are
+// inserted and removed, "rebuild" builds a new one from scratch
+// which gives a better tree if things have moved around a lot.
+// Pairs and queries are candidates found with the larger boxes.
+// <table class="member-table">
+//    <tr><th width="150">Type</th><th width="50">Name</th><th>Description</th></tr>
+//    <tr><td>ProxyID</td><td>insert(aabb, layer, user)</td><td>Adds a new proxy, the id stays the same until it's removed.</td>
+//    <tr><td>void</td><td>remove(proxy)</td><td>Takes the proxy out of the tree.</td>
+//    <tr><td>bool</td><td>move(proxy, aabb, motion)</td><td>Updates the box of a proxy, the motion is how far it's expected to move next, returns true if the tree changed.</td>
+//    <tr><td>void</td><td>rebuild()</td><td>Builds the tree again from the proxies, call it every now and then.</td>
+//    <tr><td>s32</td><td>height()</td><td>How deep the tree is, about log2 of the number of proxies if it's balanced.</td>
+//    <tr><td>void</td><td>find_pairs(pairs)</td><td>Appends all overlapping pairs of proxies to the list.</td>
+//    <tr><td>void</td><td>query(aabb, layer, result)</td><td>Appends all proxies that overlap the box to the list.</td>
+//    <tr><td>void</td><td>raycast(from, to, layer, callback)</td><td>Calls the callback for each proxy the segment passes through, like the grid.</td>
+// </table>
+
+///*
+// Creates an empty tree, the margin is added to every side of the
+// boxes that are inserted.
+Tree create_tree(f32 margin = 0.5f, u32 capacity = 64);
+
+///*
+// Frees the memory held by the tree.
+void destroy_tree(Tree *tree);
+
+///* World
+// A world owns bodies and simulates them, every step the
+// bodies are integrated, checked against each other and
+// the overlaps are solved. Bodies are referenced by a BodyID,
+// pointers to them are only valid until a body is added or
+// removed.
+//
+// Finding the pairs is done by sorting the bodies along
+// the x-axis and sweeping over them, the order is kept
+// between the steps so it is cheap to sort again.
+// <table class="member-table">
+//    <tr><th width="150">Type</th><th width="50">Name</th><th>Description</th></tr>
+//    <tr><td>BodyID</td><td>add(body, overlap)</td><td>Copies the body into the world, the optional callback is called when it overlaps something.</td>
+//    <tr><td>void</td><td>remove(id)</td><td>Removes the body from the world.</td>
+//    <tr><td>Body *</td><td>get(id)</td><td>Returns the body or nullptr if it has been removed.</td>
+//    <tr><td>bool</td><td>valid(id)</td><td>If the id still points to a body.</td>
+//    <tr><td>void</td><td>step(delta)</td><td>Simulates the world forward by delta.</td>
+//    <tr><td>RayHit</td><td>raycast(from, to, layer)</td><td>The closest body hit along the segment.</td>
+//    <tr><td>void</td><td>raycast(num_rays, rays, hits)</td><td>The closest hit for each of the rays.</td>
+//    <tr><td>void</td><td>query_segment(from, to, layer, result)</td><td>Appends every body hit along the segment.</td>
+//    <tr><td>void</td><td>query_aabb(aabb, layer, result)</td><td>Appends every body whose bounds overlap the box.</td>
+//    <tr><td>void</td><td>query_radius(center, radius, layer, result)</td><td>Appends every body that overlaps the circle.</td>
+//    <tr><td>void</td><td>query_radius(num_queries, queries, result)</td><td>Runs many radius queries, "first" and "count" on each says where its bodies are.</td>
+//    <tr><td>void</td><td>moved()</td><td>Call this after moving bodies by hand, so the queries see the new positions.</td>
+// </table>
+//
+// An overlap is solved unless one of the bodies is a trigger,
+// or if one of the callbacks return true. Two bodies with
+// infinite mass are never checked against each other.
+// Bodies marked as "continuous" are swept from where they
+// were to where they end up, and moved back to where they
+// first hit something.
+//
+// The overlaps are solved together with sequential impulses.
+// Every contact is visited "iterations" times, 8 by default,
+// and the impulses are remembered between steps and used as
+// the starting point when "warm_start" is set. Friction comes
+// from the "friction" of the two bodies. More iterations give
+// stiffer stacks, but cost more.
+//
+// The queries use a grid over the bodies, it is built by
+// the first query after a step, so asking many questions
+// in a frame only pays for it once.
+
+///*
+// Creates a new world which can hold at most "capacity" bodies,
+// the cell size is used for the queries and works best if it's
+// about the size of a body.
+World create_world(s32 capacity = 256, f32 cell_size = 2.0f);
+
+///*
+// Frees the world and all the bodies in it.
+void destroy_world(World *world);
 
 ///*
 // Move the body forward by for delta-time, and solves the
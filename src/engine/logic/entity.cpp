@@ -0,0 +1,275 @@
+#include <string.h>
+#include <utility>
+
+namespace Logic {
+
+bool init_entities() {
+    entity_system.slots = Util::create_list<EntitySlot>(256);
+    entity_system.free = EntitySystem::NONE;
+    entity_system.num_alive = 0;
+    entity_system.num_types = 0;
+    for (s32 i = 0; i < At::COUNT; i++) {
+        At at = (At) i;
+        entity_system.num_systems[i] = 0;
+        add_callback(at, [at](f32 delta) { run_systems(at, delta); },
+                     0, FOREVER);
+    }
+    return true;
+}
+
+EntityID create_entity() {
+    EntitySystem *system = &entity_system;
+    u32 index = system->free;
+    if (index == EntitySystem::NONE) {
+        index = system->slots.length;
+        system->slots.append({0, EntitySystem::NONE, 0, false});
+    } else {
+        system->free = system->slots[index].next_free;
+    }
+    EntitySlot *slot = system->slots + index;
+    slot->gen++;
+    slot->next_free = EntitySystem::NONE;
+    slot->components = 0;
+    slot->alive = true;
+    system->num_alive++;
+    return {index, slot->gen};
+}
+
+bool is_alive(EntityID id) {
+    EntitySystem *system = &entity_system;
+    if (id.index >= system->slots.length) return false;
+    EntitySlot *slot = system->slots + id.index;
+    return slot->alive && slot->gen == id.gen;
+}
+
+u32 num_entities() {
+    return entity_system.num_alive;
+}
+
+static void *find_in_pool(ComponentPool *pool, u32 index) {
+    if (index >= pool->sparse_length) return nullptr;
+    u32 dense = pool->sparse[index];
+    if (dense == ComponentPool::NONE) return nullptr;
+    return pool->data + dense * pool->size;
+}
+
+static void *insert_in_pool(ComponentPool *pool, EntityID id) {
+    if (id.index >= pool->sparse_length) {
+        u32 length = MAX(pool->sparse_length * 2, 64u);
+        while (length <= id.index) length *= 2;
+        pool->sparse = Util::resize_memory(pool->sparse, length);
+        for (u32 i = pool->sparse_length; i < length; i++)
+            pool->sparse[i] = ComponentPool::NONE;
+        pool->sparse_length = length;
+    }
+    u32 dense = pool->sparse[id.index];
+    if (dense != ComponentPool::NONE)
+        return pool->data + dense * pool->size;
+
+    if (pool->length == pool->capacity) {
+        pool->capacity = MAX(pool->capacity * 2, 64u);
+        pool->data = Util::resize_memory(pool->data, pool->capacity * pool->size);
+        pool->owners = Util::resize_memory(pool->owners, pool->capacity);
+    }
+    dense = pool->length++;
+    pool->sparse[id.index] = dense;
+    pool->owners[dense] = id;
+    return pool->data + dense * pool->size;
+}
+
+// The last component is moved into the hole.
+static void remove_from_pool(ComponentPool *pool, u32 index) {
+    if (index >= pool->sparse_length) return;
+    u32 dense = pool->sparse[index];
+    if (dense == ComponentPool::NONE) return;
+    u32 last = --pool->length;
+    if (dense != last) {
+        memcpy(pool->data + dense * pool->size,
+               pool->data + last * pool->size, pool->size);
+        pool->owners[dense] = pool->owners[last];
+        pool->sparse[pool->owners[dense].index] = dense;
+    }
+    pool->sparse[index] = ComponentPool::NONE;
+}
+
+void destroy_entity(EntityID id) {
+    if (!is_alive(id)) {
+        CHECK(false, "Trying to destroy a dead entity");
+        return;
+    }
+    EntitySystem *system = &entity_system;
+    EntitySlot *slot = system->slots + id.index;
+    for (u32 type = 0; type < system->num_types; type++) {
+        if (slot->components & ((ComponentMask) 1 << type))
+            remove_from_pool(system->pools + type, id.index);
+    }
+    slot->components = 0;
+    slot->alive = false;
+    slot->next_free = system->free;
+    system->free = id.index;
+    system->num_alive--;
+}
+
+static u32 add_component_type(u32 size) {
+    EntitySystem *system = &entity_system;
+    u32 type = system->num_types.fetch_add(1);
+    ASSERT(type < MAX_COMPONENT_TYPES, "Too many component types");
+    system->pools[type] = {};
+    system->pools[type].size = size;
+    return type;
+}
+
+template <typename T>
+u32 component_type() {
+    // The static is only set up once, even if two systems
+    // use the type for the first time at the same time.
+    static const u32 type = add_component_type(sizeof(T));
+    return type;
+}
+
+template <typename... Ts>
+ComponentMask component_mask() {
+    return (((ComponentMask) 1 << component_type<Ts>()) | ... | 0);
+}
+
+template <typename T>
+T *add_component(EntityID id, T component) {
+    if (!is_alive(id)) {
+        CHECK(false, "Adding a component to a dead entity");
+        return nullptr;
+    }
+    u32 type = component_type<T>();
+    T *result = (T *) insert_in_pool(entity_system.pools + type, id);
+    *result = component;
+    entity_system.slots[id.index].components |= (ComponentMask) 1 << type;
+    return result;
+}
+
+template <typename T>
+void remove_component(EntityID id) {
+    if (!is_alive(id)) return;
+    u32 type = component_type<T>();
+    remove_from_pool(entity_system.pools + type, id.index);
+    entity_system.slots[id.index].components &= ~((ComponentMask) 1 << type);
+}
+
+template <typename T>
+T *get_component(EntityID id) {
+    if (!is_alive(id)) return nullptr;
+    return (T *) find_in_pool(entity_system.pools + component_type<T>(),
+                              id.index);
+}
+
+template <typename... Ts>
+bool has_components(EntityID id) {
+    if (!is_alive(id)) return false;
+    ComponentMask mask = component_mask<Ts...>();
+    return (entity_system.slots[id.index].components & mask) == mask;
+}
+
+template <typename T>
+u32 num_components() {
+    return entity_system.pools[component_type<T>()].length;
+}
+
+// Where the entity's component is in the pool, or NONE.
+static u32 dense_index(ComponentPool *pool, u32 index) {
+    if (index >= pool->sparse_length) return ComponentPool::NONE;
+    return pool->sparse[index];
+}
+
+// The indices pair each type with its pool.
+template <typename... Ts, typename F, size_t... I>
+static void for_each_indexed(F f, std::index_sequence<I...>) {
+    const u32 NUM_TYPES = sizeof...(Ts);
+    EntitySystem *system = &entity_system;
+    ComponentPool *pools[] = {system->pools + component_type<Ts>()...};
+
+    // Walk the smallest pool, and look up the others.
+    u32 smallest = 0;
+    for (u32 i = 1; i < NUM_TYPES; i++)
+        if (pools[i]->length < pools[smallest]->length)
+            smallest = i;
+
+    ComponentPool *walked = pools[smallest];
+    for (u32 i = 0; i < walked->length; i++) {
+        EntityID id = walked->owners[i];
+        u32 dense[NUM_TYPES];
+        bool has_all = true;
+        for (u32 t = 0; t < NUM_TYPES; t++) {
+            dense[t] = t == smallest ? i : dense_index(pools[t], id.index);
+            has_all &= dense[t] != ComponentPool::NONE;
+        }
+        if (!has_all) continue;
+        f(id, *(Ts *) (pools[I]->data + dense[I] * sizeof(Ts))...);
+    }
+}
+
+template <typename... Ts, typename F>
+void for_each(F f) {
+    for_each_indexed<Ts...>(f, std::index_sequence_for<Ts...>());
+}
+
+void add_system(At at, Function<void(f32)> update, ComponentMask reads,
+                ComponentMask writes) {
+    EntitySystem *system = &entity_system;
+    u32 count = system->num_systems[at];
+    ASSERT(count < EntitySystem::MAX_SYSTEMS, "Too many systems");
+
+    // Joins the last batch, unless it touches
+    // something the batch writes or writes to
+    // something the batch reads.
+    u32 batch = 0;
+    if (count) {
+        batch = system->systems[at][count - 1].batch;
+        for (s32 i = count - 1; i >= 0; i--) {
+            System *other = system->systems[at] + i;
+            if (other->batch != batch) break;
+            if ((other->writes & (reads | writes)) || (writes & other->reads)) {
+                batch++;
+                break;
+            }
+        }
+    }
+    system->systems[at][count] = {update, reads, writes, batch};
+    system->num_systems[at]++;
+}
+
+struct SystemRun {
+    System *system;
+    f32 delta;
+};
+
+static void run_system(void *data) {
+    SystemRun *run = (SystemRun *) data;
+    run->system->update(run->delta);
+}
+
+void run_systems(At at, f32 delta) {
+    EntitySystem *system = &entity_system;
+    System *systems = system->systems[at];
+    u32 count = system->num_systems[at];
+    SystemRun runs[EntitySystem::MAX_SYSTEMS];
+    for (u32 first = 0; first < count;) {
+        u32 last = first + 1;
+        while (last < count && systems[last].batch == systems[first].batch)
+            last++;
+
+        // The systems in a batch don't touch each others
+        // components, so they can all go at once.
+        if (last - first == 1 || Jobs::num_threads() == 1) {
+            for (u32 i = first; i < last; i++)
+                systems[i].update(delta);
+        } else {
+            Jobs::Counter counter = {};
+            for (u32 i = first; i < last; i++) {
+                runs[i] = {systems + i, delta};
+                Jobs::run(run_system, runs + i, &counter);
+            }
+            Jobs::wait(&counter);
+        }
+        first = last;
+    }
+}
+
+}  // namespace Logic
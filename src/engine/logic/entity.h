@@ -1,23 +1,165 @@
+///# Entities
+// Entities are ids that components are attached to, the
+// components live packed in one array per type so walking
+// over them is a linear pass over memory. Each array is a
+// sparse set, the entity index looks up where the component
+// is and the component knows which entity it belongs to, so
+// adding and removing is constant time.
+//
+// Components are moved around with memcpy, so they should
+// be plain data without constructors or destructors that
+// do anything.
+
 namespace Logic {
 
-    struct BodyID;
+using Util::List;
+
+///* EntityID
+// A handle to an entity, it stops being valid when the
+// entity is destroyed, even if the slot is reused.
+struct EntityID {
+    u32 index;
+    u32 gen;
 
-struct Body {
-    
+    bool operator==(const EntityID &other) const {
+        return index == other.index && gen == other.gen;
+    }
 };
 
-struct PhysicsEngine {
-    struct Limit {
-        f32 min, max;
+// Each component type gets a bit.
+typedef u64 ComponentMask;
+const u32 MAX_COMPONENT_TYPES = 64;
 
+// One sparse set, the type is forgotten so all of
+// them can be stored together.
+struct ComponentPool {
+    static const u32 NONE = 0xFFFFFFFF;
 
-        bool operator< (Limit &other) const {
-            return min < other.min;
-        }
-    };
+    u32 size;
+    u32 length;
+    u32 capacity;
+    u8 *data;
+    // The entity each component belongs to.
+    EntityID *owners;
+    // Entity index to component index.
+    u32 *sparse;
+    u32 sparse_length;
+};
 
-    u32 num_bodies;
-    Body *bodies;
+struct EntitySlot {
+    u32 gen;
+    // The next free slot, when not in use.
+    u32 next_free;
+    ComponentMask components;
+    bool alive;
 };
 
+// Systems that share a batch don't write to anything the
+// others read or write, so they could run at the same time.
+struct System {
+    Function<void(f32)> update;
+    ComponentMask reads;
+    ComponentMask writes;
+    u32 batch;
 };
+
+struct EntitySystem {
+    static const u32 NONE = 0xFFFFFFFF;
+    static const u32 MAX_SYSTEMS = 64;
+
+    List<EntitySlot> slots;
+    u32 free;
+    u32 num_alive;
+
+    // Types are numbered when they're first used, which can
+    // be in a system on any thread.
+    std::atomic<u32> num_types;
+    ComponentPool pools[MAX_COMPONENT_TYPES];
+
+    u32 num_systems[At::COUNT];
+    System systems[At::COUNT][MAX_SYSTEMS];
+} entity_system = {};
+
+// Sets up the storage and hooks the systems into the
+// logic phases.
+bool init_entities();
+
+///*
+// Makes a new entity without any components.
+EntityID create_entity();
+
+///*
+// Removes the entity and all of its components.
+void destroy_entity(EntityID id);
+
+///*
+// If the entity hasn't been destroyed.
+bool is_alive(EntityID id);
+
+///*
+// How many entities there are.
+u32 num_entities();
+
+///*
+// The type id of a component, given out the first
+// time it's asked for.
+template <typename T>
+u32 component_type();
+
+///*
+// The bits of the component types, used to say what a
+// system reads and writes.
+template <typename... Ts>
+ComponentMask component_mask();
+
+///*
+// Attaches a component to the entity, replacing the one
+// already there. The pointer is valid until a component
+// of the same type is added or removed.
+template <typename T>
+T *add_component(EntityID id, T component = {});
+
+///*
+// Removes the component from the entity, if it has one.
+template <typename T>
+void remove_component(EntityID id);
+
+///*
+// Returns the component, or nullptr if there isn't one.
+template <typename T>
+T *get_component(EntityID id);
+
+///*
+// If the entity has all of the components.
+template <typename... Ts>
+bool has_components(EntityID id);
+
+///*
+// How many entities have the component.
+template <typename T>
+u32 num_components();
+
+///*
+// Calls "f" with the id and a reference to each of the
+// components, for every entity that has all of them.
+// Components of these types can't be added or removed
+// while walking over them.
+template <typename... Ts, typename F>
+void for_each(F f);
+
+///*
+// Adds a system that is called every frame at "at", with
+// the time since the last frame. "reads" and "writes" say
+// which components it touches, systems that don't write
+// to the same components as others read or write are put
+// in the same batch. The batches are called in the order
+// they are added, but the systems in a batch can run at the
+// same time on different threads, so they shouldn't make
+// or destroy entities or components.
+void add_system(At at, Function<void(f32)> update, ComponentMask reads,
+                ComponentMask writes);
+
+// Calls all the systems for the phase.
+void run_systems(At at, f32 delta);
+
+}  // namespace Logic
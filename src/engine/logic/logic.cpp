@@ -32,11 +32,115 @@ f32 delta() {
     return logic_system.delta;
 }
 
+struct TaskGraph;
+
+// A timer that can run on any thread, and
+// the ones that have to wait for it.
+struct Task {
+    TaskGraph *graph;
+    Timer *timer;
+    s32 num_before;
+    std::atomic<s32> waiting;
+    u32 first_after;
+    u32 num_after;
+};
+
+struct TaskGraph {
+    f32 time;
+    f32 delta;
+    Task *tasks;
+    u32 *after;
+    Jobs::Counter counter;
+};
+
+static void run_task(void *data) {
+    Task *task = (Task *) data;
+    TaskGraph *graph = task->graph;
+    task->timer->call(graph->time, graph->delta);
+    for (u32 i = 0; i < task->num_after; i++) {
+        Task *next = graph->tasks + graph->after[task->first_after + i];
+        if (next->waiting.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            Jobs::run(run_task, next, &graph->counter);
+    }
+}
+
+// Every timer waits for the timers before it that it
+// conflicts with, and is started by the last of them
+// to finish, so the longest chain of conflicts is how
+// long it takes.
+static void run_graph(Timer **timers, u32 count, f32 time, f32 delta) {
+    if (count == 0) return;
+    if (count == 1 || Jobs::num_threads() == 1) {
+        for (u32 i = 0; i < count; i++)
+            timers[i]->call(time, delta);
+        return;
+    }
+
+    TaskGraph graph = {};
+    graph.time = time;
+    graph.delta = delta;
+    graph.tasks = Util::push_memory<Task>(count);
+    u32 num_edges = 0;
+    for (u32 i = 0; i < count; i++) {
+        Task *task = graph.tasks + i;
+        task->graph = &graph;
+        task->timer = timers[i];
+        task->num_before = 0;
+        task->num_after = 0;
+        for (u32 j = 0; j < i; j++) {
+            if (!timers[j]->conflicts(timers[i])) continue;
+            graph.tasks[j].num_after++;
+            task->num_before++;
+            num_edges++;
+        }
+        task->waiting = task->num_before;
+    }
+
+    graph.after = Util::push_memory<u32>(MAX(num_edges, 1u));
+    u32 first = 0;
+    for (u32 i = 0; i < count; i++) {
+        graph.tasks[i].first_after = first;
+        first += graph.tasks[i].num_after;
+        graph.tasks[i].num_after = 0;
+    }
+    for (u32 i = 0; i < count; i++) {
+        for (u32 j = 0; j < i; j++) {
+            if (!timers[j]->conflicts(timers[i])) continue;
+            Task *before = graph.tasks + j;
+            graph.after[before->first_after + before->num_after++] = i;
+        }
+    }
+
+    for (u32 i = 0; i < count; i++)
+        if (graph.tasks[i].num_before == 0)
+            Jobs::run(run_task, graph.tasks + i, &graph.counter);
+    Jobs::wait(&graph.counter);
+
+    Util::pop_memory(graph.after);
+    Util::pop_memory(graph.tasks);
+}
+
 void TimerBucket::update(f32 time, f32 delta) {
+    // Timers added by the callbacks are
+    // first called next frame.
+    Timer *due[NUM_TIMERS];
+    u32 num_due = 0;
+    for (s16 slot = active; slot != NONE; slot = timers[slot].forward)
+        if (timers[slot].due(time))
+            due[num_due++] = timers + slot;
+
+    u32 first = 0;
+    for (u32 i = 0; i < num_due; i++) {
+        if (due[i]->parallel) continue;
+        run_graph(due + first, i - first, time, delta);
+        due[i]->call(time, delta);
+        first = i + 1;
+    }
+    run_graph(due + first, num_due - first, time, delta);
+
     s16 *slot = &active;
     while (*slot != TimerBucket::NONE) {
         Timer *timer = timers + *slot;
-        timer->call(time, delta);
         if (timer->done(time)) {
             s16 forward = timer->forward;
             timer->forward = free;
@@ -66,6 +170,9 @@ LogicID TimerBucket::add_timer(Timer *timer) {
     to->next = timer->next;
     to->spacing = timer->spacing;
     to->callback = timer->callback;
+    to->parallel = timer->parallel;
+    to->reads = timer->reads;
+    to->writes = timer->writes;
     return {At::COUNT, slot, to->gen};
 }
 
@@ -88,7 +195,7 @@ Timer *TimerBucket::get_timer(LogicID id) {
 LogicID add_callback(At at, Callback callback, f32 start, f32 end,
                             f32 spacing) {
     ASSERT(start != FOREVER, "I'm sorry Dave, I can't let you do that.");
-    Timer t = {0, 0, start, start, end, spacing, callback};
+    Timer t = {0, 0, start, start, end, spacing, callback, false, 0, 0};
     LogicID id = logic_system.buckets[at].add_timer(&t);
     id.at = at;
     return id;
@@ -116,6 +223,24 @@ void remove_callback(LogicID id) {
     logic_system.buckets[id.at].remove_timer(id);
 }
 
+ResourceMask add_resource() {
+    // The first bit is RANDOM.
+    u32 bit = ++logic_system.num_resources;
+    ASSERT(bit < 64, "Too many resources");
+    return (ResourceMask) 1 << bit;
+}
+
+void set_access(LogicID id, ResourceMask reads, ResourceMask writes) {
+    Timer *timer = logic_system.buckets[id.at].get_timer(id);
+    if (!timer) {
+        CHECK(false, "Failed to find timer");
+        return;
+    }
+    timer->parallel = true;
+    timer->reads = reads;
+    timer->writes = writes;
+}
+
 void update_callback(LogicID id, Callback callback,
                             f32 start, f32 end, f32 spacing) {
     Timer *timer = logic_system.buckets[id.at].get_timer(id);
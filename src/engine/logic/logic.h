@@ -19,6 +19,12 @@
 // but custom UI elements should go in the "post_draw" for
 // example, and if you depend on anything from the "pre_udate"
 // step, "post_update" is the most suitable.
+//
+// Callbacks are called on the main thread one after the other,
+// unless they say what they touch with "set_access". Those can
+// run on any thread, at the same time as the other callbacks
+// that don't touch the same things, and the callbacks that
+// haven't said anything act like fences between them.
 
 namespace Logic {
 
@@ -42,6 +48,16 @@ enum At {
 // as arguments.
 typedef Function<void(f32, f32, f32)> Callback;
 
+///* ResourceMask
+// One bit for every piece of state a callback reads or
+// writes, new bits are handed out by "add_resource".
+typedef u64 ResourceMask;
+
+///* RANDOM
+// The random number generator, everything that
+// calls "random_*" writes to it.
+const ResourceMask RANDOM = 1;
+
 //* LogicID
 // An ID representing a callback that is being called
 // in the future.
@@ -69,12 +85,30 @@ struct Timer {
     f32 spacing;
     Callback callback;
 
+    // Only timers that have said what they touch
+    // are run off the main thread.
+    bool parallel;
+    ResourceMask reads;
+    ResourceMask writes;
+
     bool done(f32 time) {
+        // Removed timers have "next" set to -1, "end"
+        // is then the same as FOREVER.
+        if (next == -1) return true;
         return start <= time && end <= time && end != FOREVER;
     }
 
+    bool due(f32 time) {
+        return next <= time && next != -1;
+    }
+
+    bool conflicts(Timer *other) {
+        return (writes & (other->reads | other->writes))
+            || (other->writes & reads);
+    }
+
     void call(f32 time, f32 delta) {
-        if (next <= time && next != -1) {
+        if (due(time)) {
             if (end == FOREVER) {
                 callback(delta, time, 0);
             } else if (end == ONCE) {
@@ -110,6 +144,7 @@ struct LogicSystem {
     Callback non_function;
 
     TimerBucket buckets[At::COUNT];
+    u32 num_resources;
 
     f32 time;
     f32 delta;
@@ -163,6 +198,19 @@ void update_callback(LogicID at, Function<void()> callback,
 // Stops a callback from being called, making sure it is never updated again.
 void remove_callback(LogicID id);
 
+///*
+// Returns a new bit to describe some state with, there
+// are 63 of them on top of "RANDOM".
+ResourceMask add_resource();
+
+///*
+// Says what the callback reads and writes, which lets it
+// run on any thread alongside callbacks it doesn't
+// conflict with. A callback that touches nothing shared
+// passes 0 for both. These callbacks can't add or remove
+// callbacks, and shouldn't draw anything.
+void set_access(LogicID id, ResourceMask reads, ResourceMask writes);
+
 ///*
 // Returns the current time.
 f32 now();
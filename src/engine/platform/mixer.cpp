@@ -69,6 +69,8 @@ AudioID push_sound(SoundSource source) {
         u16 source_id =
             audio_struct.free_sources[--audio_struct.num_free_sources];
         source.gen = audio_struct.sources[source_id].gen + 1;
+        // Held until the sound stops.
+        Asset::acquire(source.source);
         audio_struct.sources[source_id] = source;
         unlock_audio();
         return {source.gen, source_id};
@@ -98,8 +100,12 @@ void stop_sound(AudioID id) {
     SoundSource *source = audio_struct.sources + id.slot;
     CHECK(source->gen == id.gen, "Invalid AudioID, the handle is outdated");
     if (source->gen == id.gen) {
-        audio_struct.free_sources[audio_struct.num_free_sources++] = id.slot;
-        source->gain = 0.0;
+        // It might have stopped on its own already.
+        if (source->gain != 0.0) {
+            audio_struct.free_sources[audio_struct.num_free_sources++] = id.slot;
+            source->gain = 0.0;
+            Asset::release(source->source);
+        }
     } else {
         ERR("Invalid removal of AudioID that does not exist");
     }
@@ -166,7 +172,10 @@ void audio_callback(void* userdata, u8* stream, int len) {
         for (u32 source_id = 0; source_id < NUM_SOURCES; source_id++) {
             SoundSource *source = data->sources + source_id;
             if (source->gain == 0.0) continue;
-            Sound *sound = Asset::fetch_sound(source->source);
+            // It starts when it's loaded, waiting for the
+            // disk here would make the sound stutter.
+            const Sound *sound = Asset::try_fetch_sound(source->source);
+            if (!sound) continue;
             source->sample += sound->sample_rate * source->pitch * TIME_STEP;
             u64 index = source->sample;
             if (index >= sound->num_samples) {
@@ -176,6 +185,7 @@ void audio_callback(void* userdata, u8* stream, int len) {
                 } else {
                     data->free_sources[data->num_free_sources++] = source_id;
                     source->gain = 0.0;
+                    Asset::release(source->source);
                     continue;
                 }
             }
@@ -184,11 +194,11 @@ void audio_callback(void* userdata, u8* stream, int len) {
                 f32 left;
                 f32 right;
                 if (sound->bits_per_sample == 16) {
-                    left = S16_TO_F32(sound->samples_16[index * 2 + 0]);
-                    right = S16_TO_F32(sound->samples_16[index * 2 + 1]);
+                    left = S16_TO_F32(sound->samples_16()[index * 2 + 0]);
+                    right = S16_TO_F32(sound->samples_16()[index * 2 + 1]);
                 } else if (sound->bits_per_sample == 32) {
-                    left = sound->samples_32[index * 2 + 0];
-                    right = sound->samples_32[index * 2 + 1];
+                    left = sound->samples_32()[index * 2 + 0];
+                    right = sound->samples_32()[index * 2 + 1];
                 } else {
                     UNREACHABLE;
                 }
@@ -197,9 +207,9 @@ void audio_callback(void* userdata, u8* stream, int len) {
             } else {
                 f32 sample;
                 if (sound->bits_per_sample == 16) {
-                    sample = (f32) sound->samples_16[index] / ((f32) 0xEFFF);
+                    sample = (f32) sound->samples_16()[index] / ((f32) 0xEFFF);
                 } else if (sound->bits_per_sample == 32) {
-                    sample = sound->samples_32[index];
+                    sample = sound->samples_32()[index];
                 } else {
                     UNREACHABLE;
                 }
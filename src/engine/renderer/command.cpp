@@ -1,5 +1,7 @@
 #ifdef OPENGL_RENDERER
 #include "opengl_includes.h"
+#elif defined(NULL_RENDERER)
+// Nothing to include, it doesn't draw.
 #else
 #error "No renderer selected"
 #endif
@@ -9,6 +11,9 @@ namespace Impl {
 #ifdef OPENGL_RENDERER
 #include "opengl_renderer.h"
 #include "opengl_renderer.cpp"
+#elif defined(NULL_RENDERER)
+#include "null_renderer.h"
+#include "null_renderer.cpp"
 #else
 #error "No renderer selected"
 #endif
@@ -57,43 +62,78 @@ void push_point(Vec2 point, Vec4 color, f32 size) {
 
 // TODO(ed): It might be smart to seperate out the rotation
 // logic since it adds unnessecary complexity here.
-void push_sprite(s32 slot, Vec2 position, Vec2 dimension, f32 angle,
-                        Vec2 uv_min, Vec2 uv_dimension,
-                        Vec4 color) {
+//
+// Writes the two triangles of a sprite to |verticies|.
+static void fill_sprite(Vertex *verticies, s32 slot, Vec2 position,
+                        Vec2 dimension, f32 angle, Vec2 uv_min,
+                        Vec2 uv_dimension, Vec4 color) {
     Vec2 inv_dimension = {1.0f / (f32) OPENGL_TEXTURE_WIDTH,
                           1.0f / (f32) OPENGL_TEXTURE_HEIGHT};
-    uv_min = hadamard(uv_min, inv_dimension); 
-	Vec2 uv_max = uv_min + hadamard(uv_dimension, inv_dimension);
+    uv_min = hadamard(uv_min, inv_dimension);
+    Vec2 uv_max = uv_min + hadamard(uv_dimension, inv_dimension);
 
     Vec2 right = angle ? rotate(V2(1, 0), angle) : V2(1, 0);
     Vec2 up = rotate_ccw(right);
     right *= dimension.x * 0.5;
     up *= dimension.y * 0.5;
 
-    struct {
-        Vec2 p;
-        Vec2 uv;
-    } coords[] = {
-        {position - right - up, uv_min},
-        {position + right - up, V2(uv_max.x, uv_min.y)},
-        {position + right + up, uv_max},
-        {position - right + up, V2(uv_min.x, uv_max.y)},
-    };
-
-    Impl::push_triangle(coords[0].p, coords[1].p, coords[2].p,
-                        coords[0].uv, coords[1].uv, coords[2].uv,
-                        color, color, color,
-                        slot);
-    Impl::push_triangle(coords[0].p, coords[2].p, coords[3].p,
-                        coords[0].uv, coords[2].uv, coords[3].uv,
-                        color, color, color,
-                        slot);
+    Vec2 p0 = position - right - up;
+    Vec2 p1 = position + right - up;
+    Vec2 p2 = position + right + up;
+    Vec2 p3 = position - right + up;
+    Vec2 uv1 = V2(uv_max.x, uv_min.y);
+    Vec2 uv3 = V2(uv_min.x, uv_max.y);
+
+    verticies[0] = {p0, uv_min, (f32) slot, color};
+    verticies[1] = {p1, uv1,    (f32) slot, color};
+    verticies[2] = {p2, uv_max, (f32) slot, color};
+
+    verticies[3] = {p0, uv_min, (f32) slot, color};
+    verticies[4] = {p2, uv_max, (f32) slot, color};
+    verticies[5] = {p3, uv3,    (f32) slot, color};
+}
+
+void push_sprite(s32 slot, Vec2 position, Vec2 dimension, f32 angle,
+                        Vec2 uv_min, Vec2 uv_dimension,
+                        Vec4 color) {
+    Vertex verticies[Impl::VERTICIES_PER_SPRITE];
+    fill_sprite(verticies, slot, position, dimension, angle, uv_min,
+                uv_dimension, color);
+    Impl::push_verticies(LEN(verticies), verticies);
+}
+
+SpriteBatch reserve_sprites(u32 num_sprites) {
+    SpriteBatch batch = {};
+    if (num_sprites)
+        batch.verticies = Impl::map_sprites(num_sprites, &batch.num_sprites);
+    return batch;
+}
+
+void write_sprite(SpriteBatch *batch, s32 slot, Vec2 position,
+                  Vec2 dimension, f32 angle, Vec2 uv_min, Vec2 uv_dimension,
+                  Vec4 color) {
+    ASSERT(!batch->full(), "Writing outside of the reserved sprites");
+    Vertex *verticies =
+        batch->verticies + batch->num_written * Impl::VERTICIES_PER_SPRITE;
+    fill_sprite(verticies, slot, position, dimension, angle, uv_min,
+                uv_dimension, color);
+    batch->num_written++;
+}
+
+void submit_sprites(SpriteBatch *batch) {
+    if (batch->num_sprites)
+        Impl::unmap_sprites(batch->num_written);
+    *batch = {};
 }
 
 void push_sprite(Vec2 position, Vec2 dimension, f32 angle,
                         AssetID asset, Vec2 uv_min, Vec2 uv_dimension,
                         Vec4 color) {
-    push_sprite(Asset::fetch_image(asset)->id, position, dimension, angle, uv_min, uv_dimension, color);
+    // The UVs are in the image, which might be a sprite
+    // somewhere in a shared layer.
+    const Asset::Texture *image = Asset::fetch_image(asset);
+    push_sprite(image->id, position, dimension, angle,
+                uv_min + V2(image->x, image->y), uv_dimension, color);
 }
 
 void push_rectangle(Vec2 position, Vec2 dimension, Vec4 color) {
@@ -116,6 +156,8 @@ u32 upload_texture(Image *image, s32 index) {
     return Impl::upload_texture(image, index);
 }
 
+void reload_shaders() { Impl::reload_shaders(); }
+
 // Draw all rendered pixels to the screen.
 void blit() { Impl::blit(); }
 
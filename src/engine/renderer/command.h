@@ -9,6 +9,27 @@
 
 namespace Renderer {
 
+namespace Impl {
+struct Vertex;
+}  // namespace Impl
+
+///* SpriteBatch
+// A span of sprites reserved in the sprite queue, the memory
+// is written to directly by "write_sprite" so pushing a lot of
+// sprites at once only costs one upload.
+// <table class="member-table">
+//    <tr><th width="150">Type</th><th width="50">Name</th><th>Description</th></tr>
+//    <tr><td>u32</td><td>num_sprites</td><td>The number of sprites that were reserved.</td>
+//    <tr><td>u32</td><td>num_written</td><td>The number of sprites written so far.</td>
+// </table>
+struct SpriteBatch {
+    Impl::Vertex *verticies;
+    u32 num_sprites;
+    u32 num_written;
+
+    bool full() const { return num_written == num_sprites; }
+};
+
 // Initalize the graphics context.
 bool init(const char *title, int width, int height);
 
@@ -39,6 +60,25 @@ void push_sprite(Vec2 position, Vec2 dimension, f32 angle,
                                 AssetID texture, Vec2 uv_min, Vec2 uv_dimension,
                                 Vec4 color = V4(1, 1, 1, 1));
 
+///*
+// Reserves room for at most "num_sprites" sprites in the sprite queue.
+// Fewer sprites than asked for might be reserved, so keep reserving
+// until everything is written. Nothing else can be pushed until the
+// batch is handed back with "submit_sprites".
+SpriteBatch reserve_sprites(u32 num_sprites);
+
+///*
+// Writes a sprite into a reserved batch, the arguments are the same as
+// for "push_sprite" except that the texture slot is passed directly.
+void write_sprite(SpriteBatch *batch, s32 slot, Vec2 position,
+                  Vec2 dimension, f32 angle, Vec2 uv_min, Vec2 uv_dimension,
+                  Vec4 color = V4(1, 1, 1, 1));
+
+///*
+// Hands the batch back to the renderer, only the sprites that
+// were written are drawn.
+void submit_sprites(SpriteBatch *batch);
+
 ///*
 // Renders a rectangle to the screen. The position is the center if the
 // rectangle and the dimension is the total width of the rectangle, both are given
@@ -61,6 +101,10 @@ void push_point(Vec2 point, Vec4 color, f32 size = 0.015);
 u32 upload_texture(Image image, s32 index);
 u32 upload_texture(Image *image, s32 index);
 
+// Compiles the shaders in "res" again, one that doesn't
+// compile keeps the program it had.
+void reload_shaders();
+
 ///*
 // Sets the position of the window, relative to the
 // top left corner.
@@ -0,0 +1,88 @@
+bool init(const char *title, int width, int height) {
+    recalculate_global_aspect_ratio(width, height);
+    return true;
+}
+
+void push_verticies(u32 num_verticies, Vertex *verticies) {
+    null_stats.num_verticies += num_verticies;
+    null_stats.num_uploads++;
+}
+
+// A sprite is two triangles.
+const u32 VERTICIES_PER_SPRITE = 6;
+
+Vertex *map_sprites(u32 num_sprites, u32 *num_mapped_sprites) {
+    ASSERT(!num_mapped, "Cannot map the same queue twice.");
+    num_mapped = MIN(num_sprites * VERTICIES_PER_SPRITE,
+                     NULL_SCRATCH_VERTICIES - NULL_SCRATCH_VERTICIES %
+                                              VERTICIES_PER_SPRITE);
+    *num_mapped_sprites = num_mapped / VERTICIES_PER_SPRITE;
+    return scratch_verticies;
+}
+
+void unmap_sprites(u32 num_written) {
+    ASSERT(num_mapped, "Trying to unmap a queue that isn't mapped.");
+    ASSERT(num_written * VERTICIES_PER_SPRITE <= num_mapped,
+           "Wrote outside of the mapped region.");
+    null_stats.num_verticies += num_written * VERTICIES_PER_SPRITE;
+    null_stats.num_uploads++;
+    num_mapped = 0;
+}
+
+void push_sdf_quad(Vec2 min, Vec2 max, Vec2 min_uv, Vec2 max_uv,
+                   f32 sprite, Vec4 color, f32 low, f32 high, bool border) {
+    push_verticies(6, nullptr);
+}
+
+void push_quad(Vec2 min, Vec2 min_uv, Vec2 max, Vec2 max_uv,
+               f32 sprite, Vec4 color) {
+    push_verticies(6, nullptr);
+}
+
+void push_quad(Vec2 min, Vec2 max, Vec4 color) {
+    push_verticies(6, nullptr);
+}
+
+void push_triangle(Vec2 p1, Vec2 p2, Vec2 p3,
+                   Vec2 uv1, Vec2 uv2, Vec2 uv3,
+                   Vec4 color1, Vec4 color2, Vec4 color3,
+                   f32 sprite) {
+    push_verticies(3, nullptr);
+}
+
+void push_line(Vec2 start, Vec2 end, Vec4 start_color, Vec4 end_color,
+               f32 thickness) {
+    push_verticies(6, nullptr);
+}
+
+void push_point(Vec2 point, Vec4 color, f32 size) {
+    push_verticies(6, nullptr);
+}
+
+u32 upload_texture(const Image *image, s32 index) {
+    ASSERT(0 <= index && index < OPENGL_TEXTURE_DEPTH, "Invalid index.");
+    null_stats.num_textures++;
+    return index;
+}
+
+void reload_shaders() {}
+
+void clear() {}
+
+void blit() {}
+
+void set_window_position(int x, int y) {}
+
+Vec2 get_window_position() { return V2(0, 0); }
+
+void set_window_size(int w, int h) { recalculate_global_aspect_ratio(w, h); }
+
+Vec2 get_window_size() {
+    return V2(global_camera.width, global_camera.height);
+}
+
+void set_window_title(const char *title) {}
+
+void set_fullscreen(bool fullscreen) { is_fullscreen = fullscreen; }
+
+void toggle_fullscreen() { set_fullscreen(!is_fullscreen); }
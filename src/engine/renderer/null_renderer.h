@@ -0,0 +1,40 @@
+
+// A renderer that doesn't draw anything, it keeps the same
+// interface as the OpenGL renderer so the engine can be built
+// and measured without a window or a GPU.
+
+#pragma pack(push, 1)
+struct Vertex {
+    Vec2 position;
+    Vec2 texture;
+    f32  sprite;
+    Vec4 color;
+};
+
+struct SdfVertex {
+    Vec2 position;
+    Vec2 texture;
+    f32  sprite;
+    Vec4 color;
+    f32  low;
+    f32  high;
+    s32  border;
+};
+#pragma pack(pop)
+
+#define OPENGL_INVALID_SPRITE -1.0
+
+// Verticies are written here instead of to the GPU, it is
+// reused each time a batch is mapped.
+const u32 NULL_SCRATCH_VERTICIES = 1 << 12;
+Vertex scratch_verticies[NULL_SCRATCH_VERTICIES];
+u32 num_mapped;
+
+// Counters that can be read to see what would have been drawn.
+struct NullStats {
+    u64 num_verticies;
+    u64 num_uploads;
+    u64 num_textures;
+} null_stats = {};
+
+bool is_fullscreen = false;
@@ -64,6 +64,31 @@ static Program compile_shader_program_from_source(const char *source) {
     return shader;
 }
 
+// The program is only replaced if the new one compiles,
+// so a broken shader keeps the one that worked.
+static bool load_shader(const char *path, Program *program) {
+    const char *source = Util::dump_file(path);
+    if (!source) {
+        ERR("Failed to read \"%s\"", path);
+        return false;
+    }
+    Program loaded = compile_shader_program_from_source(source);
+    if (!loaded) return false;
+    if (program->id > 0)
+        glDeleteProgram(program->id);
+    *program = loaded;
+    return true;
+}
+
+void reload_shaders() {
+    load_shader("res/master_shader.glsl", &master_shader_program);
+    load_shader("res/font_shader.glsl", &font_shader_program);
+    if (load_shader("res/post_process_shader.glsl",
+                    &post_process_shader_program))
+        screen_texture_location = glGetUniformLocation(
+                post_process_shader_program.id, "screen_sampler");
+}
+
 template <typename T>
 u32 RenderQueue<T>::total_number_of_verticies() const {
     u32 sum = 0;
@@ -85,6 +110,7 @@ void RenderQueue<T>::create(u32 triangels_per_buffer) {
 
     next_free = 0;
     num_buffers = 0;
+    num_mapped = 0;
     expand();
 }
 
@@ -92,6 +118,7 @@ template <typename T>
 void RenderQueue<T>::push(u32 num_new_verticies, T *new_verticies) {
     ASSERT(gl_draw_hint, "Trying to use uninitalized render queue.");
     ASSERT(gl_draw_hint == GL_TRIANGLES, "Push code assumes triangles.");
+    ASSERT(!num_mapped, "Cannot push while the queue is mapped.");
 
     while (num_new_verticies) {
         for (u32 i = next_free; num_new_verticies; i++) {
@@ -115,6 +142,48 @@ void RenderQueue<T>::push(u32 num_new_verticies, T *new_verticies) {
     glBindVertexArray(0);
 }
 
+template <typename T>
+T *RenderQueue<T>::map(u32 num_verticies, u32 granularity, u32 *mapped) {
+    ASSERT(gl_draw_hint, "Trying to use uninitalized render queue.");
+    ASSERT(!num_mapped, "Cannot map the same queue twice.");
+    ASSERT(0 < granularity && granularity <= buffer_size,
+           "Invalid granularity for mapping.");
+
+    while (true) {
+        if (next_free == num_buffers) expand();
+        GLBuffer *buffer = vertex_buffers + next_free;
+        u32 free = buffer_size - buffer->draw_length;
+        free -= free % granularity;
+        if (free == 0) {
+            next_free++;
+            continue;
+        }
+        num_mapped = MIN(num_verticies - num_verticies % granularity, free);
+        ASSERT(num_mapped, "Mapping less than one granule.");
+
+        buffer->bind();
+        T *memory = (T *) glMapBufferRange(GL_ARRAY_BUFFER,
+                                           buffer->draw_length * sizeof(T),
+                                           num_mapped * sizeof(T),
+                                           GL_MAP_WRITE_BIT |
+                                           GL_MAP_INVALIDATE_RANGE_BIT);
+        ASSERT(memory, "Failed to map vertex buffer.");
+        *mapped = num_mapped;
+        return memory;
+    }
+}
+
+template <typename T>
+void RenderQueue<T>::unmap(u32 num_written) {
+    ASSERT(num_mapped, "Trying to unmap a queue that isn't mapped.");
+    ASSERT(num_written <= num_mapped, "Wrote outside of the mapped region.");
+    GLBuffer *buffer = vertex_buffers + next_free;
+    buffer->bind();
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    buffer->draw_length += num_written;
+    num_mapped = 0;
+    glBindVertexArray(0);
+}
 
 template <typename T>
 void RenderQueue<T>::expand() {
@@ -368,21 +437,13 @@ bool init(const char *title, int width, int height) {
     glBindBufferBase(GL_UNIFORM_BUFFER, GLSL_CAMERA_BLOCK, ubo_camera);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    const char *source;
-    ASSERT(source = Util::dump_file("res/master_shader.glsl"),
-           "Failed to read file.");
-    master_shader_program = compile_shader_program_from_source(source);
-    ASSERT(master_shader_program, "Failed to compile shader");
-
-    ASSERT(source = Util::dump_file("res/font_shader.glsl"),
-           "Failed to read file.");
-    font_shader_program = compile_shader_program_from_source(source);
-    ASSERT(font_shader_program, "Failed to compile shader");
-
-    ASSERT(source = Util::dump_file("res/post_process_shader.glsl"),
-           "Failed to read file.");
-    post_process_shader_program = compile_shader_program_from_source(source);
-    ASSERT(post_process_shader_program, "Failed to compile shader");
+    ASSERT(load_shader("res/master_shader.glsl", &master_shader_program),
+           "Failed to load shader");
+    ASSERT(load_shader("res/font_shader.glsl", &font_shader_program),
+           "Failed to load shader");
+    ASSERT(load_shader("res/post_process_shader.glsl",
+                       &post_process_shader_program),
+           "Failed to load shader");
     screen_texture_location = glGetUniformLocation(post_process_shader_program.id,
                                                "screen_sampler");
     create_frame_buffers(width, height);
@@ -390,12 +451,10 @@ bool init(const char *title, int width, int height) {
     glEnable(GL_BLEND);
     glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
+    // The storage is made when the first texture is uploaded.
     glGenTextures(1, &sprite_texture_array);
     glBindTexture(GL_TEXTURE_2D_ARRAY, sprite_texture_array);
 
-    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, OPENGL_TEXTURE_WIDTH,
-                   OPENGL_TEXTURE_HEIGHT, OPENGL_TEXTURE_DEPTH);
-
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -412,6 +471,22 @@ void push_verticies(u32 num_verticies, Vertex *verticies) {
     sprite_render_queue.push(num_verticies, verticies);
 }
 
+// A sprite is two triangles.
+const u32 VERTICIES_PER_SPRITE = 6;
+
+Vertex *map_sprites(u32 num_sprites, u32 *num_mapped) {
+    u32 num_verticies;
+    Vertex *verticies = sprite_render_queue.map(
+        num_sprites * VERTICIES_PER_SPRITE, VERTICIES_PER_SPRITE,
+        &num_verticies);
+    *num_mapped = num_verticies / VERTICIES_PER_SPRITE;
+    return verticies;
+}
+
+void unmap_sprites(u32 num_written) {
+    sprite_render_queue.unmap(num_written * VERTICIES_PER_SPRITE);
+}
+
 void push_sdf_quad(Vec2 min, Vec2 max, Vec2 min_uv, Vec2 max_uv,
                           f32 sprite, Vec4 color, f32 low, f32 high,
                           bool border) {
@@ -490,10 +565,78 @@ struct StoredImage {
     u32 width, height;
 };
 
+// Every layer of the array has the same format and levels,
+// so they're taken from the first texture that's uploaded.
+struct TextureStorage {
+    u32 levels;
+    ImageFormat format;
+    // BC3 is decoded on the CPU if the GPU can't read it.
+    bool is_compressed;
+} sprite_texture_storage = {};
+
+static void create_texture_storage(const Image *image) {
+    TextureStorage *storage = &sprite_texture_storage;
+    storage->levels = image->levels;
+    storage->format = image->format;
+    storage->is_compressed = image->format == ImageFormat::BC3 &&
+                             GLAD_GL_EXT_texture_compression_s3tc;
+    if (image->format == ImageFormat::BC3 && !storage->is_compressed)
+        LOG("BC3 textures aren't supported, they're decoded on the CPU");
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, storage->levels,
+                   storage->is_compressed ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                          : GL_RGBA8,
+                   OPENGL_TEXTURE_WIDTH, OPENGL_TEXTURE_HEIGHT,
+                   OPENGL_TEXTURE_DEPTH);
+    // The smaller levels are only used when it's drawn smaller,
+    // up close it still has sharp pixels.
+    if (storage->levels > 1)
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR);
+    // The rows of the small levels aren't 4 byte aligned.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+}
+
 u32 upload_texture(const Image *image, s32 index) {
-    ASSERT(0 <= index && index <= OPENGL_TEXTURE_DEPTH, "Invalid index.");
+    ASSERT(0 <= index && index < OPENGL_TEXTURE_DEPTH, "Invalid index.");
     ASSERT(0 < image->components && image->components < 5,
            "Invalid number of components");
+    CHECK(image->width == OPENGL_TEXTURE_WIDTH &&
+              image->height == OPENGL_TEXTURE_HEIGHT,
+          "Not using the entire texture 'slice'.");
+    TextureStorage *storage = &sprite_texture_storage;
+    if (!storage->levels)
+        create_texture_storage(image);
+    if (image->levels != storage->levels || image->format != storage->format) {
+        ERR("Texture %d doesn't have the same format and levels as the others",
+            index);
+        return index;
+    }
+
+    if (image->format == ImageFormat::BC3) {
+        u8 *decoded = nullptr;
+        if (!storage->is_compressed)
+            decoded = Util::push_memory<u8>(image->width * image->height * 4);
+        const u8 *level_data = image->data;
+        for (u32 level = 0; level < image->levels; level++) {
+            u32 width = image->level_width(level);
+            u32 height = image->level_height(level);
+            if (storage->is_compressed) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0,
+                                          index, width, height, 1,
+                                          GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+                                          image->level_size(level), level_data);
+            } else {
+                BlockCompression::decode_bc3(level_data, width, height, decoded);
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, index, width,
+                                height, 1, GL_RGBA, GL_UNSIGNED_BYTE, decoded);
+            }
+            level_data += image->level_size(level);
+        }
+        if (decoded)
+            Util::pop_memory(decoded);
+        return index;
+    }
+
     u32 data_format;
     switch (image->components) {
         case (1):
@@ -512,11 +655,13 @@ u32 upload_texture(const Image *image, s32 index) {
             UNREACHABLE;
             return 0;
     }
-    CHECK(image->width == OPENGL_TEXTURE_WIDTH &&
-              image->height == OPENGL_TEXTURE_HEIGHT,
-          "Not using the entire texture 'slice'.");
-    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, index, image->width,
-                    image->height, 1, data_format, GL_UNSIGNED_BYTE, image->data);
+    const u8 *level_data = image->data;
+    for (u32 level = 0; level < image->levels; level++) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, index,
+                        image->level_width(level), image->level_height(level),
+                        1, data_format, GL_UNSIGNED_BYTE, level_data);
+        level_data += image->level_size(level);
+    }
     return index;
 }
 
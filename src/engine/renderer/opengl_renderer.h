@@ -75,6 +75,20 @@ struct RenderQueue {
     // Add more verticies to render.
     void push(u32 num_new_verticies, T *new_verticies);
 
+    // How many verticies are currently mapped, only one
+    // region can be mapped at a time.
+    u32 num_mapped;
+
+    // Maps at most |num_verticies| verticies of a buffer so they
+    // can be written to directly, the number of verticies mapped
+    // is a multiple of |granularity| and is written to |mapped|.
+    // Nothing can be pushed until "unmap" is called.
+    T *map(u32 num_verticies, u32 granularity, u32 *mapped);
+
+    // Unmaps the mapped region, only the first |num_written|
+    // verticies are drawn.
+    void unmap(u32 num_written);
+
     // Expands the current queue by |GROW_BY| new buffers
     // with |buffer_size| elements in them.
     const u32 GROW_BY = 3;
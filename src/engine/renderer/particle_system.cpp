@@ -14,9 +14,11 @@ void Particle::update(f32 delta) {
     rotation += angular_velocity * delta;
 }
 
-void Particle::render(Vec2 origin, s32 slot, Vec2 uv_min, Vec2 uv_dim) {
+void Particle::render(SpriteBatch *batch, Vec2 origin, s32 slot,
+                      Vec2 uv_min, Vec2 uv_dim) {
     if (dead()) return;
-    Renderer::push_sprite(
+    Renderer::write_sprite(
+        batch,
         slot,
         position + origin,
         dim * LERP(spawn_size, progress, die_size),
@@ -97,25 +99,47 @@ void ParticleSystem::update(f32 delta) {
     } while ((i = (i + 1) % max_num_particles) != tail);
 }
 
+u32 ParticleSystem::num_alive() {
+    ASSERT(particles, "Trying to use uninitalized/destroyed particle system");
+    u32 alive = 0;
+    u32 i = head;
+    do {
+        alive += !particles[i].dead();
+    } while ((i = (i + 1) % max_num_particles) != tail);
+    return alive;
+}
+
 void ParticleSystem::draw() {
     ASSERT(particles, "Trying to use uninitalized/destroyed particle system");
+    u32 left = num_alive();
     u32 i = head;
     Vec2 p = relative ? position : V2(0, 0);
-    do {
-        i %= max_num_particles;
-        if (num_sub_sprites) {
-            SubSprite sprite = sub_sprites[particles[i].sprite];
-            particles[i].render(p, sprite.texture, sprite.min, sprite.dim);
-        } else {
-            particles[i].render(p, -1, V2(0, 0), V2(0, 0));
+    while (left) {
+        // The renderer might hand out fewer sprites than asked for,
+        // when it does the rest go in another batch.
+        SpriteBatch batch = reserve_sprites(left);
+        while (!batch.full()) {
+            Particle *particle = particles + i;
+            i = (i + 1) % max_num_particles;
+            if (particle->dead()) continue;
+            if (num_sub_sprites) {
+                SubSprite sprite = sub_sprites[particle->sprite];
+                particle->render(&batch, p, sprite.texture, sprite.min,
+                                 sprite.dim);
+            } else {
+                particle->render(&batch, p, -1, V2(0, 0), V2(0, 0));
+            }
         }
-    } while ((i = (i + 1) % max_num_particles) != tail);
+        left -= batch.num_written;
+        submit_sprites(&batch);
+    }
 }
 
 void ParticleSystem::add_sprite(AssetID texture, u32 u, u32 v, u32 w, u32 h){
     ASSERT(particles, "Trying to use uninitalized/destroyed particle system");
-    SubSprite sub_sprite = {Asset::fetch_image(texture)->id,
-        V2(u, v),
+    const Asset::Texture *image = Asset::fetch_image(texture);
+    SubSprite sub_sprite = {image->id,
+        V2(image->x + u, image->y + v),
         V2(w, h)};
     ASSERT(num_sub_sprites != MAX_NUM_SUB_SPRITES,
             "Too manu subsprites in particle system");
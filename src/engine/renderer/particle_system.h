@@ -35,7 +35,8 @@ struct Particle {
 
     void update(f32 delta);
 
-    void render(Vec2 origin, s32 slot, Vec2 uv_min, Vec2 uv_dim);
+    void render(SpriteBatch *batch, Vec2 origin, s32 slot, Vec2 uv_min,
+                Vec2 uv_dim);
 };
 
 struct ParticleSystem {
@@ -112,7 +113,11 @@ struct ParticleSystem {
     // Updates all active particles.
     void update(f32 delta);
 
-    // Renders the entire particle system.
+    // Counts the particles that are alive.
+    u32 num_alive();
+
+    // Renders the entire particle system, all particles
+    // are written into one batch.
     void draw();
 
     // Adds a sprite as a potential particle.
@@ -222,7 +227,9 @@ void ParticleSystem::spawn();
 void ParticleSystem::update(f32 delta);
     
 ///*
-// Draws the particle system to the screen.
+// Draws the particle system to the screen. The particles are
+// written straight into memory reserved from the renderer, so
+// the cost doesn't grow with the number of GPU uploads.
 void ParticleSystem::draw();
 
 ///*
@@ -0,0 +1,284 @@
+#include <string.h>
+
+namespace BlockCompression {
+
+const u32 PIXELS_PER_BLOCK = BLOCK_SIZE * BLOCK_SIZE;
+
+u64 bc3_size(u32 width, u32 height) {
+    u64 blocks_wide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    u64 blocks_high = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return blocks_wide * blocks_high * BC3_BLOCK_BYTES;
+}
+
+static u16 to_565(const f32 *color) {
+    u32 r = CLAMP(0, 31, (s32) (color[0] * (31.0f / 255.0f) + 0.5f));
+    u32 g = CLAMP(0, 63, (s32) (color[1] * (63.0f / 255.0f) + 0.5f));
+    u32 b = CLAMP(0, 31, (s32) (color[2] * (31.0f / 255.0f) + 0.5f));
+    return r << 11 | g << 5 | b;
+}
+
+static void from_565(u16 packed, s32 *color) {
+    s32 r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+// The 4 colors a block can pick from, both
+// end points and two between them.
+static void color_palette(u16 c0, u16 c1, s32 palette[4][3]) {
+    from_565(c0, palette[0]);
+    from_565(c1, palette[1]);
+    for (u32 i = 0; i < 3; i++) {
+        palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+        palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+    }
+}
+
+static void alpha_palette(u8 a0, u8 a1, s32 palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (u32 i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    } else {
+        for (u32 i = 1; i < 5; i++)
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// The end points are the lowest and highest alpha, so
+// fully transparent and opaque pixels stay exact.
+static void encode_alpha(const u8 block[PIXELS_PER_BLOCK][4], u8 *to) {
+    u8 low = 255, high = 0;
+    for (u32 i = 0; i < PIXELS_PER_BLOCK; i++) {
+        low = MIN(low, block[i][3]);
+        high = MAX(high, block[i][3]);
+    }
+    to[0] = high;
+    to[1] = low;
+    s32 palette[8];
+    alpha_palette(high, low, palette);
+    u64 indices = 0;
+    if (high != low) {
+        for (u32 i = 0; i < PIXELS_PER_BLOCK; i++) {
+            u32 best = 0;
+            s32 best_error = 256;
+            for (u32 j = 0; j < 8; j++) {
+                s32 error = abs(palette[j] - block[i][3]);
+                if (error < best_error) {
+                    best = j;
+                    best_error = error;
+                }
+            }
+            indices |= (u64) best << (3 * i);
+        }
+    }
+    for (u32 i = 0; i < 6; i++)
+        to[2 + i] = indices >> (8 * i);
+}
+
+// Picks the closest of the palette for every pixel,
+// and returns the total squared error.
+static u32 pick_colors(const u8 block[PIXELS_PER_BLOCK][4], u16 c0, u16 c1,
+                       u32 *indices) {
+    s32 palette[4][3];
+    color_palette(c0, c1, palette);
+    u32 total = 0;
+    *indices = 0;
+    for (u32 i = 0; i < PIXELS_PER_BLOCK; i++) {
+        u32 best = 0;
+        u32 best_error = ~0u;
+        for (u32 j = 0; j < 4; j++) {
+            u32 error = 0;
+            for (u32 c = 0; c < 3; c++) {
+                s32 difference = palette[j][c] - block[i][c];
+                error += difference * difference;
+            }
+            if (error < best_error) {
+                best = j;
+                best_error = error;
+            }
+        }
+        // Pixels that can't be seen take any color.
+        if (block[i][3]) total += best_error;
+        *indices |= best << (2 * i);
+    }
+    return total;
+}
+
+static void write_color(u8 *to, u16 c0, u16 c1, u32 indices) {
+    to[0] = c0;
+    to[1] = c0 >> 8;
+    to[2] = c1;
+    to[3] = c1 >> 8;
+    memcpy(to + 4, &indices, sizeof(indices));
+}
+
+// The end points are where the pixels spread out the most,
+// the principal axis of the colors, and are then moved to
+// fit the picked indices better with least squares.
+static void encode_color(const u8 block[PIXELS_PER_BLOCK][4], u8 *to) {
+    u32 num_visible = 0;
+    for (u32 i = 0; i < PIXELS_PER_BLOCK; i++)
+        num_visible += block[i][3] != 0;
+    // If nothing can be seen, every pixel counts the same.
+    bool use_all = num_visible == 0;
+    f32 count = use_all ? PIXELS_PER_BLOCK : num_visible;
+
+    f32 mean[3] = {};
+    for (u32 i = 0; i < PIXELS_PER_BLOCK; i++)
+        if (use_all || block[i][3])
+            for (u32 c = 0; c < 3; c++)
+                mean[c] += block[i][c];
+    for (u32 c = 0; c < 3; c++)
+        mean[c] /= count;
+
+    f32 covariance[6] = {};
+    for (u32 i = 0; i < PIXELS_PER_BLOCK; i++) {
+        if (!use_all && !block[i][3]) continue;
+        f32 r = block[i][0] - mean[0];
+        f32 g = block[i][1] - mean[1];
+        f32 b = block[i][2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+    f32 axis[3] = {1.0f, 1.0f, 1.0f};
+    for (u32 step = 0; step < 8; step++) {
+        f32 next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2],
+        };
+        f32 length = MAX(fabsf(next[0]), MAX(fabsf(next[1]), fabsf(next[2])));
+        if (length < 1e-6f) break;
+        for (u32 c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+    f32 length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (u32 c = 0; c < 3; c++)
+        axis[c] /= length;
+
+    f32 low = 1e9f, high = -1e9f;
+    for (u32 i = 0; i < PIXELS_PER_BLOCK; i++) {
+        if (!use_all && !block[i][3]) continue;
+        f32 t = 0;
+        for (u32 c = 0; c < 3; c++)
+            t += (block[i][c] - mean[c]) * axis[c];
+        low = MIN(low, t);
+        high = MAX(high, t);
+    }
+    f32 end_0[3], end_1[3];
+    for (u32 c = 0; c < 3; c++) {
+        end_0[c] = mean[c] + axis[c] * high;
+        end_1[c] = mean[c] + axis[c] * low;
+    }
+    u16 c0 = to_565(end_0), c1 = to_565(end_1);
+    u32 indices;
+    u32 error = pick_colors(block, c0, c1, &indices);
+
+    // How much of end point 0 is in each palette entry.
+    const f32 WEIGHTS[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    if (c0 != c1 && error) {
+        f32 aa = 0, ab = 0, bb = 0;
+        f32 ax[3] = {}, bx[3] = {};
+        for (u32 i = 0; i < PIXELS_PER_BLOCK; i++) {
+            if (!use_all && !block[i][3]) continue;
+            f32 a = WEIGHTS[(indices >> (2 * i)) & 3];
+            f32 b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (u32 c = 0; c < 3; c++) {
+                ax[c] += a * block[i][c];
+                bx[c] += b * block[i][c];
+            }
+        }
+        f32 determinant = aa * bb - ab * ab;
+        if (fabsf(determinant) > 1e-6f) {
+            for (u32 c = 0; c < 3; c++) {
+                end_0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+                end_1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+            }
+            u16 refined_0 = to_565(end_0), refined_1 = to_565(end_1);
+            u32 refined_indices;
+            u32 refined_error = pick_colors(block, refined_0, refined_1,
+                                            &refined_indices);
+            if (refined_error < error) {
+                c0 = refined_0;
+                c1 = refined_1;
+                indices = refined_indices;
+            }
+        }
+    }
+
+    // The order doesn't matter for BC3, but some decoders
+    // read c0 <= c1 as the 3 color mode of BC1.
+    if (c0 < c1) {
+        u16 swap = c0;
+        c0 = c1;
+        c1 = swap;
+        // Swaps 0 with 1 and 2 with 3.
+        indices ^= 0x55555555;
+    } else if (c0 == c1) {
+        indices = 0;
+    }
+    write_color(to, c0, c1, indices);
+}
+
+void encode_bc3(const u8 *rgba, u32 width, u32 height, u8 *to) {
+    for (u32 block_y = 0; block_y < height; block_y += BLOCK_SIZE) {
+        for (u32 block_x = 0; block_x < width; block_x += BLOCK_SIZE) {
+            u8 block[PIXELS_PER_BLOCK][4];
+            for (u32 y = 0; y < BLOCK_SIZE; y++) {
+                for (u32 x = 0; x < BLOCK_SIZE; x++) {
+                    u32 from_x = MIN(block_x + x, width - 1);
+                    u32 from_y = MIN(block_y + y, height - 1);
+                    memcpy(block[y * BLOCK_SIZE + x],
+                           rgba + (from_y * width + from_x) * 4, 4);
+                }
+            }
+            encode_alpha(block, to);
+            encode_color(block, to + 8);
+            to += BC3_BLOCK_BYTES;
+        }
+    }
+}
+
+void decode_bc3(const u8 *from, u32 width, u32 height, u8 *rgba) {
+    for (u32 block_y = 0; block_y < height; block_y += BLOCK_SIZE) {
+        for (u32 block_x = 0; block_x < width; block_x += BLOCK_SIZE) {
+            s32 alphas[8];
+            alpha_palette(from[0], from[1], alphas);
+            u64 alpha_indices = 0;
+            for (u32 i = 0; i < 6; i++)
+                alpha_indices |= (u64) from[2 + i] << (8 * i);
+            s32 colors[4][3];
+            color_palette(from[8] | from[9] << 8, from[10] | from[11] << 8,
+                          colors);
+            u32 color_indices;
+            memcpy(&color_indices, from + 12, sizeof(color_indices));
+
+            for (u32 i = 0; i < PIXELS_PER_BLOCK; i++) {
+                u32 x = block_x + i % BLOCK_SIZE;
+                u32 y = block_y + i / BLOCK_SIZE;
+                if (x >= width || y >= height) continue;
+                u8 *pixel = rgba + (y * width + x) * 4;
+                const s32 *color = colors[(color_indices >> (2 * i)) & 3];
+                pixel[0] = color[0];
+                pixel[1] = color[1];
+                pixel[2] = color[2];
+                pixel[3] = alphas[(alpha_indices >> (3 * i)) & 7];
+            }
+            from += BC3_BLOCK_BYTES;
+        }
+    }
+}
+
+}  // namespace BlockCompression
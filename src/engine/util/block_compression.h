@@ -0,0 +1,32 @@
+///# Block compression
+// Textures can be stored as BC3, also called DXT5, which the
+// GPU samples as it is. It takes a quarter of the memory and
+// bandwidth of RGBA8, at the cost of some quality.
+//
+// Every 4x4 block of pixels is 16 bytes. The first 8 are the
+// alpha, two end points and a 3 bit index per pixel into the
+// 8 values between them. The last 8 are the color, two 565 end
+// points and a 2 bit index per pixel into the 4 colors between
+// them. Mist encodes the textures when they're baked, and they
+// are decoded on the CPU if the GPU can't read them.
+
+namespace BlockCompression {
+
+const u32 BLOCK_SIZE = 4;
+const u32 BC3_BLOCK_BYTES = 16;
+
+///*
+// The number of bytes a BC3 image of this size takes.
+u64 bc3_size(u32 width, u32 height);
+
+///*
+// Encodes an RGBA8 image into "to", which has room for
+// "bc3_size(width, height)" bytes. Blocks that go past
+// the edge repeat the last row and column.
+void encode_bc3(const u8 *rgba, u32 width, u32 height, u8 *to);
+
+///*
+// Decodes a BC3 image into RGBA8.
+void decode_bc3(const u8 *from, u32 width, u32 height, u8 *rgba);
+
+}  // namespace BlockCompression
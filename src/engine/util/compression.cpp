@@ -0,0 +1,168 @@
+#include <string.h>
+
+namespace Compression {
+
+const u32 MIN_MATCH = 4;
+// The format needs the last 5 bytes to be literals, and
+// the last match to start 12 bytes before the end.
+const u32 LAST_LITERALS = 5;
+const u32 MATCH_LIMIT = 12;
+const u32 MAX_OFFSET = 0xFFFF;
+const u32 HASH_BITS = 14;
+
+static u32 read_32(const u8 *at) {
+    u32 value;
+    memcpy(&value, at, sizeof(value));
+    return value;
+}
+
+static u64 read_64(const u8 *at) {
+    u64 value;
+    memcpy(&value, at, sizeof(value));
+    return value;
+}
+
+static u32 hash(const u8 *at) {
+    return (read_32(at) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// How many bytes are the same, eight at a time
+// until they differ.
+static u64 match_length(const u8 *at, const u8 *match, const u8 *limit) {
+    const u8 *start = at;
+    while (at + sizeof(u64) <= limit) {
+        u64 difference = read_64(at) ^ read_64(match);
+        if (difference)
+            return at - start + (__builtin_ctzll(difference) >> 3);
+        at += sizeof(u64);
+        match += sizeof(u64);
+    }
+    while (at < limit && *at == *match) {
+        at++;
+        match++;
+    }
+    return at - start;
+}
+
+static u8 *write_length(u8 *to, u64 length) {
+    for (; length >= 255; length -= 255)
+        *to++ = 255;
+    *to++ = length;
+    return to;
+}
+
+static u8 *write_literals(u8 *to, u8 *token, const u8 *from, u64 length) {
+    *token = MIN(length, 15u) << 4;
+    if (length >= 15)
+        to = write_length(to, length - 15);
+    if (length)
+        memcpy(to, from, length);
+    return to + length;
+}
+
+u64 max_compressed_size(u64 size) {
+    return size + size / 255 + 16;
+}
+
+u64 compress(const u8 *from, u64 size, u8 *to) {
+    const u8 *end = from + size;
+    const u8 *anchor = from;
+    u8 *out = to;
+    if (size > MATCH_LIMIT) {
+        // The last place each 4 bytes were seen, the
+        // matches are checked so it can start empty.
+        u32 table[1 << HASH_BITS] = {};
+        const u8 *match_limit = end - MATCH_LIMIT;
+        const u8 *literal_limit = end - LAST_LITERALS;
+        const u8 *at = from;
+        // Skips ahead faster the longer nothing is found,
+        // so data that doesn't compress is quick to pass.
+        u32 misses = 0;
+        while (at < match_limit) {
+            u32 slot = hash(at);
+            const u8 *match = from + table[slot];
+            table[slot] = at - from;
+            if (match >= at || (u64) (at - match) > MAX_OFFSET ||
+                read_32(match) != read_32(at)) {
+                at += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            while (at > anchor && match > from && at[-1] == match[-1]) {
+                at--;
+                match--;
+            }
+            u64 length = MIN_MATCH + match_length(at + MIN_MATCH,
+                                                  match + MIN_MATCH,
+                                                  literal_limit);
+            u8 *token = out++;
+            out = write_literals(out, token, anchor, at - anchor);
+            u64 offset = at - match;
+            *out++ = offset & 0xFF;
+            *out++ = offset >> 8;
+            *token |= MIN(length - MIN_MATCH, 15u);
+            if (length - MIN_MATCH >= 15)
+                out = write_length(out, length - MIN_MATCH - 15);
+            at += length;
+            anchor = at;
+        }
+    }
+    u8 *token = out++;
+    out = write_literals(out, token, anchor, end - anchor);
+    return out - to;
+}
+
+static bool read_length(const u8 **from, const u8 *end, u64 *length) {
+    u8 byte;
+    do {
+        if (*from == end) return false;
+        byte = *(*from)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool decompress(const u8 *from, u64 size, u8 *to, u64 decompressed_size) {
+    const u8 *in = from;
+    const u8 *in_end = from + size;
+    u8 *out = to;
+    u8 *out_end = to + decompressed_size;
+    while (in < in_end) {
+        u8 token = *in++;
+        u64 literals = token >> 4;
+        if (literals == 15 && !read_length(&in, in_end, &literals))
+            return false;
+        if ((u64) (in_end - in) < literals || (u64) (out_end - out) < literals)
+            return false;
+        if (literals)
+            memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+        // The last sequence has no match.
+        if (in == in_end) break;
+
+        if (in_end - in < 2) return false;
+        u64 offset = in[0] | in[1] << 8;
+        in += 2;
+        if (offset == 0 || offset > (u64) (out - to)) return false;
+        u64 length = token & 15;
+        if (length == 15 && !read_length(&in, in_end, &length))
+            return false;
+        length += MIN_MATCH;
+        if ((u64) (out_end - out) < length) return false;
+
+        // A match closer than its length repeats itself, every
+        // copy doubles how much of it there is to copy from,
+        // so the copies never overlap.
+        const u8 *match = out - offset;
+        while (length) {
+            u64 chunk = MIN(length, (u64) (out - match));
+            memcpy(out, match, chunk);
+            out += chunk;
+            length -= chunk;
+        }
+    }
+    return in == in_end && out == out_end;
+}
+
+}  // namespace Compression
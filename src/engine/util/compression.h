@@ -0,0 +1,36 @@
+///# Compression
+// A small LZ77 compressor that writes the LZ4 block format.
+// It doesn't compress as well as zlib, but it decompresses
+// at several GB/s, which is a lot faster than the disk, so
+// reading less and decompressing is faster than reading all
+// of it.
+//
+// A block is a list of sequences. Every sequence is a token,
+// some literal bytes, and a match that copies bytes that were
+// already written. The high half of the token is the number of
+// literals and the low half the length of the match minus 4,
+// 15 means more of the length follows in bytes of 255 until
+// one that isn't. The match is an offset backwards of 2 bytes,
+// little endian. The last sequence is only literals.
+
+namespace Compression {
+
+///*
+// The most bytes compressing "size" bytes can take, for
+// data that doesn't compress at all.
+u64 max_compressed_size(u64 size);
+
+///*
+// Compresses "size" bytes from "from" into "to", which has to
+// have room for "max_compressed_size(size)" bytes. Returns how
+// many bytes were written.
+u64 compress(const u8 *from, u64 size, u8 *to);
+
+///*
+// Decompresses "size" bytes from "from" into "to", which has
+// room for exactly "decompressed_size" bytes. Returns false
+// if the data is broken, it never reads or writes outside of
+// the buffers.
+bool decompress(const u8 *from, u64 size, u8 *to, u64 decompressed_size);
+
+}  // namespace Compression
@@ -64,7 +64,7 @@ Image load_png(const char *file_path) {
                                       &y, &c, 0);
     CHECK(x == OPENGL_TEXTURE_WIDTH && y == OPENGL_TEXTURE_HEIGHT,
           "Loading texture of incorrect dimensions");
-    return {image, (u32) x, (u32) y, (u8) c};
+    return {image, (u32) x, (u32) y, (u8) c, 0, 1, ImageFormat::PIXELS};
 }
 
 }  // namespace Util
@@ -0,0 +1,225 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Jobs {
+
+const u32 MAX_THREADS = 32;
+// How many times an idle worker looks for work
+// before it goes to sleep.
+const u32 SPINS_BEFORE_SLEEP = 64;
+
+struct JobSystem {
+    u32 num_threads;
+    Queue *queues;
+    std::thread *workers;
+
+    std::atomic<bool> running;
+    // Jobs added but not taken, so sleeping
+    // workers know when to wake up.
+    std::atomic<s32> pending;
+    std::mutex sleep_lock;
+    std::condition_variable wake_up;
+} job_system = {};
+
+// Threads that aren't workers count as the main thread.
+thread_local u32 this_thread = 0;
+
+static void lock(Queue *queue) {
+    while (queue->lock.test_and_set(std::memory_order_acquire))
+        ;
+}
+
+static void unlock(Queue *queue) {
+    queue->lock.clear(std::memory_order_release);
+}
+
+static bool push(Queue *queue, Job job) {
+    lock(queue);
+    bool has_room = queue->bottom - queue->top < Queue::CAPACITY;
+    if (has_room)
+        queue->jobs[queue->bottom++ % Queue::CAPACITY] = job;
+    unlock(queue);
+    return has_room;
+}
+
+// The newest job, it's most likely to still be in the cache.
+static bool pop(Queue *queue, Job *job) {
+    lock(queue);
+    bool found = queue->bottom != queue->top;
+    if (found)
+        *job = queue->jobs[--queue->bottom % Queue::CAPACITY];
+    unlock(queue);
+    return found;
+}
+
+// The oldest job, which is usually the largest piece of work.
+static bool steal(Queue *queue, Job *job) {
+    lock(queue);
+    bool found = queue->bottom != queue->top;
+    if (found)
+        *job = queue->jobs[queue->top++ % Queue::CAPACITY];
+    unlock(queue);
+    return found;
+}
+
+static void execute(Job job) {
+    job.function(job.data);
+    if (job.counter)
+        job.counter->value.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// Looks in this threads queue first, then tries everyone
+// else starting with the next thread.
+static bool find_job(u32 thread, Job *job) {
+    JobSystem *system = &job_system;
+    bool found = pop(system->queues + thread, job);
+    for (u32 i = 1; !found && i < system->num_threads; i++)
+        found = steal(system->queues + (thread + i) % system->num_threads, job);
+    if (found)
+        system->pending.fetch_sub(1, std::memory_order_relaxed);
+    return found;
+}
+
+static void worker(u32 thread) {
+    JobSystem *system = &job_system;
+    this_thread = thread;
+    u32 spins = 0;
+    while (true) {
+        Job job;
+        if (find_job(thread, &job)) {
+            execute(job);
+            spins = 0;
+            continue;
+        }
+        if (!system->running.load()) break;
+        if (++spins < SPINS_BEFORE_SLEEP) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(system->sleep_lock);
+        system->wake_up.wait(guard, [system]() {
+            return system->pending.load() > 0 || !system->running.load();
+        });
+        spins = 0;
+    }
+}
+
+bool init(s32 num_workers) {
+    JobSystem *system = &job_system;
+    if (num_workers < 0)
+        num_workers = MAX((s32) std::thread::hardware_concurrency() - 1, 0);
+    num_workers = MIN(num_workers, (s32) MAX_THREADS - 1);
+
+    system->num_threads = num_workers + 1;
+    system->queues = new Queue[system->num_threads];
+    for (u32 i = 0; i < system->num_threads; i++) {
+        system->queues[i].lock.clear();
+        system->queues[i].top = 0;
+        system->queues[i].bottom = 0;
+    }
+    system->pending = 0;
+    system->running = true;
+    system->workers = new std::thread[num_workers];
+    for (s32 i = 0; i < num_workers; i++)
+        system->workers[i] = std::thread(worker, i + 1);
+    return true;
+}
+
+void destroy() {
+    JobSystem *system = &job_system;
+    if (!system->queues) return;
+    {
+        std::lock_guard<std::mutex> guard(system->sleep_lock);
+        system->running = false;
+    }
+    system->wake_up.notify_all();
+    for (u32 i = 0; i < system->num_threads - 1; i++)
+        system->workers[i].join();
+
+    // Anything left is run here.
+    Job job;
+    while (find_job(0, &job))
+        execute(job);
+    delete[] system->workers;
+    delete[] system->queues;
+    system->workers = nullptr;
+    system->queues = nullptr;
+    system->num_threads = 0;
+}
+
+u32 num_threads() {
+    return MAX(job_system.num_threads, 1u);
+}
+
+u32 thread_index() {
+    return this_thread;
+}
+
+void run(JobFunction function, void *data, Counter *counter) {
+    JobSystem *system = &job_system;
+    Job job = {function, data, counter};
+    if (counter)
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+
+    // Without workers, or with a full queue,
+    // the job is run right away.
+    if (system->num_threads <= 1 ||
+        !push(system->queues + this_thread, job)) {
+        execute(job);
+        return;
+    }
+
+    if (system->pending.fetch_add(1, std::memory_order_relaxed) == 0) {
+        // Taking the lock makes sure a worker that's about
+        // to sleep sees the job.
+        std::lock_guard<std::mutex> guard(system->sleep_lock);
+    }
+    system->wake_up.notify_one();
+}
+
+void wait(Counter *counter) {
+    while (counter->value.load(std::memory_order_acquire) > 0) {
+        Job job;
+        if (job_system.num_threads > 1 && find_job(this_thread, &job))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+template <typename F>
+struct ForRange {
+    F *body;
+    u32 begin, end;
+};
+
+template <typename F>
+static void run_range(void *data) {
+    ForRange<F> *range = (ForRange<F> *) data;
+    (*range->body)(range->begin, range->end);
+}
+
+template <typename F>
+void parallel_for(u32 count, u32 batch, F body) {
+    ASSERT(batch > 0, "Batches can't be empty");
+    if (count == 0) return;
+    u32 num_ranges = (count + batch - 1) / batch;
+    if (num_ranges == 1 || num_threads() == 1) {
+        // Same order as the ranges would have been run.
+        for (u32 begin = 0; begin < count; begin += batch)
+            body(begin, MIN(begin + batch, count));
+        return;
+    }
+
+    ForRange<F> *ranges = Util::push_memory<ForRange<F>>(num_ranges);
+    Counter counter = {};
+    for (u32 i = 0; i < num_ranges; i++) {
+        ranges[i] = {&body, i * batch, MIN((i + 1) * batch, count)};
+        run(run_range<F>, ranges + i, &counter);
+    }
+    wait(&counter);
+    Util::pop_memory(ranges);
+}
+
+}  // namespace Jobs
@@ -0,0 +1,82 @@
+#include <atomic>
+
+///# Jobs
+// The job system spreads work over all the cores. Every
+// thread, the main thread included, has a queue of jobs.
+// A thread takes the newest job from its own queue, and
+// when it runs out it steals the oldest job from someone
+// else, so the work evens out without a shared queue that
+// everyone fights over.
+//
+// A job is a function and a pointer, and it counts down a
+// counter when it's done. Waiting on the counter runs other
+// jobs in the meantime, so the main thread never just sits
+// there.
+//
+// With no worker threads every job is run right away on the
+// thread that adds it, in the order they are added, which is
+// handy when something has to be reproduced exactly.
+
+namespace Jobs {
+
+typedef void (*JobFunction)(void *data);
+
+///* Counter
+// Counts the jobs that are not done yet, wait on it to
+// know that all of them have finished.
+struct Counter {
+    std::atomic<s32> value;
+};
+
+struct Job {
+    JobFunction function;
+    void *data;
+    Counter *counter;
+};
+
+// The owner pushes and pops at the bottom, thieves
+// take from the top.
+struct Queue {
+    static const u32 CAPACITY = 4096;
+
+    std::atomic_flag lock;
+    u32 top;
+    u32 bottom;
+    Job jobs[CAPACITY];
+};
+
+///*
+// Starts the worker threads, -1 starts one less than the number
+// of cores and 0 starts none, which makes everything run on the
+// calling thread.
+bool init(s32 num_workers = -1);
+
+///*
+// Stops the worker threads, the jobs that are left are run first.
+void destroy();
+
+///*
+// How many threads run jobs, the main thread included.
+u32 num_threads();
+
+///*
+// Which of the threads this is, the main thread is 0.
+u32 thread_index();
+
+///*
+// Adds a job, the counter is counted up now and down when
+// the job has run. The counter can be nullptr.
+void run(JobFunction function, void *data, Counter *counter);
+
+///*
+// Runs jobs until the counter reaches 0.
+void wait(Counter *counter);
+
+///*
+// Calls "body(begin, end)" for ranges of at most "batch"
+// items covering 0 to "count", spread over the threads,
+// and returns when all of them are done.
+template <typename F>
+void parallel_for(u32 count, u32 batch, F body);
+
+}  // namespace Jobs
@@ -19,6 +19,7 @@ void do_all_allocations() {
         global_memory.all_regions[i].memory = malloc(ARENA_SIZE_IN_BYTES);
     }
     global_memory.all_regions[NUM_ARENAS - 1].next = 0;
+    global_memory.all_regions[NUM_ARENAS - 1].memory = malloc(ARENA_SIZE_IN_BYTES);
 
     // Frame memory
     for (u32 i = 0; i < FRAME_LAG_FOR_MEMORY; i++)
@@ -17,35 +17,76 @@ struct String {
     operator char *() const { return data; }
 };
 
+// How the pixels of an Image are stored, BC3 is
+// described in "util/block_compression.h".
+enum class ImageFormat : u16 {
+    PIXELS,
+    BC3,
+};
+
 struct Image {
     u8 *data;
     const u32 width;
     const u32 height;
     const u8 components;
     const u16 id;
+    // Every level is half the size of the one before,
+    // and they follow each other in "data".
+    const u8 levels;
+    const ImageFormat format;
 
     operator bool () const {
         return data;
     }
 
+    u32 level_width(u32 level) const {
+        return width >> level ? width >> level : 1;
+    }
+
+    u32 level_height(u32 level) const {
+        return height >> level ? height >> level : 1;
+    }
+
+    u64 level_size(u32 level) const {
+        u64 w = level_width(level), h = level_height(level);
+        if (format == ImageFormat::BC3)
+            return ((w + 3) / 4) * ((h + 3) / 4) * 16;
+        return w * h * components;
+    }
+
     u64 size() const {
-        return width * height * components;
+        u64 total = 0;
+        for (u32 level = 0; level < levels; level++)
+            total += level_size(level);
+        return total;
     }
 };
 
 // TODO(ed): Choose a more standard sample rate.
 const u64 AUDIO_SAMPLE_RATE = 48000;
 
+// Sounds are used straight from the asset file, the
+// samples are "samples_offset" bytes from the start
+// of the struct.
 struct Sound {
-    union {
-        u8 *data;
-        s16 *samples_16;
-        f32 *samples_32;
-    };
     u64 num_samples;
+    u64 samples_offset;
     u32 size;
-    u16 sample_rate;
+    u32 sample_rate;
     u8 bits_per_sample;
     u8 is_stereo;
+    u8 padding[6];
+
+    const u8 *data() const {
+        return (const u8 *) this + samples_offset;
+    }
+
+    const s16 *samples_16() const {
+        return (const s16 *) data();
+    }
+
+    const f32 *samples_32() const {
+        return (const f32 *) data();
+    }
 };
 
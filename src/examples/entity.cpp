@@ -0,0 +1,33 @@
+///# Entity examples
+// How to make entities, give them components and
+// update them with systems.
+
+//// Moving things
+// <p>
+// Components are plain structs, any struct can be
+// used as a component. Here every entity with both a
+// position and a velocity is moved.
+// </p>
+struct Position { Vec2 value; };
+struct Velocity { Vec2 value; };
+
+EntityID id = Logic::create_entity();
+Logic::add_component(id, Position{V2(0, 0)});
+Logic::add_component(id, Velocity{V2(1, 0)});
+// <p>
+// The system is called before every update. It only
+// reads the velocity and only writes the position, which
+// lets other systems that don't write to either share a
+// batch with it.
+// </p>
+Logic::add_system(Logic::At::PRE_UPDATE, [](f32 delta) {
+    Logic::for_each<Position, Velocity>(
+        [delta](EntityID, Position &position, Velocity &velocity) {
+            position.value += velocity.value * delta;
+        });
+}, Logic::component_mask<Velocity>(), Logic::component_mask<Position>());
+// <p>
+// Destroying the entity removes all of its components, the
+// id is never valid again.
+// </p>
+Logic::destroy_entity(id);
@@ -28,3 +28,27 @@ LogicID id = Logic::add_callback(Logic::At::PRE_DRAW, callback, 1.0,
 // call the remove function.
 // </p>
 Logic::remove_callback(id);
+
+//// Callbacks that run at the same time
+// <p>
+// Callbacks that say what they read and write can be
+// run on different threads, as long as they don't touch
+// the same things. The bits are handed out by
+// <i>add_resource</i>, and a callback that touches nothing
+// shared can pass 0 for both.
+// </p>
+Logic::ResourceMask CLOUDS = Logic::add_resource();
+Logic::ResourceMask SCORE = Logic::add_resource();
+
+LogicID clouds = Logic::add_callback(Logic::At::PRE_UPDATE, spawn_cloud,
+                                     0, Logic::FOREVER, 2.0);
+Logic::set_access(clouds, 0, CLOUDS | Logic::RANDOM);
+
+LogicID counter = Logic::add_callback(Logic::At::PRE_UPDATE, count_score,
+                                      0, Logic::FOREVER);
+Logic::set_access(counter, 0, SCORE);
+// <p>
+// These two never wait for each other, but a callback
+// that doesn't call <i>set_access</i> still waits for
+// everything before it and holds up everything after it.
+// </p>
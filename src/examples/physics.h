@@ -30,3 +30,18 @@ Body my_body = create_body(my_shape, 0b110);
 // is to collide on all layers. Everything except the shape
 // is an optional parameter.
 
+
+//// Simulating a world
+// If you don't want to check the bodies yourself, a
+// world can do it for you. The world keeps a copy of
+// the body and hands back an id for it.
+World world = create_world();
+BodyID id = world.add(my_body, [](Body *self, Body *other, Overlap overlap) {
+    // Returning true here means the overlap is handled,
+    // and the world won't push the bodies apart.
+    return false;
+});
+// Every step integrates, checks and solves all the bodies.
+world.step(delta);
+// The pointer is only valid until a body is added or removed.
+Body *body = world.get(id);
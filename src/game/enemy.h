@@ -11,24 +11,41 @@ const f32 BIGBOI_BULLET_SIZE = 5;
 const f32 BIGBOI_BULLET_SPEED = 40;
 const f32 BIGBOI_BULLET_ACCELERATION = -15;
 
+// The frames of an animation, shared by every enemy
+// of a kind so nothing is allocated per enemy.
+struct Animation {
+    const AssetID *frames;
+    u32 num_frames;
+    f32 delay;
+};
+
+const AssetID TRASH_FALLING_FRAMES[] = {ASSET_TRASH_SLEEP};
+const AssetID TRASH_WALKING_FRAMES[] = {ASSET_TRASH, ASSET_TRASH_WALK};
+const AssetID BANANA_FRAMES[] = {ASSET_BANANA1, ASSET_BANANA2, ASSET_BANANA3, ASSET_BANANA2};
+const AssetID BIGBOI_FRAMES[] = {ASSET_BIGBOI_LEFT, ASSET_BIGBOI_RIGHT};
+
+const Animation TRASH_FALLING = {TRASH_FALLING_FRAMES, LEN(TRASH_FALLING_FRAMES), 0.5};
+const Animation TRASH_WALKING = {TRASH_WALKING_FRAMES, LEN(TRASH_WALKING_FRAMES), 0.1};
+const Animation BANANA_WANDERING = {BANANA_FRAMES, LEN(BANANA_FRAMES), 0.5};
+const Animation BANANA_CHASING = {BANANA_FRAMES, LEN(BANANA_FRAMES), 0.25};
+const Animation BIGBOI_WALKING = {BIGBOI_FRAMES, LEN(BIGBOI_FRAMES), 0.25};
+
 struct Enemy : public Entity {
-    Enemy(Vec2 pos, Vec2 dim, f32 rotation, u32 hp) :
+    Enemy(Vec2 pos, Vec2 dim, f32 rotation, u32 hp,
+          const Animation *animation = nullptr) :
         Entity(pos, dim, ASSET_TEST, rotation),
         hp(hp),
         time(0),
-        animation_delay(1),
+        animation(animation),
         boost_killable(true) {}
 
-    virtual ~Enemy() {}
-
     u32 hp;
     f32 time;
-    f32 animation_delay;
-    std::vector<AssetID> images;
+    const Animation *animation;
     bool boost_killable;
 
     void animate(f32 time) {
-        image = images[(u32)(time / animation_delay) % images.size()];
+        image = animation->frames[(u32)(time / animation->delay) % animation->num_frames];
     }
 
     bool is_dead() {
@@ -38,16 +55,15 @@ struct Enemy : public Entity {
 };
 
 struct TrashBag : public Enemy{
+    static constexpr f32 SPEED = 6;
+
     TrashBag(Vec2 pos) :
-    Enemy(pos, V2(TRASH_SIZE, TRASH_SIZE), 0, TRASH_HP),
+    Enemy(pos, V2(TRASH_SIZE, TRASH_SIZE), 0, TRASH_HP, &TRASH_FALLING),
     velocity(V2(0,0)),
     orig_pos(pos) {
-        animation_delay = 0.5;
-        images.push_back(ASSET_TRASH_SLEEP);
         side_speed = random_real(-3, 3);
     }
 
-    const f32 SPEED = 6;
     f32 buryTime = 0;
     f32 side_speed;
     bool onGround = false;
@@ -72,10 +88,7 @@ struct TrashBag : public Enemy{
             rotation = sin(time) / 3;
         } else {
             velocity.y = 0;
-            animation_delay = 0.1;
-            images.pop_back();
-            images.push_back(ASSET_TRASH);
-            images.push_back(ASSET_TRASH_WALK);
+            animation = &TRASH_WALKING;
             rotation = sin(time * 10) / 5;
 
             if (buryTime >= 3) {
@@ -92,22 +105,18 @@ struct TrashBag : public Enemy{
 };
 
 struct Banana : public Enemy {
-    const f32 SPEED = 5;
-    const f32 SPEED_CHASING = 15;
-    const f32 CHASE_DIST = 40;
+    static constexpr f32 SPEED = 5;
+    static constexpr f32 SPEED_CHASING = 15;
+    static constexpr f32 CHASE_DIST = 40;
 
     Banana(Vec2 pos) :
-        Enemy(pos, V2(BANANA_SIZE, BANANA_SIZE), 0, BANANA_HP),
+        Enemy(pos, V2(BANANA_SIZE, BANANA_SIZE), 0, BANANA_HP, &BANANA_WANDERING),
         velocity(V2(SPEED, 0)),
         orig_pos(pos) {
             boost_killable = false;
-            images.push_back(ASSET_BANANA1);
-            images.push_back(ASSET_BANANA2);
-            images.push_back(ASSET_BANANA3);
-            images.push_back(ASSET_BANANA2);
     }
 
-    void update(f32 delta) override {
+    void update(f32 delta) {
         time += delta;
         animate(time);
 
@@ -122,11 +131,11 @@ struct Banana : public Enemy {
         if (length(to_player) < CHASE_DIST) {
             Vec2 goal = normalize(to_player) * SPEED_CHASING;
             velocity = LERP(velocity, 0.2, goal);
-            animation_delay = 0.25;
+            animation = &BANANA_CHASING;
         } else {
             Vec2 goal = V2(velocity.x < 0 ? -SPEED : SPEED, sin(3 * time) * 5);
             velocity = LERP(velocity, 0.2, goal);
-            animation_delay = 0.5;
+            animation = &BANANA_WANDERING;
         }
 
         pos += velocity * delta;
@@ -136,28 +145,20 @@ struct Banana : public Enemy {
     Vec2 orig_pos;
 };
 
-struct Spawner;
-
 struct BigBoi : public Enemy {
-    const f32 SPEED = 5;
-    const f32 SPEED_CHASING = 10;
+    static constexpr f32 SPEED = 5;
+    static constexpr f32 SPEED_CHASING = 10;
 
-    BigBoi(Vec2 pos, Spawner* spawner) :
-        Enemy(pos, V2(BIGBOI_SIZE, BIGBOI_SIZE), 0, BIGBOI_HP),
+    BigBoi(Vec2 pos) :
+        Enemy(pos, V2(BIGBOI_SIZE, BIGBOI_SIZE), 0, BIGBOI_HP, &BIGBOI_WALKING),
         velocity(V2(0, 0)),
         orig_pos(pos),
-        spawner(spawner),
-        fired(false) {
-            animation_delay = 0.25;
-            images.push_back(ASSET_BIGBOI_LEFT);
-            images.push_back(ASSET_BIGBOI_RIGHT);
-    }
+        fired(false) {}
 
-    void update(f32 delta) override;
+    void update(f32 delta);
 
     Vec2 velocity;
     Vec2 orig_pos;
-    Spawner* spawner;
     bool fired;
 };
 
@@ -171,7 +172,7 @@ struct BigBoiBullet : public Enemy {
             boost_killable = false;
     }
 
-    void update(f32 delta) override {
+    void update(f32 delta) {
         velocity += acceleration * delta;
         pos += velocity * delta;
         if (pos.y < orig_y) hp = 0;
@@ -182,9 +183,109 @@ struct BigBoiBullet : public Enemy {
     f32 orig_y;
 };
 
+enum EnemyKind {
+    TRASHBAG,
+    BANANA,
+    BIGBOI,
+    BIGBOI_BULLET,
+
+    NUM_ENEMY_KINDS,
+};
+
+// Refers to an enemy in a pool, it stops pointing at
+// anything when the enemy dies.
+struct EnemyID {
+    EnemyKind kind;
+    s32 slot;
+    u32 gen;
+};
+
+struct PoolSlot {
+    u32 gen;
+    // Where the enemy is in "items", or the next
+    // free slot.
+    s32 index;
+};
+
+// All the enemies of one kind packed together, dead
+// ones are swapped out with the last one.
+template <typename T>
+struct EnemyPool {
+    static const s32 NONE = -1;
+
+    EnemyKind kind;
+    std::vector<T> items;
+    // The slot of each item.
+    std::vector<s32> owners;
+    std::vector<PoolSlot> slots;
+    s32 free = NONE;
+
+    EnemyID add(T item) {
+        if (free == NONE) {
+            free = slots.size();
+            slots.push_back({0, NONE});
+        }
+        s32 slot = free;
+        free = slots[slot].index;
+        slots[slot].gen++;
+        slots[slot].index = items.size();
+        items.push_back(item);
+        owners.push_back(slot);
+        return {kind, slot, slots[slot].gen};
+    }
+
+    void remove(u32 index) {
+        s32 slot = owners[index];
+        u32 last = items.size() - 1;
+        if (index != last) {
+            items[index] = items[last];
+            owners[index] = owners[last];
+            slots[owners[index]].index = index;
+        }
+        items.pop_back();
+        owners.pop_back();
+        slots[slot].gen++;
+        slots[slot].index = free;
+        free = slot;
+    }
+
+    EnemyID id(u32 index) {
+        s32 slot = owners[index];
+        return {kind, slot, slots[slot].gen};
+    }
+
+    T *get(EnemyID id) {
+        if (id.slot < 0 || (u32) id.slot >= slots.size()) return nullptr;
+        PoolSlot *slot = &slots[id.slot];
+        if (slot->gen != id.gen || slot->index < 0 ||
+            (u32) slot->index >= items.size() || owners[slot->index] != id.slot)
+            return nullptr;
+        return &items[slot->index];
+    }
+
+    void clear() {
+        items.clear();
+        owners.clear();
+        // The generations are kept, so old ids stay invalid.
+        free = NONE;
+        for (s32 i = slots.size() - 1; i >= 0; i--) {
+            slots[i].gen++;
+            slots[i].index = free;
+            free = i;
+        }
+    }
+};
+
+struct EnemyPools {
+    EnemyPool<TrashBag> trashbags = {TRASHBAG};
+    EnemyPool<Banana> bananas = {BANANA};
+    EnemyPool<BigBoi> bigbois = {BIGBOI};
+    EnemyPool<BigBoiBullet> bullets = {BIGBOI_BULLET};
+};
+
 struct Spawner {
-    Spawner(std::vector<Enemy*>* enemies) :
-        enemies(enemies),
+    Spawner(EnemyPools* pools) :
+        pools(pools),
         time(0),
         threat(0) {}
 
@@ -255,25 +356,25 @@ struct Spawner {
     void spawn_banana() {
         f32 x = random_real() < 0.5 ? WORLD_LEFT_EDGE - 5 : WORLD_RIGHT_EDGE + 5;
         f32 y = random_real(WORLD_TOP_EDGE - 5, WORLD_BOTTOM_EDGE + 5);
-        enemies->push_back(new Banana(V2(x, y)));
+        pools->bananas.add(Banana(V2(x, y)));
     }
 
     void spawn_trashbag() {
         f32 x = random_real(WORLD_LEFT_EDGE * 0.9, WORLD_RIGHT_EDGE * 0.9);
         f32 y = WORLD_TOP_EDGE + 5;
-        enemies->push_back(new TrashBag(V2(x, y)));
+        pools->trashbags.add(TrashBag(V2(x, y)));
     }
 
     void spawn_bigboi() {
         f32 x = random_real(WORLD_LEFT_EDGE * 0.9, WORLD_RIGHT_EDGE * 0.9);
         f32 y = WORLD_BOTTOM_EDGE - 5;
-        enemies->push_back(new BigBoi(V2(x,y), this));
+        pools->bigbois.add(BigBoi(V2(x,y)));
     }
 
     void spawn_bigboibullets(Vec2 pos) {
-        enemies->push_back(new BigBoiBullet(pos, 3));
-        enemies->push_back(new BigBoiBullet(pos, 0));
-        enemies->push_back(new BigBoiBullet(pos, -3));
+        pools->bullets.add(BigBoiBullet(pos, 3));
+        pools->bullets.add(BigBoiBullet(pos, 0));
+        pools->bullets.add(BigBoiBullet(pos, -3));
     }
 
     void reset() {
@@ -287,23 +388,49 @@ struct Spawner {
         return MAX(0.5, pow(0.66, (time - 120) / 40));
     }
 
-    std::vector<Enemy*>* enemies;
+    EnemyPools* pools;
     f32 time;
     u32 threat;
     f32 last_spawn[3] = { -1, -1, -1 };
 };
 
 Renderer::ParticleSystem hit_particles = {};
-std::vector<Enemy*> enemies;
+EnemyPools enemies;
 Spawner spawner(&enemies);
 
+// Calls "f" with every enemy, one kind at a time.
+template <typename F>
+void for_each_enemy(F f) {
+    for (u32 i = 0; i < enemies.trashbags.items.size(); i++)
+        f(enemies.trashbags.id(i), &enemies.trashbags.items[i]);
+    for (u32 i = 0; i < enemies.bananas.items.size(); i++)
+        f(enemies.bananas.id(i), &enemies.bananas.items[i]);
+    for (u32 i = 0; i < enemies.bigbois.items.size(); i++)
+        f(enemies.bigbois.id(i), &enemies.bigbois.items[i]);
+    for (u32 i = 0; i < enemies.bullets.items.size(); i++)
+        f(enemies.bullets.id(i), &enemies.bullets.items[i]);
+}
+
+Enemy *get_enemy(EnemyID id) {
+    switch (id.kind) {
+        case TRASHBAG: return enemies.trashbags.get(id);
+        case BANANA: return enemies.bananas.get(id);
+        case BIGBOI: return enemies.bigbois.get(id);
+        case BIGBOI_BULLET: return enemies.bullets.get(id);
+        default: return nullptr;
+    }
+}
+
 void initalize_enemies() {
     spawner.reset();
-    for (Enemy* enemy : enemies) {
-        delete enemy;
-    }
-    enemies.clear();
-    enemies.reserve(64);
+    enemies.trashbags.clear();
+    enemies.bananas.clear();
+    enemies.bigbois.clear();
+    enemies.bullets.clear();
+    enemies.trashbags.items.reserve(64);
+    enemies.bananas.items.reserve(16);
+    enemies.bigbois.items.reserve(8);
+    enemies.bullets.items.reserve(32);
 
     if (hit_particles.particles)
         Renderer::destroy_particle_system(&hit_particles);
@@ -353,22 +480,32 @@ void emit_boost_to_kill_particles(Vec2 position) {
     hit_particles.velocity = old;
 }
 
-void update_enemies(f32 delta) {
-    hit_particles.update(delta);
-    for (s32 i = enemies.size() - 1; i >= 0; i--) {
-        enemies[i]->update(delta);
-        if (enemies[i]->is_dead()) {
+// Walked backwards, so the enemy swapped in when one
+// dies has already been updated.
+template <typename T>
+void update_pool(EnemyPool<T> *pool, f32 delta) {
+    for (s32 i = pool->items.size() - 1; i >= 0; i--) {
+        T *enemy = &pool->items[i];
+        enemy->update(delta);
+        if (enemy->is_dead()) {
             score_kill_enemy();
-            emit_dead_particles(enemies[i]->pos);
-            delete enemies[i];
-            enemies.erase(enemies.begin() + i);
+            emit_dead_particles(enemy->pos);
+            pool->remove(i);
         }
     }
 }
 
+void update_enemies(f32 delta) {
+    hit_particles.update(delta);
+    update_pool(&enemies.trashbags, delta);
+    update_pool(&enemies.bananas, delta);
+    update_pool(&enemies.bigbois, delta);
+    update_pool(&enemies.bullets, delta);
+}
+
 void draw_entity(Entity* entity) {
     if (entity->image != NO_ASSET) {
-        Image* img = Asset::fetch_image(entity->image);
+        const Asset::Texture *img = Asset::fetch_image(entity->image);
         Renderer::push_sprite(entity->pos,
                 -entity->dim,
                 entity->rotation,
@@ -382,11 +519,11 @@ void draw_entity(Entity* entity) {
 
 void draw_enemies() {
     hit_particles.draw();
-    for (Enemy* enemy : enemies) {
+    for_each_enemy([](EnemyID, Enemy *enemy) {
         draw_entity(enemy);
         Physics::Body body = enemy->get_body();
         //Physics::debug_draw_body(&body);
-    }
+    });
 }
 
 
@@ -408,7 +545,7 @@ void BigBoi::update(f32 delta) {
         image = ASSET_BIGBOI_FIRE;
         if (!fired) {
             fired = true;
-            spawner->spawn_bigboibullets(pos);
+            spawner.spawn_bigboibullets(pos);
         }
     } else {
         fired = false;
@@ -6,9 +6,7 @@ struct Entity {
         image(image),
         rotation(rotation) {}
 
-    virtual void update(f32 delta) = 0;
-
-    virtual Physics::Body get_body() {
+    Physics::Body get_body() {
         Physics::Body body = Physics::create_body(square);
         body.position = pos;
         body.scale = dim * 0.75;
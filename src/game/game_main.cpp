@@ -60,6 +60,13 @@ f32 groundLevel = currentTrashLevel + COLLISION_TRASH_LEVEL;
 
 Truck truck;
 
+// About the size of an enemy.
+const f32 ENEMY_CELL_SIZE = 8;
+Physics::Grid enemy_grid;
+std::vector<Physics::Body> enemy_bodies;
+std::vector<EnemyID> enemy_ids;
+Util::List<Physics::ProxyID> nearby_enemies;
+
 void explode_truck() {
     Mixer::play_sound(ASSET_DEATH, 1.0, 0.7);
     truck.smoke_particles.position = truck.body.position;
@@ -96,7 +103,7 @@ Vec2 get_truck_pos() {
 }
 
 Mixer::AudioID play_music() {
-    return Mixer::play_sound(ASSET_BEEPBOX_SONG, 1.0, 5.0
+    return Mixer::play_sound(ASSET_BEEPBOX_SONG_BETTER, 1.0, 5.0
               ,Mixer::AUDIO_DEFAULT_VARIANCE, Mixer::AUDIO_DEFAULT_VARIANCE, true);
 }
 
@@ -144,13 +151,18 @@ void setup() {
     truck = create_truck();
     initalize_bullets();
 
+    enemy_grid = Physics::create_grid(ENEMY_CELL_SIZE, 256);
+    nearby_enemies = Util::create_list<Physics::ProxyID>(32);
+
     initalize_enemies();
     createCloudSystems();
     createStarSystem();
 
     Renderer::global_camera.zoom = 3.335 / 200.0;
 
-    Logic::add_callback(Logic::At::PRE_UPDATE, spawnCloud, 0, Logic::FOREVER, 2);
+    Logic::LogicID clouds = Logic::add_callback(Logic::At::PRE_UPDATE,
+                                                spawnCloud, 0, Logic::FOREVER, 2);
+    Logic::set_access(clouds, 0, Logic::add_resource() | Logic::RANDOM);
 
     reset_score();
 
@@ -287,9 +299,33 @@ void update_game(f32 delta) {
 
     update_score();
 
-    for (Enemy* enemy : enemies) {
-        Physics::Body enemy_body = enemy->get_body();
-        if (Physics::check_overlap(&enemy_body, &truck.body)) {
+    // The bodies are built once, the proxy ids match
+    // the index in "enemy_bodies" and "enemy_ids".
+    enemy_bodies.clear();
+    enemy_ids.clear();
+    enemy_grid.clear();
+    for_each_enemy([](EnemyID id, Enemy *enemy) {
+        enemy_bodies.push_back(enemy->get_body());
+        enemy_ids.push_back(id);
+        Physics::Body *body = &enemy_bodies.back();
+        enemy_grid.add(Physics::calculate_aabb(body), body->layer);
+    });
+    enemy_grid.build();
+
+    // The truck and the bullets are swept from where they were
+    // last frame so they can't skip past anything on a long
+    // frame. The enemies are slow, so they are left in place.
+    Physics::Body truck_start = truck.body;
+    truck_start.position = truck.last_position;
+    Vec2 truck_motion = truck.body.position - truck.last_position;
+    nearby_enemies.clear();
+    enemy_grid.query(Physics::swept_aabb(&truck_start, truck_motion),
+                     truck.body.layer, &nearby_enemies);
+    for (u32 i = 0; i < nearby_enemies.length; i++) {
+        u32 index = nearby_enemies[i];
+        Enemy *enemy = get_enemy(enemy_ids[index]);
+        if (Physics::time_of_impact(&truck_start, truck_motion,
+                                    &enemy_bodies[index], V2(0, 0))) {
             if (truck.boost_to_kill && enemy->boost_killable) {
                 // TODO(ed): More hp requires more speed!
                 score_boost_kill_enemy();
@@ -304,13 +340,22 @@ void update_game(f32 delta) {
 
     // Check for bullet collisions
     for (Bullet& bullet : bullets) {
-        for (Enemy* enemy : enemies) {
-            Physics::Body enemy_body = enemy->get_body();
-            if (check_overlap(&bullet.body, &enemy_body)) {
+        Physics::Body start = bullet.body;
+        start.position = bullet.last_position;
+        Vec2 motion = bullet.body.position - bullet.last_position;
+        nearby_enemies.clear();
+        enemy_grid.query(Physics::swept_aabb(&start, motion),
+                         bullet.body.layer, &nearby_enemies);
+        for (u32 i = 0; i < nearby_enemies.length; i++) {
+            u32 index = nearby_enemies[i];
+            Enemy *enemy = get_enemy(enemy_ids[index]);
+            Physics::Impact impact = Physics::time_of_impact(
+                &start, motion, &enemy_bodies[index], V2(0, 0));
+            if (impact) {
                 bullet.hit_enemy = true;
                 enemy->hp -= 1;
                 score_hit_enemy();
-                emit_hit_particles(bullet.body.position);
+                emit_hit_particles(start.position + motion * impact.time);
             }
         }
     }
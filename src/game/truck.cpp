@@ -1,5 +1,6 @@
 
 void Bullet::update(f32 delta) {
+    last_position = body.position;
     Physics::integrate(&body, delta);
 }
 
@@ -97,6 +98,7 @@ void Truck::boost(f32 delta) {
 }
 
 void Truck::update(f32 delta) {
+    last_position = body.position;
 
     if (dead) {
         super_particles.update(delta);
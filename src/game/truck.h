@@ -20,6 +20,8 @@ const f32 WIND_FORCE = 2;
 
 struct Bullet {
     Physics::Body body;
+    // Where it was before the last update.
+    Vec2 last_position;
     f32 spawn_time;
     f32 angle;
     f32 speed = BULLET_SPEED;
@@ -44,6 +46,8 @@ struct Truck {
     f32 boost_timer = TRUCK_BOOST_TIME_MAX;
     bool max_out = false;
     bool boost_to_kill = false;
+    // Where it was before the last update.
+    Vec2 last_position = V2(0, 0);
 
     void super_boost();
 